@@ -43,6 +43,7 @@
 #include "framework/hal/port.h"
 #include "framework/sal/rtos/rtos.h"
 #include "framework/sal/udp/udp.h"
+#include "framework/sal/udp/ipv4.h"
 #include "framework/sal/dio/outch.h"
 
 
@@ -142,12 +143,6 @@ LOCAL const uint8 kpui8LEDBlinkcmdString[] = "led blink";
 /* Current connection status */
 LOCAL ke_ConnectionStatus enConnStatus = KE_IDLE_STATE;
 
-/* UDP received data pointer */
-LOCAL uint8 *pui8UDPRXDataPtr = NULL_PTR;
-
-/* UDP received data length */
-LOCAL uint16 ui16UDPRXDataLength = US_NULL;
-
 /* Obtained IPv4 address */
 LOCAL uint32 ui32IPAddress = UL_NULL;
 
@@ -158,6 +153,7 @@ LOCAL uint32 ui32IPAddress = UL_NULL;
 
 LOCAL ke_LEDStatusRequests  checkUDPData        (uint8 *, uint16);
 LOCAL void                  manageReceivedData  (ke_AppLEDIndexes, uint8 *, uint16);
+LOCAL void                  receiveLEDData      (UDP_keSocketNum, uint32, uint16, uint8 *, uint16);
 
 
 
@@ -215,6 +211,11 @@ EXPORTED void APP_UDP_PeriodicTask( void )
                                   UL_UDP_SOCKET_REMOTE_IP_ADD,          /* remote IP address */
                                   ui16LEDIndexToUDPPorts[KE_LED_2][0],  /* source port */
                                   ui16LEDIndexToUDPPorts[KE_LED_2][1]); /* destination port */
+                /* manage received data as soon as they are received */
+                UDP_setRXCallback(ui8LEDIndexToUDPSocket[KE_LED_1], receiveLEDData);
+                UDP_setRXCallback(ui8LEDIndexToUDPSocket[KE_LED_2], receiveLEDData);
+                /* resolve the remote controller now that the local IP address is known */
+                (void)IPV4_addHotPeer(UL_UDP_SOCKET_REMOTE_IP_ADD);
                 /* go into RUN state */
                 enConnStatus = KE_RUN_STATE;
             }
@@ -236,15 +237,7 @@ EXPORTED void APP_UDP_PeriodicTask( void )
         }
         case KE_WAIT_STATE:
         {
-            /* check if UDP data have been received for LED 1 socket */
-            UDP_checkReceivedData(ui8LEDIndexToUDPSocket[KE_LED_1], &pui8UDPRXDataPtr, &ui16UDPRXDataLength);
-            /* manage eventual received data */
-            manageReceivedData(KE_LED_1, pui8UDPRXDataPtr, ui16UDPRXDataLength);
-
-            /* check if UDP data have been received for LED 1 socket */
-            UDP_checkReceivedData(ui8LEDIndexToUDPSocket[KE_LED_2], &pui8UDPRXDataPtr, &ui16UDPRXDataLength);
-            /* manage eventual received data */
-            manageReceivedData(KE_LED_2, pui8UDPRXDataPtr, ui16UDPRXDataLength);
+            /* UDP data are managed by receiveLEDData callback */
 
             /* remain in this state */
 
@@ -290,6 +283,26 @@ LOCAL ke_LEDStatusRequests checkUDPData( uint8 *pui8PtrToData, uint16 ui16UDPRXD
 }
 
 
+/* LEDs UDP sockets receive callback */
+LOCAL void receiveLEDData( UDP_keSocketNum unSocketNum, uint32 ui32SrcIPAdd, uint16 ui16SrcPort, uint8 *pui8UDPRXDataPtr, uint16 ui16UDPRXDataLength )
+{
+    ke_AppLEDIndexes eLedIndex;
+
+    /* get LED index from socket number */
+    for(eLedIndex = KE_FIRST_LED; eLedIndex <= KE_LAST_LED; eLedIndex++)
+    {
+        if(ui8LEDIndexToUDPSocket[eLedIndex] == unSocketNum)
+        {
+            manageReceivedData(eLedIndex, pui8UDPRXDataPtr, ui16UDPRXDataLength);
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+}
+
+
 /* perform LED status change if a valid request has been received */
 LOCAL void manageReceivedData( ke_AppLEDIndexes eLedIndex, uint8 *pui8UDPRXDataPtr, uint16 ui16UDPRXDataLength )
 {
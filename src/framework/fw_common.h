@@ -25,7 +25,12 @@ typedef unsigned long long  ulonglong;
 typedef signed char         int8;
 typedef unsigned char       uint8;
 typedef unsigned short      uint16;
+#ifdef __LP64__
+/* 64-bit hosts (i.e. test harness): long is 64 bits there */
+typedef unsigned int        uint32;
+#else
 typedef unsigned long       uint32;
+#endif
 typedef unsigned long long  uint64;
 typedef unsigned char       boolean;
 
@@ -36,13 +36,11 @@
 /*
 TODO LIST:
     1)  implement the Pattern match filter feature: see setPatternMatchRXFilter() function
-    2)  only one TX buffer is used at the moment!
-        see ETHMAC_getTXBufferPointer function and ETHMAC_UC_TX_NUM_OF_BUFFERS define
-    3)  implement a watermark reached interrupt management if necessary: see FLOW_CTRL_RX_BUFF_FULL define
-    4)  check the ETHSTAT register to see transfer result in sendPacket function
-    5)  check a 32-bit alignment for RX buffer allocation
-    6)  implement a de-init function to free TX and RX buffers
-    7)  in ETHMAC_Init function, set bInitSuccess flag according to other results also
+    2)  implement a watermark reached interrupt management if necessary: see FLOW_CTRL_RX_BUFF_FULL define
+    3)  check the TX status vector to see transfer result in completeTXFrame function
+    4)  check a 32-bit alignment for RX buffer allocation
+    5)  implement a de-init function to free TX and RX buffers
+    6)  in ETHMAC_Init function, set bInitSuccess flag according to other results also
 */
 
 
@@ -57,11 +55,6 @@ TODO LIST:
 
 #include "ethmac.h"
 
-#include "../sal/udp/ipv4.h"  /* only use to obtain IPv4 datagram octects length */
-
-
-
-
 /* ---------------------- Local defines -------------------- */
 
 /* if uncomment, configure MAC as loopback. If comment, lopback is disabled */
@@ -75,14 +68,18 @@ TODO LIST:
 #define ULL_SW_MAC_ADDRESS          ((uint64)0x0000218956435612)
 #endif
 
-/* this value is related to ETHMAC_st_DataDcpt struct; 2 descriptors used for each TX buffer */
-#define UC_NUM_OF_TX_DCPT                   ((uint8)(ETHMAC_UC_TX_NUM_OF_BUFFERS * UC_2))
+/* this value is related to ETHMAC_st_DataDcpt struct; 1 descriptor for the ethernet header
+   plus 1 for each data segment are used for each TX buffer */
+#define UC_NUM_OF_TX_DCPT                   ((uint8)(ETHMAC_UC_TX_NUM_OF_BUFFERS * (UC_1 + ETHMAC_UC_TX_MAX_SEGMENTS)))
+
+/* num of 32-bit words of the ethernet header buffer of each TX frame */
+#define UC_TX_ETH_HDR_WORDS                 ((uint8)((ETHMAC_UC_ETH_HDR_LENGTH + 3) / 4))
 
 /* num of RX descriptors */
 #define UC_NUM_OF_RX_DCPT                   (ETHMAC_UC_RX_NUM_OF_BUFFERS)
 
-/* length of each buffer in bytes */
-#define US_DATA_BUFFER_LENGTH               (IPV4_US_ACCEPTED_MIN_LENGTH)
+/* length of each buffer in bytes: max MTU plus ethernet header and FCS, rounded up to a multiple of 16 as required by RXBUFSZ */
+#define US_DATA_BUFFER_LENGTH               ((uint16)((ETHMAC_US_MAX_MTU + ETHMAC_UC_ETH_HDR_LENGTH + UC_ETH_FCS_LENGTH + 15) & ~15))
 
 /* Back to back inter-packet gap defined as default register value */
 #define BB_INTERPACKET_GAP_VALUE            0x15
@@ -99,11 +96,13 @@ TODO LIST:
 
 /* Maximum MAC supported RX frame size.
    Any incoming ETH frame that's longer than this size will be discarded.
-   The default value is 1536 (allows for VLAN tagged frames, although the VLAN tagged frames are discarded).
-   Normally there's no need to touch this value unless you know exactly the maximum size of the frames
-   you want to process or you need to control packets fragmentation (together with the EMAC_RX_BUFF_SIZE.
+   It is the length of a RX data buffer, so that a received frame always fits in a single descriptor.
    Note: Always multiple of 16. */
-#define MAC_RX_MAX_FRAME                    1536
+#define MAC_RX_MAX_FRAME                    1520
+/* value check: max MTU plus ethernet header and FCS, rounded up as US_DATA_BUFFER_LENGTH */
+#if ((ETHMAC_US_MAX_MTU + 18 + 15) & ~15) != MAC_RX_MAX_FRAME
+#error MAC_RX_MAX_FRAME define is different from the RX data buffer length
+#endif
 
 /* Flow control  */
 #define FLOW_CTRL_PTV                       16
@@ -116,6 +115,21 @@ TODO LIST:
 #error FLOW_CTRL_RX_BUFF_FULL define is greater than UC_NUM_OF_RX_DCPT
 #endif
 
+/* value check */
+#if ETHMAC_UC_TX_MAX_SEGMENTS < 1
+#error ETHMAC_UC_TX_MAX_SEGMENTS define is lower than 1
+#endif
+
+/* value check: TX descriptors are counted on 8 bits */
+#if (ETHMAC_UC_TX_NUM_OF_BUFFERS < 1) || ((ETHMAC_UC_TX_NUM_OF_BUFFERS * (1 + ETHMAC_UC_TX_MAX_SEGMENTS)) > 255)
+#error ETHMAC_UC_TX_NUM_OF_BUFFERS define is out of range
+#endif
+
+/* value check */
+#if ETHMAC_UC_RX_MAX_LENT_BUFFERS < 1
+#error ETHMAC_UC_RX_MAX_LENT_BUFFERS define is lower than 1
+#endif
+
 /* Flow control RX buffer empty. Should be lower than FLOW_CTRL_RX_BUFF_FULL */
 #define FLOW_CTRL_RX_BUFF_EMPTY             0x00
 
@@ -136,6 +150,9 @@ TODO LIST:
 /* ETHCON2 register */
 #define ETHCON2_RXBUFSZ_BIT_POS             4
 
+/* RX descriptor status vector: RSV field */
+#define RXSTAT_RX_OK_BIT_POS                7
+
 /* EMAC1CFG1 register */
 #define EMAC1_SOFTRESET_BIT_POS             15
 #define LOOPBACK_BIT_POS                    4
@@ -176,6 +193,8 @@ TODO LIST:
 #define ETHIRQ_FWMARK_BIT_POS               8
 #define ETHIRQ_RXDONE_BIT_POS               7
 #define ETHIRQ_TXDONE_BIT_POS               3
+#define ETHIRQ_TXABORT_BIT_POS              2
+#define ETHIRQ_RXBUFNA_BIT_POS              1
 #define ETHIRQ_RXOVFLW_BIT_POS              0
 
 /* ETHRXFC register */
@@ -288,7 +307,8 @@ typedef struct
             unsigned PKT_Checksum: 16;
             unsigned: 8;
             unsigned RXF_RSV: 8;
-            unsigned RSV: 32;
+            unsigned RX_Bytes: 16;
+            unsigned RSV: 16;
         }rxstat;
         unsigned long long s;
     }stat;
@@ -307,11 +327,23 @@ typedef struct
 #define ENABLE_ETH_MODULE()         (ETHCON1SET = (1 << ETHCON_ON_BIT_POS))
 #define DISABLE_ETH_MODULE()        (ETHCON1CLR = (1 << ETHCON_ON_BIT_POS))
 #define CHECK_ETH_IS_BUSY()         ((ETHSTAT & (1 << ETHSTAT_BUSY_BIT_POS)) > 0)
-#define CHECK_TX_IS_DONE()          ((ETHCON1 & (1 << ETHCON_TXRTS_BIT_POS)) > 0)
+#define CHECK_TX_IS_RUNNING()       ((ETHCON1 & (1 << ETHCON_TXRTS_BIT_POS)) > 0)
+
+/* TX ring macros */
+#define GET_NEXT_TX_SLOT(x)         (((x) + UC_1) % ETHMAC_UC_TX_NUM_OF_BUFFERS)
+
+/* RX ring macros */
+#define GET_RX_RING_IDX(x)          ((x) % UC_NUM_OF_RX_DCPT)
+#define IS_RX_DCPT_PENDING(x)       (GET_RX_RING_IDX((x) + UC_NUM_OF_RX_DCPT - ui8RXHeadIdx) < ui8RXPendingNum)
+#define IS_RX_DCPT_WHOLE_FRAME(x)   (((x)->hdr.flags.SOP == 1) && ((x)->hdr.flags.EOP == 1) && ((((x)->stat.rxstat.RSV) & (1 << RXSTAT_RX_OK_BIT_POS)) != 0))
+#define GET_TX_SLOT_DCPT(x)         (&stTXArrayDcpt[((x) * (UC_1 + ETHMAC_UC_TX_MAX_SEGMENTS))])
 
 /* Ethernet datagram related set macros */
 #define SET_ETHERTYPE(x,y)          ((x) = SWAP_BYTES_ORDER_16BIT_(y))
 
+/* Ethernet frame check sequence length in bytes */
+#define UC_ETH_FCS_LENGTH           ((uint8)4)
+
 
 
 
@@ -326,7 +358,31 @@ EXPORTED uint64 ETHMAC_ui64MACAddress;
 /* --------------- Local variables declaration ------------ */
 
 /* TX descriptors data buffers */
-LOCAL uint8 *apui8TXDcptDataBuffers[(UC_NUM_OF_TX_DCPT / 2)];
+LOCAL uint8 *apui8TXDcptDataBuffers[ETHMAC_UC_TX_NUM_OF_BUFFERS];
+
+/* TX frames ethernet headers. They are not on the stack because frames are sent after ETHMAC_sendPacketVector returns */
+LOCAL uint32 aui32TXEthHeaders[ETHMAC_UC_TX_NUM_OF_BUFFERS][UC_TX_ETH_HDR_WORDS];
+
+/* buffers held by TX frames until they are sent. They are passed to the TX done callback */
+LOCAL uint8 *apui8TXHeldBuffers[ETHMAC_UC_TX_NUM_OF_BUFFERS];
+
+/* TX done callback */
+LOCAL ETHMAC_pfTXDoneCallback pfTXDoneCallback = NULL_PTR;
+
+/* RX notify callback. Called by the interrupt */
+LOCAL volatile ETHMAC_pfRXNotifyCallback pfRXNotifyCallback = NULL_PTR;
+
+/* TX notify callback. Called by the interrupt */
+LOCAL volatile ETHMAC_pfTXNotifyCallback pfTXNotifyCallback = NULL_PTR;
+
+/* TX ring: frames are queued at head, started in order and reclaimed from tail once sent */
+LOCAL uint8 ui8TXHeadSlot;                  /* next free slot */
+LOCAL uint8 ui8TXTailSlot;                  /* oldest slot not reclaimed yet */
+LOCAL uint8 ui8TXUsedSlots;                 /* num of slots from tail to head */
+LOCAL volatile uint8 ui8TXStartSlot;        /* next slot to start */
+LOCAL volatile uint8 ui8TXWaitingFrames;    /* num of queued frames not started yet */
+LOCAL volatile uint8 ui8TXDoneFrames;       /* num of sent frames not reclaimed yet */
+LOCAL volatile boolean bTXActive;           /* a frame is being transmitted */
 
 /* RX descriptors data buffers */
 LOCAL uint8 *apui8RXDcptDataBuffers[UC_NUM_OF_RX_DCPT];
@@ -335,14 +391,20 @@ LOCAL uint8 *apui8RXDcptDataBuffers[UC_NUM_OF_RX_DCPT];
 LOCAL st_TXEthDcpt stTXArrayDcpt[UC_NUM_OF_TX_DCPT];
 LOCAL st_RXEthDcpt stRXArrayDcpt[UC_NUM_OF_RX_DCPT];
 
-/* RX descriptors counter. Used by ETHMAC_getNextRXDataBuffer function */
-LOCAL uint8 ui8RXDcptCount;
+/* RX ring head: oldest received descriptor not given back yet. Hardware fills descriptors in ring order,
+   so frames are taken from here in arrival order */
+LOCAL uint8 ui8RXHeadIdx;
 
-/* RX current descriptor pointer. Used by ETHMAC_getNextRXDataBuffer function */
-LOCAL st_RXEthDcpt *stRXCurrEthDcpt;
+/* Num of RX descriptors from the head returned by the last ETHMAC_getRXDataBuffers call.
+   They are given back to hardware at the next call */
+LOCAL uint8 ui8RXPendingNum;
 
-/* Pending RX descriptor to clear flag. Used by ETHMAC_getNextRXDataBuffer function */
-LOCAL boolean bPrevPending;
+/* RX buffers out of the ring: spare ones and the ones lent to upper layers. When a buffer is lent it takes the place
+   of a spare one here, and the spare one takes its place in the descriptor */
+LOCAL uint8 *apui8RXLoanBuffers[ETHMAC_UC_RX_MAX_LENT_BUFFERS];
+
+/* RX buffers out of the ring lent flags. Not lent ones are spare */
+LOCAL boolean abRXLoanBufferLent[ETHMAC_UC_RX_MAX_LENT_BUFFERS];
 
 
 
@@ -351,8 +413,15 @@ LOCAL boolean bPrevPending;
 
 LOCAL void setDestMACAddress        (uint8 *, uint64);
 LOCAL void setSrcMACAddress         (uint8 *, uint64);
-LOCAL void sendPacket               (uint8 **, uint16 *, uint16);
+LOCAL void sendPacket               (uint8, uint8 **, uint16 *, uint16, uint8 *);
+LOCAL uint8 getFreeTXSlot           (void);
+LOCAL void startNextTXFrame         (void);
+LOCAL void completeTXFrame          (void);
 LOCAL void setRXPacket              (uint8 **, uint16, uint16);
+LOCAL void restoreRXDescriptor      (st_RXEthDcpt *);
+LOCAL void restorePendingRXDcpts    (void);
+LOCAL uint8 getRXDcptIndexFromPtr   (uint8 *);
+LOCAL uint8 getRXLoanIndexFromPtr   (uint8 *);
 LOCAL void resetEthController       (void);
 LOCAL void resetMACModule           (void);
 LOCAL void configureMACModule       (void);
@@ -381,16 +450,35 @@ EXPORTED boolean ETHMAC_Init( void )
         apui8RXDcptDataBuffers[ui8BuffCount] = (uint8 *)MEM_MALLOC(US_DATA_BUFFER_LENGTH + UC_2) + UC_2;
     }
 
-    /* init all RX descriptors buffers */
-    for(ui8BuffCount = UC_NULL; ui8BuffCount < (UC_NUM_OF_TX_DCPT / 2); ui8BuffCount++)
+    /* init spare RX buffers with the same alignment. No buffers are lent */
+    for(ui8BuffCount = UC_NULL; ui8BuffCount < ETHMAC_UC_RX_MAX_LENT_BUFFERS; ui8BuffCount++)
+    {
+        apui8RXLoanBuffers[ui8BuffCount] = (uint8 *)MEM_MALLOC(US_DATA_BUFFER_LENGTH + UC_2) + UC_2;
+        abRXLoanBufferLent[ui8BuffCount] = B_FALSE;
+    }
+
+    /* init all TX descriptors buffers */
+    for(ui8BuffCount = UC_NULL; ui8BuffCount < ETHMAC_UC_TX_NUM_OF_BUFFERS; ui8BuffCount++)
     {
         apui8TXDcptDataBuffers[ui8BuffCount] = (uint8 *)MEM_MALLOC(US_DATA_BUFFER_LENGTH);
         ALIGN_32BIT_OF_8BIT_PTR(apui8TXDcptDataBuffers[ui8BuffCount]);
         apui8TXDcptDataBuffers[ui8BuffCount] += (US_DATA_BUFFER_LENGTH - US_1);
+        apui8TXHeldBuffers[ui8BuffCount] = NULL_PTR;
     }
 
-    /* no pending RX descriptors to clear */
-    bPrevPending = B_FALSE;
+    /* TX ring is empty */
+    ui8TXHeadSlot = UC_NULL;
+    ui8TXTailSlot = UC_NULL;
+    ui8TXUsedSlots = UC_NULL;
+    ui8TXStartSlot = UC_NULL;
+    ui8TXWaitingFrames = UC_NULL;
+    ui8TXDoneFrames = UC_NULL;
+    bTXActive = B_FALSE;
+
+    /* RX ring starts from the first descriptor and no descriptors are pending */
+    ui8RXHeadIdx = UC_NULL;
+    ui8RXPendingNum = UC_NULL;
+
     
     /* --- Ethernet controller reset --- */
     resetEthController();
@@ -429,107 +517,383 @@ EXPORTED boolean ETHMAC_Init( void )
 }
 
 
-/* Function to get next received data pointer */
+/* Function to get next received data pointer. The frame returned by the previous call is given back to hardware
+   unless it has been lent. Return NULL if no frames are ready */
 EXPORTED uint8 * ETHMAC_getNextRXDataBuffer( void )
 {
-    uint8 *pui8DataBufPtr = NULL;
+    uint8 *pui8DataBufPtr;
 
-    if(bPrevPending == B_TRUE)
+    if(UC_NULL == ETHMAC_getRXDataBuffers(&pui8DataBufPtr, UC_1))
     {
-        /* restore previous descriptor */
-        stRXCurrEthDcpt->hdr.w = 0;           /* clear all the fields */
-        stRXCurrEthDcpt->hdr.flags.NPV = 1;   /* set next pointer valid */
-        stRXCurrEthDcpt->hdr.flags.EOWN = 1;  /* set hardware ownership */
-        stRXCurrEthDcpt->stat.s = 0;          /* clear stat field */
+        /* pointer is NULL */
+        pui8DataBufPtr = NULL;
+    }
+    else
+    {
+        /* one frame ready */
+    }
 
-        /* decrement received packet buffer count */
-        ETHCON1SET = (1 << ETHCON_BUFCDEC_BIT_POS);
+    return pui8DataBufPtr;
+}
 
-        bPrevPending = B_FALSE;
+
+/* Function to get up to the given num of received data pointers in arrival order. Frames returned by the previous
+   call are given back to hardware unless they have been lent. Descriptors that do not hold a whole frame received OK
+   are given back to hardware and skipped. Return the num of ready frames */
+EXPORTED uint8 ETHMAC_getRXDataBuffers( uint8 **ppui8DataBufPtrs, uint8 ui8MaxNum )
+{
+    uint8 ui8FramesNum = UC_NULL;
+    boolean bContiguous = B_TRUE;
+    st_RXEthDcpt *pstDcpt;
+
+    /* give previous frames back and move the head after them */
+    restorePendingRXDcpts();
+
+    /* take frames from the head while they are software owned */
+    pstDcpt = &stRXArrayDcpt[ui8RXHeadIdx];
+    while((ui8FramesNum < ui8MaxNum)
+    &&    (ui8FramesNum < UC_NUM_OF_RX_DCPT)
+    &&    (pstDcpt->hdr.flags.EOWN == 0)
+    &&    (B_TRUE == bContiguous))
+    {
+        if(IS_RX_DCPT_WHOLE_FRAME(pstDcpt))
+        {
+            /* get buffer pointer */
+            ppui8DataBufPtrs[ui8FramesNum] = (uint8 *)PA_TO_KVA1((uint32)pstDcpt->pEDBuff);
+            ui8FramesNum++;
+        }
+        else if(UC_NULL == ui8FramesNum)
+        {
+            /* partial or bad frame at the head: drop it and move the head after it */
+            restoreRXDescriptor(pstDcpt);
+            ui8RXHeadIdx = GET_RX_RING_IDX(ui8RXHeadIdx + UC_1);
+        }
+        else
+        {
+            /* returned frames shall follow the head without gaps: it is dropped by next call */
+            bContiguous = B_FALSE;
+        }
+
+        /* next descriptor in the ring */
+        pstDcpt = &stRXArrayDcpt[GET_RX_RING_IDX(ui8RXHeadIdx + ui8FramesNum)];
+    }
+
+    ui8RXPendingNum = ui8FramesNum;
+
+    return ui8FramesNum;
+}
+
+
+/* Function to know if a descriptor after the ones returned by the last ETHMAC_getRXDataBuffers call is already
+   software owned, that is a received frame is waiting to be taken */
+EXPORTED boolean ETHMAC_isRXFrameWaiting( void )
+{
+    boolean bWaiting;
+
+    if(ui8RXPendingNum < UC_NUM_OF_RX_DCPT)
+    {
+        bWaiting = (stRXArrayDcpt[GET_RX_RING_IDX(ui8RXHeadIdx + ui8RXPendingNum)].hdr.flags.EOWN == 0) ? B_TRUE : B_FALSE;
     }
     else
     {
-        /* if first call then start from first descriptor */
-        ui8RXDcptCount = UC_NUM_OF_RX_DCPT;
-        stRXCurrEthDcpt = &stRXArrayDcpt[US_NULL];
+        /* all descriptors are taken: hardware cannot receive until they are given back */
+        bWaiting = B_FALSE;
     }
-    
-    /* get next pointer */
-    while((ui8RXDcptCount > UC_NULL)
-    &&    (stRXCurrEthDcpt->hdr.flags.EOWN == 1))
+
+    return bWaiting;
+}
+
+
+/* Function to get the hardware payload checksum of a frame returned by the last ETHMAC_getRXDataBuffers call
+   and the payload length it covers. Any pointer inside the frame buffer is accepted. The payload starts after the
+   Ethernet header and it includes eventual padding. Returns B_FALSE if the checksum is not available */
+EXPORTED boolean ETHMAC_getRXPayloadChecksum( uint8 *pui8FramePtr, uint16 *pui16Checksum, uint16 *pui16PayloadLength )
+{
+    boolean bAvailable = B_FALSE;
+#if ETHMAC_RX_HW_CHECKSUM_ENABLED == 1
+    uint8 ui8DcptIndex;
+
+    /* get related descriptor */
+    ui8DcptIndex = getRXDcptIndexFromPtr(pui8FramePtr);
+
+    /* if the frame is currently in use and it is long enough */
+    if((ui8DcptIndex < UC_NUM_OF_RX_DCPT)
+    && (IS_RX_DCPT_PENDING(ui8DcptIndex))
+    && (stRXArrayDcpt[ui8DcptIndex].stat.rxstat.RX_Bytes > (ETHMAC_UC_ETH_HDR_LENGTH + UC_ETH_FCS_LENGTH)))
     {
-        /* decrement descriptor counter */
-        ui8RXDcptCount--;
-        /* next descriptor */
-        stRXCurrEthDcpt++;
+        *pui16Checksum = (uint16)stRXArrayDcpt[ui8DcptIndex].stat.rxstat.PKT_Checksum;
+        /* received bytes count includes the FCS */
+        *pui16PayloadLength = (uint16)(stRXArrayDcpt[ui8DcptIndex].stat.rxstat.RX_Bytes - ETHMAC_UC_ETH_HDR_LENGTH - UC_ETH_FCS_LENGTH);
+
+        bAvailable = B_TRUE;
     }
+    else
+    {
+        /* checksum not available */
+    }
+#endif
 
-    /* end of list reached */
-    if(ui8RXDcptCount == UC_NULL)
+    return bAvailable;
+}
+
+
+/* Function to get the num of bytes received after the Ethernet header of a frame returned by the last
+   ETHMAC_getRXDataBuffers call. Any pointer inside the frame buffer is accepted. FCS is excluded and eventual padding
+   is included. Returns 0 if the frame is not in use */
+EXPORTED uint16 ETHMAC_getRXPayloadLength( uint8 *pui8FramePtr )
+{
+    uint16 ui16PayloadLength = US_NULL;
+    uint8 ui8DcptIndex;
+
+    /* get related descriptor */
+    ui8DcptIndex = getRXDcptIndexFromPtr(pui8FramePtr);
+
+    /* if the frame is currently in use and it is long enough */
+    if((ui8DcptIndex < UC_NUM_OF_RX_DCPT)
+    && (IS_RX_DCPT_PENDING(ui8DcptIndex))
+    && (stRXArrayDcpt[ui8DcptIndex].stat.rxstat.RX_Bytes > (ETHMAC_UC_ETH_HDR_LENGTH + UC_ETH_FCS_LENGTH)))
     {
-        /* pointer is NULL */
-        pui8DataBufPtr = NULL;
+        /* received bytes count includes the FCS */
+        ui16PayloadLength = (uint16)(stRXArrayDcpt[ui8DcptIndex].stat.rxstat.RX_Bytes - ETHMAC_UC_ETH_HDR_LENGTH - UC_ETH_FCS_LENGTH);
     }
     else
     {
-        /* check if SW ownership */
-        if(stRXCurrEthDcpt->hdr.flags.EOWN == 0)
-        {
-            /* get buffer pinter */
-            pui8DataBufPtr = (uint8 *)PA_TO_KVA1((uint32)stRXCurrEthDcpt->pEDBuff);
+        /* length not available */
+    }
 
-            bPrevPending = B_TRUE;
-        }
-        else
-        {
-            /* pointer is NULL */
-            pui8DataBufPtr = NULL;
-        }
+    return ui16PayloadLength;
+}
+
+
+/* Function to lend a received data buffer to upper layers. Any pointer inside the buffer of a frame returned by the last
+   ETHMAC_getRXDataBuffers call is accepted. The buffer is swapped with a spare one in its descriptor, so the descriptor
+   goes back to hardware as usual. Returns B_FALSE if no spare buffer is left: upper layers shall copy the data */
+EXPORTED boolean ETHMAC_lendRXDataBuffer( uint8 *pui8DataPtr )
+{
+    boolean bSuccess = B_FALSE;
+    uint8 ui8DcptIndex;
+    uint8 ui8LoanIndex = UC_NULL;
+    uint8 *pui8LentBuffer;
+
+    /* get related descriptor */
+    ui8DcptIndex = getRXDcptIndexFromPtr(pui8DataPtr);
+
+    /* look for a spare buffer */
+    while((ui8LoanIndex < ETHMAC_UC_RX_MAX_LENT_BUFFERS)
+    &&    (B_TRUE == abRXLoanBufferLent[ui8LoanIndex]))
+    {
+        ui8LoanIndex++;
     }
 
-    return pui8DataBufPtr;
+    /* if descriptor is a software owned one and a spare buffer is available */
+    if((ui8DcptIndex < UC_NUM_OF_RX_DCPT)
+    && (IS_RX_DCPT_PENDING(ui8DcptIndex))
+    && (ui8LoanIndex < ETHMAC_UC_RX_MAX_LENT_BUFFERS))
+    {
+        /* swap buffers: the descriptor gets the spare one */
+        pui8LentBuffer = (uint8 *)PA_TO_KVA1((uint32)stRXArrayDcpt[ui8DcptIndex].pEDBuff);
+        stRXArrayDcpt[ui8DcptIndex].pEDBuff = (uint8 *)KVA_TO_PA(apui8RXLoanBuffers[ui8LoanIndex]);
+        apui8RXLoanBuffers[ui8LoanIndex] = pui8LentBuffer;
+        abRXLoanBufferLent[ui8LoanIndex] = B_TRUE;
+
+        /* success */
+        bSuccess = B_TRUE;
+    }
+    else
+    {
+        /* fail */
+    }
+
+    return bSuccess;
 }
 
 
-/* send packet. Data buffers have been previously saved into the shared ETHMAC_stTXDataBuffer structure */
-EXPORTED void ETHMAC_sendPacket( uint8 *pui8FramePtr, uint16 ui16DataLength, uint64 ui64HWSrcAdd, uint64 ui64HWDstAdd, uint16 ui16EthType )
+/* Function to release a previously lent data buffer. It becomes a spare one */
+EXPORTED void ETHMAC_releaseRXDataBuffer( uint8 *pui8DataPtr )
 {
-    uint8 aui8EthernetHeader[ETHMAC_UC_ETH_HDR_LENGTH];
-    uint8 *apui8PtrsArray[UC_2];
-    uint16 aui16LengthArray[UC_2];
+    uint8 ui8LoanIndex;
 
-    /* set ETH addresses and type */
-    setDestMACAddress(&aui8EthernetHeader[UC_0], ui64HWDstAdd);
-    setSrcMACAddress(&aui8EthernetHeader[ETHMAC_UC_ETH_ADD_LENGTH], ui64HWSrcAdd);
-    /* set ethernet type */
-    SET_ETHERTYPE(*((uint16 *)(&aui8EthernetHeader[(UC_2 * ETHMAC_UC_ETH_ADD_LENGTH)])), ui16EthType);
+    /* get related loan */
+    ui8LoanIndex = getRXLoanIndexFromPtr(pui8DataPtr);
 
-    /* 1 TX descriptor for the ethernet header */
-    apui8PtrsArray[UC_0] = aui8EthernetHeader;
-    aui16LengthArray[UC_0] = ETHMAC_UC_ETH_HDR_LENGTH;
-    
-    /* 1 TX descriptor for the rest of the packet */
-    apui8PtrsArray[UC_1] = pui8FramePtr;
-    aui16LengthArray[UC_1] = ui16DataLength;
+    /* if buffer is valid and lent */
+    if((ui8LoanIndex < ETHMAC_UC_RX_MAX_LENT_BUFFERS)
+    && (B_TRUE == abRXLoanBufferLent[ui8LoanIndex]))
+    {
+        /* buffer is spare again */
+        abRXLoanBufferLent[ui8LoanIndex] = B_FALSE;
+    }
+    else
+    {
+        /* invalid pointer or buffer not lent: do nothing */
+    }
+}
+
+
+/* send packet. Data have been previously written into the buffer given by ETHMAC_getTXBufferPointer.
+   Return B_FALSE if the TX ring is full */
+EXPORTED boolean ETHMAC_sendPacket( uint8 *pui8FramePtr, uint16 ui16DataLength, uint64 ui64HWSrcAdd, uint64 ui64HWDstAdd, uint16 ui16EthType )
+{
+    /* the rest of the packet is a single data segment */
+    return ETHMAC_sendPacketVector(&pui8FramePtr, &ui16DataLength, UC_1, ui64HWSrcAdd, ui64HWDstAdd, ui16EthType, NULL_PTR);
+}
+
+
+/* queue a packet made of several data segments without copying them: 1 TX descriptor is chained for each one.
+   The function returns without waiting for the transmission. A buffer can be held by the frame: it is passed to
+   the TX done callback once the frame is sent. Return B_FALSE if the TX ring is full: the packet is not queued
+   and the held buffer is not taken.
+   ATTENTION: segments shall not be modified until the frame is sent */
+EXPORTED boolean ETHMAC_sendPacketVector( uint8 **ppui8SegmentsPtr, uint16 *pui16SegmentsLength, uint8 ui8SegmentsNum, uint64 ui64HWSrcAdd, uint64 ui64HWDstAdd, uint16 ui16EthType, uint8 *pui8HeldBuffer )
+{
+    uint8 *pui8EthernetHeader;
+    uint8 *apui8PtrsArray[UC_1 + ETHMAC_UC_TX_MAX_SEGMENTS];
+    uint16 aui16LengthArray[UC_1 + ETHMAC_UC_TX_MAX_SEGMENTS];
+    uint8 ui8SegmentIdx;
+    uint8 ui8Slot;
+    boolean bQueued;
+
+    /* ATTENTION: exceeding segments are not sent */
+    if(ui8SegmentsNum > ETHMAC_UC_TX_MAX_SEGMENTS)
+    {
+        ui8SegmentsNum = ETHMAC_UC_TX_MAX_SEGMENTS;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    /* get a free slot: it is already the one of the buffer given by ETHMAC_getTXBufferPointer, if any */
+    ui8Slot = getFreeTXSlot();
+
+    if(ui8Slot < ETHMAC_UC_TX_NUM_OF_BUFFERS)
+    {
+        /* ethernet header is written in the header buffer of the frame slot */
+        pui8EthernetHeader = (uint8 *)aui32TXEthHeaders[ui8Slot];
+
+        /* set ETH addresses and type */
+        setDestMACAddress(&pui8EthernetHeader[UC_0], ui64HWDstAdd);
+        setSrcMACAddress(&pui8EthernetHeader[ETHMAC_UC_ETH_ADD_LENGTH], ui64HWSrcAdd);
+        /* set ethernet type */
+        SET_ETHERTYPE(*((uint16 *)(&pui8EthernetHeader[(UC_2 * ETHMAC_UC_ETH_ADD_LENGTH)])), ui16EthType);
+
+        /* 1 TX descriptor for the ethernet header */
+        apui8PtrsArray[UC_0] = pui8EthernetHeader;
+        aui16LengthArray[UC_0] = ETHMAC_UC_ETH_HDR_LENGTH;
+
+        /* 1 TX descriptor for each data segment */
+        for(ui8SegmentIdx = UC_NULL; ui8SegmentIdx < ui8SegmentsNum; ui8SegmentIdx++)
+        {
+            apui8PtrsArray[UC_1 + ui8SegmentIdx] = ppui8SegmentsPtr[ui8SegmentIdx];
+            aui16LengthArray[UC_1 + ui8SegmentIdx] = pui16SegmentsLength[ui8SegmentIdx];
+        }
+
+        /* TX descriptors are chained from start to end of packet */
+        sendPacket(ui8Slot, apui8PtrsArray, aui16LengthArray, (uint16)(UC_1 + ui8SegmentsNum), pui8HeldBuffer);
+
+        bQueued = B_TRUE;
+    }
+    else
+    {
+        /* TX ring is full: nothing is queued */
+        bQueued = B_FALSE;
+    }
 
-    /* 2 TX descriptors are used for each TX packet */
-    sendPacket(apui8PtrsArray, aui16LengthArray, US_2);
+    return bQueued;
 }
 
 
-/* Function to get next TX buffer pointer where upper layers write data.
-   The pointer value is calculated according to required buffer length. */
+/* Function to get next TX buffer pointer where upper layers write data. It is the buffer of the next frame slot
+   of the TX ring. The pointer value is calculated according to required buffer length.
+   Return NULL if the TX ring is full: sent frames are reclaimed but the current one is not waited for */
 EXPORTED uint8 * ETHMAC_getTXBufferPointer( uint16 ui16ReqBufLength )
 {
-    uint8 *pui8RetPtr;
+    uint8 *pui8RetPtr = NULL_PTR;
+    uint8 ui8Slot;
 
-    /* ATTENTION: only one buffer is used at the moment */
-    pui8RetPtr = (uint8 *)(apui8TXDcptDataBuffers[0] - ui16ReqBufLength);
+    ui8Slot = getFreeTXSlot();
+
+    if(ui8Slot < ETHMAC_UC_TX_NUM_OF_BUFFERS)
+    {
+        pui8RetPtr = (uint8 *)(apui8TXDcptDataBuffers[ui8Slot] - ui16ReqBufLength);
+    }
+    else
+    {
+        /* TX ring is full */
+    }
 
     return pui8RetPtr;
 }
 
 
+/* set the callback to pass buffers held by sent frames to */
+EXPORTED void ETHMAC_setTXDoneCallback( ETHMAC_pfTXDoneCallback pfCallback )
+{
+    pfTXDoneCallback = pfCallback;
+}
+
+
+/* set the callback to notify sent or aborted frames to. ATTENTION: it is called in interrupt context */
+EXPORTED void ETHMAC_setTXNotifyCallback( ETHMAC_pfTXNotifyCallback pfCallback )
+{
+    pfTXNotifyCallback = pfCallback;
+}
+
+
+/* set the callback to notify received frames to. ATTENTION: it is called in interrupt context */
+EXPORTED void ETHMAC_setRXNotifyCallback( ETHMAC_pfRXNotifyCallback pfCallback )
+{
+    pfRXNotifyCallback = pfCallback;
+}
+
+
+/* reclaim sent frames slots and pass their held buffers to the TX done callback.
+   If TX done interrupt is disabled then the end of the current frame is polled here and the next one is started */
+EXPORTED void ETHMAC_processTXDone( void )
+{
+    uint8 ui8DoneFrames;
+
+    DISABLE_ETH_INT();
+
+#if ETHMAC_TX_DONE_INTERRUPT_ENABLED == 0
+    /* TXRTS bit is cleared by hardware at the end of the transmission */
+    if((B_TRUE == bTXActive)
+    && (!CHECK_TX_IS_RUNNING()))
+    {
+        completeTXFrame();
+    }
+    else
+    {
+        /* no frame or still running */
+    }
+#endif
+
+    ui8DoneFrames = ui8TXDoneFrames;
+    ui8TXDoneFrames = UC_NULL;
+
+    ENABLE_ETH_INT();
+
+    /* callback is called with interrupt enabled */
+    while(ui8DoneFrames > UC_NULL)
+    {
+        if((apui8TXHeldBuffers[ui8TXTailSlot] != NULL_PTR)
+        && (pfTXDoneCallback != NULL_PTR))
+        {
+            pfTXDoneCallback(apui8TXHeldBuffers[ui8TXTailSlot]);
+        }
+        else
+        {
+            /* nothing to give back */
+        }
+        apui8TXHeldBuffers[ui8TXTailSlot] = NULL_PTR;
+
+        ui8TXTailSlot = GET_NEXT_TX_SLOT(ui8TXTailSlot);
+        ui8TXUsedSlots--;
+        ui8DoneFrames--;
+    }
+}
+
+
 
 
 /* ------------------ Local functions implementation --------------------- */
@@ -558,16 +922,19 @@ LOCAL void setSrcMACAddress(uint8 *pui8Frame, uint64 ui64MACAddress)
 }
 
 
-/* update TX descriptors fields and start transmission */
-LOCAL void sendPacket( uint8 **pui8ArrayBuffers, uint16 *pui16ArraySizes, uint16 ui16ArrayItems )
+/* update TX descriptors fields of the next free slot and queue the frame. Transmission starts at once if the
+   TX ring is idle, otherwise when previous frames are sent */
+LOCAL void sendPacket( uint8 ui8Slot, uint8 **pui8ArrayBuffers, uint16 *pui16ArraySizes, uint16 ui16ArrayItems, uint8 *pui8HeldBuffer )
 {
     uint8 ui8BufferIndex;
+    st_TXEthDcpt* pstFirstDcpt;
     st_TXEthDcpt* pstCurrDcpt;
     st_TXEthDcpt* pstTailDcpt;
 
     /* init descriptors */
-    pstCurrDcpt = stTXArrayDcpt;    /* init current descriptor with the first one */
-    pstTailDcpt = NULL;                        /* init tail descriptor with 0 */
+    pstFirstDcpt = GET_TX_SLOT_DCPT(ui8Slot);
+    pstCurrDcpt = pstFirstDcpt;     /* init current descriptor with the first one of the slot */
+    pstTailDcpt = NULL;             /* init tail descriptor with 0 */
 
     /* set every descriptor with data buffers */
     for(ui8BufferIndex = UC_NULL;
@@ -586,22 +953,93 @@ LOCAL void sendPacket( uint8 **pui8ArrayBuffers, uint16 *pui16ArraySizes, uint16
         }
         pstTailDcpt = pstCurrDcpt;
     }
-    /* descriptors list end as circular buffer (set the first buffer as the next one) */
-    pstTailDcpt->next_ed = KVA_TO_PA(stTXArrayDcpt); /* anyway this is not used */
+    /* descriptors list end as circular buffer (set the first buffer of the slot as the next one).
+       It is owned by software once sent, so the transmission stops at the end of the frame */
+    pstTailDcpt->next_ed = KVA_TO_PA(pstFirstDcpt);
 
     /* prepare descriptors array */
-    stTXArrayDcpt[0].hdr.SOP = 1;   /* start of packet */
-    stTXArrayDcpt[(ui16ArrayItems - US_1)].hdr.EOP = 1; /* end of packet */
+    pstFirstDcpt->hdr.SOP = 1;      /* start of packet */
+    pstTailDcpt->hdr.EOP = 1;       /* end of packet */
+
+    /* frame holds the buffer until it is sent */
+    apui8TXHeldBuffers[ui8Slot] = pui8HeldBuffer;
 
-    /* set the TX descriptors start address */
-    ETHTXST = KVA_TO_PA(stTXArrayDcpt);
+    /* queue the frame */
+    ui8TXHeadSlot = GET_NEXT_TX_SLOT(ui8TXHeadSlot);
+    ui8TXUsedSlots++;
+
+    DISABLE_ETH_INT();
 
-    /* start transmission */
-    ETHCON1SET = (1 << ETHCON_TXRTS_BIT_POS);
+    ui8TXWaitingFrames++;
+    /* start it if TX is idle */
+    startNextTXFrame();
 
-    /* wait until packet is sent */
-    while(CHECK_TX_IS_DONE());
-    /* ATTENTION: maybe it is not necessary to wait... */
+    ENABLE_ETH_INT();
+}
+
+
+/* get the next free slot of the TX ring. If the ring is full then sent frames are reclaimed once without waiting.
+   Return ETHMAC_UC_TX_NUM_OF_BUFFERS if no slot is free */
+LOCAL uint8 getFreeTXSlot( void )
+{
+    uint8 ui8Slot = ETHMAC_UC_TX_NUM_OF_BUFFERS;
+
+    /* if the ring is full then reclaim sent frames */
+    if(ui8TXUsedSlots >= ETHMAC_UC_TX_NUM_OF_BUFFERS)
+    {
+        ETHMAC_processTXDone();
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    if(ui8TXUsedSlots < ETHMAC_UC_TX_NUM_OF_BUFFERS)
+    {
+        ui8Slot = ui8TXHeadSlot;
+    }
+    else
+    {
+        /* no free slot */
+    }
+
+    return ui8Slot;
+}
+
+
+/* start the next queued frame if TX is idle.
+   ATTENTION: it shall be called with ETH interrupt disabled or from the ETH interrupt */
+LOCAL void startNextTXFrame( void )
+{
+    if((B_TRUE != bTXActive)
+    && (ui8TXWaitingFrames > UC_NULL))
+    {
+        /* set the TX descriptors start address */
+        ETHTXST = KVA_TO_PA(GET_TX_SLOT_DCPT(ui8TXStartSlot));
+
+        /* start transmission */
+        ETHCON1SET = (1 << ETHCON_TXRTS_BIT_POS);
+
+        bTXActive = B_TRUE;
+        ui8TXStartSlot = GET_NEXT_TX_SLOT(ui8TXStartSlot);
+        ui8TXWaitingFrames--;
+    }
+    else
+    {
+        /* TX busy or nothing to send */
+    }
+}
+
+
+/* end of the current frame: mark it as done and start the next queued one.
+   ATTENTION: it shall be called with ETH interrupt disabled or from the ETH interrupt */
+LOCAL void completeTXFrame( void )
+{
+    bTXActive = B_FALSE;
+    ui8TXDoneFrames++;
+
+    /* back to back frames */
+    startNextTXFrame();
 }
 
 
@@ -647,6 +1085,77 @@ LOCAL void setRXPacket( uint8** pui8ArrayBuffers, uint16 ui16ArraySize, uint16 u
 }
 
 
+/* give a RX descriptor back to hardware */
+LOCAL void restoreRXDescriptor( st_RXEthDcpt *pstDcpt )
+{
+    pstDcpt->hdr.w = 0;           /* clear all the fields */
+    pstDcpt->hdr.flags.NPV = 1;   /* set next pointer valid */
+    pstDcpt->hdr.flags.EOWN = 1;  /* set hardware ownership */
+    pstDcpt->stat.s = 0;          /* clear stat field */
+
+    /* decrement received packet buffer count */
+    ETHCON1SET = (1 << ETHCON_BUFCDEC_BIT_POS);
+}
+
+
+/* give back to hardware the descriptors returned by the last ETHMAC_getRXDataBuffers call
+   and move the ring head after them. Lent buffers have been already replaced by spare ones */
+LOCAL void restorePendingRXDcpts( void )
+{
+    while(ui8RXPendingNum > UC_NULL)
+    {
+        restoreRXDescriptor(&stRXArrayDcpt[ui8RXHeadIdx]);
+
+        ui8RXHeadIdx = GET_RX_RING_IDX(ui8RXHeadIdx + UC_1);
+        ui8RXPendingNum--;
+    }
+}
+
+
+/* get the index of the RX descriptor whose data buffer contains the given pointer.
+   Return UC_NUM_OF_RX_DCPT if not found */
+LOCAL uint8 getRXDcptIndexFromPtr( uint8 *pui8DataPtr )
+{
+    uint8 ui8DcptIndex = UC_NULL;
+    uint32 ui32PhyAdd;
+
+    /* ATTENTION: compare physical addresses. Upper layers use uncached (KSEG1) pointers */
+    ui32PhyAdd = KVA_TO_PA(pui8DataPtr);
+
+    /* search the data buffer */
+    while((ui8DcptIndex < UC_NUM_OF_RX_DCPT)
+    &&    ((ui32PhyAdd < (uint32)stRXArrayDcpt[ui8DcptIndex].pEDBuff)
+    ||     (ui32PhyAdd >= ((uint32)stRXArrayDcpt[ui8DcptIndex].pEDBuff + US_DATA_BUFFER_LENGTH))))
+    {
+        ui8DcptIndex++;
+    }
+
+    return ui8DcptIndex;
+}
+
+
+/* get the index of the RX buffer out of the ring that contains the given pointer.
+   Return ETHMAC_UC_RX_MAX_LENT_BUFFERS if not found */
+LOCAL uint8 getRXLoanIndexFromPtr( uint8 *pui8DataPtr )
+{
+    uint8 ui8LoanIndex = UC_NULL;
+    uint32 ui32PhyAdd;
+
+    /* ATTENTION: compare physical addresses. Upper layers use uncached (KSEG1) pointers */
+    ui32PhyAdd = KVA_TO_PA(pui8DataPtr);
+
+    /* search the data buffer */
+    while((ui8LoanIndex < ETHMAC_UC_RX_MAX_LENT_BUFFERS)
+    &&    ((ui32PhyAdd < KVA_TO_PA(apui8RXLoanBuffers[ui8LoanIndex]))
+    ||     (ui32PhyAdd >= (KVA_TO_PA(apui8RXLoanBuffers[ui8LoanIndex]) + US_DATA_BUFFER_LENGTH))))
+    {
+        ui8LoanIndex++;
+    }
+
+    return ui8LoanIndex;
+}
+
+
 /* reset ETH controller */
 LOCAL void resetEthController(void)
 {
@@ -711,8 +1220,8 @@ LOCAL void configureMACModule (void)
     EMAC1CFG2CLR = (1 << CRCENABLE_BIT_POS);
 #endif
 
-    /* allow to tx and rx huge frames */
-    EMAC1CFG2SET = (1 << HUGEFRM_BIT_POS);
+    /* do not allow huge frames: received frames longer than MAC_RX_MAX_FRAME are discarded */
+    EMAC1CFG2CLR = (1 << HUGEFRM_BIT_POS);
 
     /* ATTENTION: if following values are defined as default register values than it is not necessary to write them */
     /* program back-to-back inter-packet gap */
@@ -797,8 +1306,16 @@ LOCAL void initEthController( void )
     ETHIENSET = (1 << TXBUSEIE_BIT_POS);
     ETHIENSET = (1 << RXBUSEIE_BIT_POS);
 //    ETHIENSET = (1 << FWMARKIE_BIT_POS);
-//    ETHIENSET = (1 << RXDONEIE_BIT_POS);
-//    ETHIENSET = (1 << TXDONEIE_BIT_POS);
+#if ETHMAC_RX_DONE_INTERRUPT_ENABLED == 1
+    /* received frames are notified as soon as they are written or when no RX descriptor is left */
+    ETHIENSET = (1 << RXDONEIE_BIT_POS);
+    ETHIENSET = (1 << RXBUFNAIE_BIT_POS);
+#endif
+#if ETHMAC_TX_DONE_INTERRUPT_ENABLED == 1
+    /* next queued frame is started at the end of the current one */
+    ETHIENSET = (1 << TXDONEIE_BIT_POS);
+    ETHIENSET = (1 << TXABORTIE_BIT_POS);
+#endif
     ETHIENSET = (1 << RXOVFLWIE_BIT_POS);
 
     /* set int priority */
@@ -922,8 +1439,44 @@ LOCAL void __ISR(_ETH_VECTOR, ipl5) Eth_IntHandler (void)
 //    if((ui16EthFlags & (1 << ETHIRQ_TXBUSE_BIT_POS)) > 0)
 //    if((ui16EthFlags & (1 << ETHIRQ_RXBUSE_BIT_POS)) > 0)
 //    if((ui16EthFlags & (1 << ETHIRQ_RXOVFLW_BIT_POS)) > 0)
-//    if((ui16EthFlags & (1 << ETHIRQ_RXDONE_BIT_POS)) > 0)
-//    if((ui16EthFlags & (1 << ETHIRQ_TXDONE_BIT_POS)) > 0)
+
+#if ETHMAC_RX_DONE_INTERRUPT_ENABLED == 1
+    /* if a frame has been received, no RX descriptor is available or the RX FIFO overflowed */
+    if(((ui16EthFlags & ((1 << ETHIRQ_RXDONE_BIT_POS) | (1 << ETHIRQ_RXBUFNA_BIT_POS) | (1 << ETHIRQ_RXOVFLW_BIT_POS))) > 0)
+    && (pfRXNotifyCallback != NULL_PTR))
+    {
+        /* notify upper layers: frames are read out of the interrupt */
+        pfRXNotifyCallback();
+    }
+    else
+    {
+        /* no RX event */
+    }
+#endif
+
+#if ETHMAC_TX_DONE_INTERRUPT_ENABLED == 1
+    /* if current frame has been sent or aborted */
+    if(((ui16EthFlags & ((1 << ETHIRQ_TXDONE_BIT_POS) | (1 << ETHIRQ_TXABORT_BIT_POS))) > 0)
+    && (B_TRUE == bTXActive))
+    {
+        /* start the next one: slot is reclaimed by ETHMAC_processTXDone */
+        completeTXFrame();
+
+        /* notify upper layers that a slot can be reclaimed */
+        if(pfTXNotifyCallback != NULL_PTR)
+        {
+            pfTXNotifyCallback();
+        }
+        else
+        {
+            /* no callback */
+        }
+    }
+    else
+    {
+        /* no TX event */
+    }
+#endif
 
     /* clear interrupt flag */
     CLEAR_ETH_INT_FLAG();
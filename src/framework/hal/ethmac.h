@@ -59,11 +59,53 @@
 /* Ethernet packet header length in bytes */
 #define ETHMAC_UC_ETH_ADD_LENGTH                ((uint8)6)
 
+/* Max MTU in bytes supported by RX and TX data buffers. A received frame always fits in a single RX buffer:
+   longer frames are discarded by the MAC and frames spanning more descriptors are dropped */
+#define ETHMAC_US_MAX_MTU                       (1500)
+
 /* Num of RX buffers */
 #define ETHMAC_UC_RX_NUM_OF_BUFFERS             (8)
 
-/* Num of TX buffers */
-#define ETHMAC_UC_TX_NUM_OF_BUFFERS             (1)
+/* Num of TX frames that can be queued in the TX ring. Each one has its own buffer for data written by upper layers */
+#define ETHMAC_UC_TX_NUM_OF_BUFFERS             (4)
+
+/* Enable (1) or disable (0) TX done interrupt. If enabled the next queued frame is started by the interrupt,
+   otherwise it is started by ETHMAC_processTXDone() polling */
+#define ETHMAC_TX_DONE_INTERRUPT_ENABLED        (1)
+
+/* Enable (1) or disable (0) RX done interrupt. If enabled the RX notify callback is called by the interrupt
+   at each received frame, otherwise received frames are found by upper layers polling only */
+#define ETHMAC_RX_DONE_INTERRUPT_ENABLED        (1)
+
+/* Max num of data segments of a TX frame after the Ethernet header. One TX descriptor is used for each one */
+#define ETHMAC_UC_TX_MAX_SEGMENTS               (2)
+
+/* Max num of RX buffers that can be lent to upper layers at the same time. The same num of spare buffers is allocated:
+   a lent buffer is swapped with a spare one in its descriptor, so the RX ring never waits for lent buffers.
+   When no spare buffer is left, lending fails and upper layers shall copy the data */
+#define ETHMAC_UC_RX_MAX_LENT_BUFFERS           (4)
+
+/* Enable (1) or disable (0) the use of the RX descriptor payload checksum.
+   ATTENTION: it is assumed to be the one's complement sum, not inverted, of the frame bytes following
+   the Ethernet header up to the FCS excluded, taken as big-endian 16-bit words. IPv4 layer checks it against
+   the software sum of the first received packets and stops using it if they differ */
+#define ETHMAC_RX_HW_CHECKSUM_ENABLED           (1)
+
+
+
+
+/* --------------- Exported types definitions ---------------- */
+
+/* TX done callback type: buffer held by a sent frame. It is called by ETHMAC_processTXDone() */
+typedef void (* ETHMAC_pfTXDoneCallback)(uint8 *);
+
+
+/* RX notify callback type. ATTENTION: it is called in interrupt context, so it shall only signal upper layers */
+typedef void (* ETHMAC_pfRXNotifyCallback)(void);
+
+
+/* TX notify callback type. ATTENTION: it is called in interrupt context, so it shall only signal upper layers */
+typedef void (* ETHMAC_pfTXNotifyCallback)(void);
 
 
 
@@ -80,8 +122,19 @@ EXTERN uint64 ETHMAC_ui64MACAddress;
 
 EXTERN boolean  ETHMAC_Init                 (void);
 EXTERN uint8 *  ETHMAC_getNextRXDataBuffer  (void);
-EXTERN void     ETHMAC_sendPacket           (uint8 *, uint16, uint64, uint64, uint16);
+EXTERN uint8    ETHMAC_getRXDataBuffers     (uint8 **, uint8);
+EXTERN boolean  ETHMAC_isRXFrameWaiting     (void);
+EXTERN boolean  ETHMAC_lendRXDataBuffer     (uint8 *);
+EXTERN void     ETHMAC_releaseRXDataBuffer  (uint8 *);
+EXTERN boolean  ETHMAC_getRXPayloadChecksum (uint8 *, uint16 *, uint16 *);
+EXTERN uint16   ETHMAC_getRXPayloadLength   (uint8 *);
+EXTERN boolean  ETHMAC_sendPacket           (uint8 *, uint16, uint64, uint64, uint16);
+EXTERN boolean  ETHMAC_sendPacketVector     (uint8 **, uint16 *, uint8, uint64, uint64, uint16, uint8 *);
 EXTERN uint8 *  ETHMAC_getTXBufferPointer   (uint16);
+EXTERN void     ETHMAC_setTXDoneCallback    (ETHMAC_pfTXDoneCallback);
+EXTERN void     ETHMAC_processTXDone        (void);
+EXTERN void     ETHMAC_setRXNotifyCallback  (ETHMAC_pfRXNotifyCallback);
+EXTERN void     ETHMAC_setTXNotifyCallback  (ETHMAC_pfTXNotifyCallback);
 
 
 
@@ -130,12 +130,38 @@ LOCAL uint32 ui32TickCount = UL_NULL;
 /* RTOS tick overflow counter */
 LOCAL uint16 ui16TickOverflow = US_NULL;
 
+/* store event handler function pointers */
+LOCAL callback_ptr_t apvEventHandlers[RTOS_EV_ID_MAX_NUM] =
+{
+    NULL,
+    NULL
+};
+
+/* store num of signals that make an event handler run at once */
+LOCAL uint8 aui8EventCoalesceCount[RTOS_EV_ID_MAX_NUM];
+
+/* store max time in ms an event handler run is delayed to coalesce signals */
+LOCAL uint32 aui32EventCoalesceTimeout[RTOS_EV_ID_MAX_NUM];
+
+/* store num of signals of all events. They are written by the signalling side only (i.e. interrupts) */
+LOCAL volatile uint32 aui32EventSignalCount[RTOS_EV_ID_MAX_NUM];
+
+/* store num of managed signals of all events. They are written by the execution task only */
+LOCAL uint32 aui32EventHandledCount[RTOS_EV_ID_MAX_NUM];
+
+/* store time in ms of the first signal not managed yet of all events */
+LOCAL uint32 aui32EventFirstSignalTime[RTOS_EV_ID_MAX_NUM];
+
+/* store waiting flag of all events: signals are being coalesced */
+LOCAL boolean abEventWaiting[RTOS_EV_ID_MAX_NUM];
+
 
 
 
 /* ------------- Local functions prototypes ------------- */
 
 LOCAL uint8 getNewStateToSwitch( uint8 );
+LOCAL void  manageEvents        ( void );
 
 
 
@@ -206,6 +232,65 @@ EXPORTED void RTOS_StopCallback (RTOS_ke_CallbackID eCallbackID)
 }
 
 
+/* set an event handler. It is called by the execution task as soon as the given num of signals is reached or
+   the given time in ms has elapsed since the first signal, so close signals are coalesced into one call */
+EXPORTED void RTOS_SetEventHandler (RTOS_ke_EventID eEventID, uint8 ui8CoalesceCount, uint32 ui32CoalesceTimeoutMs, void * pHandlerFunction)
+{
+    if((eEventID < RTOS_EV_ID_CHECK)
+    && (ui8CoalesceCount > UC_NULL)
+    && (ui32CoalesceTimeoutMs <= U32_CALLBACK_MAX_VALUE_MS)
+    && (pHandlerFunction != NULL))
+    {
+        /* store coalescing parameters */
+        aui8EventCoalesceCount[eEventID] = ui8CoalesceCount;
+        aui32EventCoalesceTimeout[eEventID] = ui32CoalesceTimeoutMs;
+
+        /* previous signals are discarded */
+        aui32EventHandledCount[eEventID] = aui32EventSignalCount[eEventID];
+        abEventWaiting[eEventID] = B_FALSE;
+
+        /* store handler function pointer. do it as last operation */
+        apvEventHandlers[eEventID] = pHandlerFunction;
+    }
+    else
+    {
+        /* invalid parameters */
+    }
+}
+
+
+/* stop an event handler */
+EXPORTED void RTOS_StopEventHandler (RTOS_ke_EventID eEventID)
+{
+    if(eEventID < RTOS_EV_ID_CHECK)
+    {
+        /* clear handler function pointer. do it as first operation */
+        apvEventHandlers[eEventID] = NULL_PTR;
+
+        abEventWaiting[eEventID] = B_FALSE;
+    }
+    else
+    {
+        /* invalid parameters */
+    }
+}
+
+
+/* signal an event. It can be called from interrupts: the handler is called by the execution task */
+EXPORTED void RTOS_SignalEvent (RTOS_ke_EventID eEventID)
+{
+    if(eEventID < RTOS_EV_ID_CHECK)
+    {
+        /* only the signalling side writes this counter */
+        aui32EventSignalCount[eEventID]++;
+    }
+    else
+    {
+        /* invalid parameters */
+    }
+}
+
+
 /* Manage RTOS tick timer */
 EXPORTED void RTOS_TickTimerCallback( void )
 {
@@ -367,6 +452,9 @@ EXPORTED void RTOS_executeTask ( void )
         }
         /* else leave it to expire */
     }
+
+    /* manage signalled events without waiting for tasks time base */
+    manageEvents();
 }
 
 
@@ -379,12 +467,10 @@ EXPORTED uint32 RTOS_tickCountGet ( void )
     /* Get the current TMR value */
     CurTmrVal = (uint32)TMR_getTimerCounter();
 
-    /* Calculate the tick count in us */
-    tickCount = ( ( ui32TickCount * RTOS_UL_TICK_PERIOD_US ) +
-                  ( CurTmrVal % RTOS_UL_TICK_PERIOD_US ) );
-
-    /* Convert the tick count in ms */
-    tickCount /= UL_1000;
+    /* Calculate the tick count in ms: whole ticks plus the elapsed part of the current one,
+       so that the value wraps modulo 2^32 ms */
+    tickCount = ( ( ui32TickCount * ( RTOS_UL_TICK_PERIOD_US / UL_1000 ) ) +
+                  ( ( CurTmrVal % RTOS_UL_TICK_PERIOD_US ) / UL_1000 ) );
 
     /* Returns the alarm count value */
     return ( tickCount );
@@ -396,6 +482,62 @@ EXPORTED uint32 RTOS_tickCountGet ( void )
 
 /* -------------- Local functions implementation ----------------- */
 
+/* call handlers of events whose signals reached the coalescing count or timeout */
+LOCAL void manageEvents( void )
+{
+    uint8 ui8EventIndex;
+    uint32 ui32SignalCount;
+    uint32 ui32PendingSignals;
+    uint32 ui32Now;
+
+    for(ui8EventIndex = UC_NULL; ui8EventIndex < RTOS_EV_ID_CHECK; ui8EventIndex++)
+    {
+        /* read counter once: it can be incremented by interrupts meanwhile */
+        ui32SignalCount = aui32EventSignalCount[ui8EventIndex];
+        ui32PendingSignals = (ui32SignalCount - aui32EventHandledCount[ui8EventIndex]);
+
+        /* manage events with a handler and pending signals only */
+        if((apvEventHandlers[ui8EventIndex] != NULL_PTR)
+        && (ui32PendingSignals > UL_NULL))
+        {
+            ui32Now = RTOS_tickCountGet();
+
+            /* start coalescing at first signal */
+            if(B_TRUE != abEventWaiting[ui8EventIndex])
+            {
+                aui32EventFirstSignalTime[ui8EventIndex] = ui32Now;
+                abEventWaiting[ui8EventIndex] = B_TRUE;
+            }
+            else
+            {
+                /* already waiting */
+            }
+
+            /* if enough signals or waited enough */
+            if((ui32PendingSignals >= (uint32)aui8EventCoalesceCount[ui8EventIndex])
+            || ((uint32)(ui32Now - aui32EventFirstSignalTime[ui8EventIndex]) >= aui32EventCoalesceTimeout[ui8EventIndex]))
+            {
+                /* all pending signals are managed by a single call */
+                aui32EventHandledCount[ui8EventIndex] = ui32SignalCount;
+                abEventWaiting[ui8EventIndex] = B_FALSE;
+
+                /* call handler function */
+                (*apvEventHandlers[ui8EventIndex])();
+            }
+            else
+            {
+                /* keep coalescing */
+            }
+        }
+        else
+        {
+            /* signals without a handler are discarded */
+            aui32EventHandledCount[ui8EventIndex] = ui32SignalCount;
+        }
+    }
+}
+
+
 /* This function determines the next RTOS mode */
 LOCAL uint8 getNewStateToSwitch( uint8 actualState_u8 )
 {
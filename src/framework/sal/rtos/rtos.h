@@ -66,6 +66,15 @@ typedef enum
     RTOS_CB_TYPE_CHECK
 } RTOS_ke_CallbackType;
 
+/* Event IDs */
+typedef enum
+{
+    RTOS_EV_ID_1,
+    RTOS_EV_ID_2,
+    RTOS_EV_ID_MAX_NUM,
+    RTOS_EV_ID_CHECK = RTOS_EV_ID_MAX_NUM
+} RTOS_ke_EventID;
+
 
 /*==============================================================================
    Exported Defines
@@ -98,6 +107,9 @@ EXTERN void     RTOS_stopOperation          (void);
 EXTERN void     RTOS_startOperation         (RTOS_CFG_ke_states);
 EXTERN void     RTOS_executeTask            (void);
 EXTERN uint32   RTOS_tickCountGet           (void);
+EXTERN void     RTOS_SetEventHandler        (RTOS_ke_EventID, uint8, uint32, void *);
+EXTERN void     RTOS_StopEventHandler       (RTOS_ke_EventID);
+EXTERN void     RTOS_SignalEvent            (RTOS_ke_EventID);
 
 EXTERN void RTOS_CallbackTemp ( void );
 
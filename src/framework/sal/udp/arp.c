@@ -34,13 +34,11 @@
 
 /*
 TODO LIST:
-    1)  limit the number and the frequency of ARP requests
-    2)  check IP address validity in ARP_getEthAddFromIPAdd function (0.0.0.X addresses should not be used... maybe)
-    3)  the first value of the local IP add table is overwritten in case of table full. Change the behaviour.
+    1)  check IP address validity in ARP_resolveEthAdd function (0.0.0.X addresses should not be used... maybe)
+    2)  the first value of the local IP add table is overwritten in case of table full. Change the behaviour.
         See ARP_setLocalIPAddress() function
-    4)  implement counters to free IP addresses locations after a while (least used IP addresses are removed first)
-    5)  check some packets fields in decodeARPPacket() function
-    6)  implement a addresses validity check in ARP_setEthAddToIPAdd function
+    3)  check some packets fields in decodeARPPacket() function
+    4)  implement a addresses validity check in ARP_setEthAddToIPAdd function
 */
 
 
@@ -52,6 +50,7 @@ TODO LIST:
 
 #include "../../fw_common.h"
 #include "../../hal/ethmac.h"
+#include "../rtos/rtos.h"
 
 #include "arp.h"
 
@@ -63,11 +62,24 @@ TODO LIST:
 /* Max num of local IP addresses */
 #define UC_MAX_NUM_OF_LOCAL_IP_ADD      ((uint8)4)
 
-/* Max num of IP addresses */
-#define UC_MAX_NUM_OF_IP_ADD            ((uint8)8)
+/* End of list value of ARP cache hash table buckets */
+#define UC_HASH_END_OF_LIST             ((uint8)0)
 
-/* Max num of ETH addresses */
-#define UC_MAX_NUM_OF_ETH_ADD           ((uint8)8)
+/* ARP cache entry timeout in ms. Times are given by RTOS_tickCountGet() in ms */
+#define UL_CACHE_ENTRY_TIMEOUT_MS       ((uint32)(ARP_UL_CACHE_ENTRY_TIMEOUT_S * UL_1000))
+
+/* age in ms of a hot peer entry when its refresh requests start */
+#define UL_HOT_PEER_REFRESH_MS          ((uint32)((ARP_UL_CACHE_ENTRY_TIMEOUT_S - ARP_UL_HOT_PEER_REFRESH_MARGIN_S) * UL_1000))
+
+/* value check: at least one cache entry shall be replaceable */
+#if ARP_UC_MAX_NUM_OF_HOT_PEERS >= ARP_UC_CACHE_SIZE
+#error ARP_UC_MAX_NUM_OF_HOT_PEERS define is not lower than ARP_UC_CACHE_SIZE
+#endif
+
+/* value check */
+#if ARP_UL_HOT_PEER_REFRESH_MARGIN_S >= ARP_UL_CACHE_ENTRY_TIMEOUT_S
+#error ARP_UL_HOT_PEER_REFRESH_MARGIN_S define is not lower than ARP_UL_CACHE_ENTRY_TIMEOUT_S
+#endif
 
 /* Broadcast MAC address */
 #define BROADCAST_MAC_ADDRESS           ((uint64)0x0000FFFFFFFFFFFF)
@@ -90,6 +102,21 @@ TODO LIST:
 #define ARP_OP_REQUEST                  ((uint16)1)
 #define ARP_OP_REPLY                    ((uint16)2)
 
+/* value check */
+#if (ARP_UC_CACHE_HASH_TABLE_SIZE & (ARP_UC_CACHE_HASH_TABLE_SIZE - 1)) != 0
+#error ARP_UC_CACHE_HASH_TABLE_SIZE define is not a power of 2
+#endif
+
+/* value check: the retry period is doubled at each request */
+#if (ARP_UC_MAX_REQUESTS < 1) || (ARP_UC_MAX_REQUESTS > 16)
+#error ARP_UC_MAX_REQUESTS define is out of range
+#endif
+
+/* value check: entries are linked by their index plus 1 */
+#if (ARP_UC_CACHE_SIZE < 1) || (ARP_UC_CACHE_SIZE > 254)
+#error ARP_UC_CACHE_SIZE define is out of range
+#endif
+
 
 
 
@@ -113,25 +140,37 @@ TODO LIST:
 #define GET_HIGH_16BIT(x)               (SWAP_BYTES_ORDER_16BIT_((x & 0x0000FFFF)))
 #define GET_LOW_16BIT(x)                (SWAP_BYTES_ORDER_16BIT_(((x & 0xFFFF0000) >> UL_SHIFT_16)))
 
+/* get ARP cache hash table bucket of an IP address: host bits are in the low order bytes */
+#define GET_CACHE_HASH(x)               (((x) ^ ((x) >> UL_SHIFT_8) ^ ((x) >> UL_SHIFT_16)) & (ARP_UC_CACHE_HASH_TABLE_SIZE - 1))
 
+/* get time in ms elapsed since last state change of an ARP cache entry */
+#define GET_STATE_TIME(x,y)             ((uint32)((y) - (x)->ui32StateTime))
 
+/* check if an ARP cache entry has not been updated for too long */
+#define IS_ENTRY_EXPIRED(x,y)           (GET_STATE_TIME((x),(y)) >= UL_CACHE_ENTRY_TIMEOUT_MS)
+
+/* check if the last ARP request of an entry has not been answered in time: exponential back-off */
+#define IS_RETRY_EXPIRED(x,y)           (GET_STATE_TIME((x),(y)) >= ((uint32)ARP_UL_RETRY_BASE_PERIOD_MS << ((x)->ui8Requests - UC_1)))
 
-/* ----------------- Local typedefs definition ------------------- */
 
-/* struct to store correlation between IP address and ETH addresses array index */
-typedef struct
-{
-    uint32 ui32IPAdd;       /* IP address value */
-    uint8 ui8EthAddIndex;   /* Index of ETH addresses array */
-} st_IPAddToEthAddIdx;
 
 
-/* struct to store router IP address and subnet mask */
+/* ----------------- Local typedefs definition ------------------- */
+
+/* ARP cache entry struct */
 typedef struct
 {
-    uint32 ui32RouterIPAdd;     /* router IP address value */
-    uint32 ui32SubnetMask;      /* IP subnet mask value */
-} st_RouterInfo;
+    uint64 ui64EthAdd;          /* ETH address value */
+    uint32 ui32IPAdd;           /* IP address value. 0.0.0.0 means free entry */
+    uint32 ui32SrcIPAdd;        /* local IP address used to send ARP requests */
+    uint32 ui32StateTime;       /* RTOS time in ms of last update from the network, request or failure */
+    uint32 ui32UseTime;         /* RTOS time in ms of last lookup or update: used for LRU replacement */
+    uint8 ui8NextHashIdx;       /* next entry in the same hash table bucket (index plus 1) */
+    uint8 ui8State;             /* resolution state: ARP_keEntryState value */
+    uint8 ui8Requests;          /* num of ARP requests sent in INCOMPLETE state */
+    uint8 ui8PendingNum;        /* num of packets waiting for the resolution */
+    uint8 aui8PendingPackets[ARP_UC_MAX_PENDING_PACKETS];   /* handles of waiting packets in arrival order */
+} st_ARPCacheEntry;
 
 
 
@@ -141,22 +180,25 @@ typedef struct
 /* store pointer of message ready to be decoded */
 LOCAL uint8 *pui8MessagePtr;
 
-/* Array of destination ETH addresses */
-LOCAL uint64 aui64EthAddArray[UC_MAX_NUM_OF_ETH_ADD] = {0};
+/* ARP cache entries */
+LOCAL st_ARPCacheEntry astARPCache[ARP_UC_CACHE_SIZE];
 
-/* Array of destination IP address to ETH address elements */
-LOCAL st_IPAddToEthAddIdx astIPAddToEthAddArray[UC_MAX_NUM_OF_IP_ADD] = {0, 0};
+/* ARP cache hash table. Each bucket stores the first entry of the list (index plus 1) */
+LOCAL uint8 aui8CacheHashTable[ARP_UC_CACHE_HASH_TABLE_SIZE];
+
+/* Callback to pass resolved or discarded pending packets to */
+LOCAL ARP_pfPendingCallback pfPendingCallback = NULL_PTR;
 
 /* Array of IP addresses of this device */
 LOCAL uint32 aui32LocalIPAddArray[UC_MAX_NUM_OF_LOCAL_IP_ADD] = {0};
 
-/* Structure to store router informations */
-LOCAL st_RouterInfo stRouterInfo =
-{
-    UL_NULL,
-    UL_NULL
-};
+/* Array of IP addresses of hot peers. 0.0.0.0 means free location */
+LOCAL uint32 aui32HotPeersArray[ARP_UC_MAX_NUM_OF_HOT_PEERS] = {0};
 
+/* IP address being announced, num of gratuitous ARP requests still to send and RTOS time in ms of the last one */
+LOCAL uint32 ui32AnnouncedIPAdd = UL_NULL;
+LOCAL uint8 ui8AnnouncementsLeft = UC_NULL;
+LOCAL uint32 ui32AnnouncementTime;
 
 
 
@@ -165,30 +207,30 @@ LOCAL st_RouterInfo stRouterInfo =
 LOCAL void      decodeARPPacket         (uint8 *);
 LOCAL void      prepareAndSendReply     (uint32, uint32, uint64);
 LOCAL void      prepareAndSendRequest   (uint32, uint32);
-LOCAL void      updateDstEthAddTable    (uint32, uint64);
+LOCAL void      updateDstEthAddTable    (uint32, uint64, boolean);
+LOCAL uint8     findCacheEntry          (uint32);
+LOCAL uint8     addCacheEntry           (uint32, uint32);
+LOCAL uint8     getFreeCacheEntry       (uint32);
+LOCAL void      removeCacheEntry        (uint8);
+LOCAL void      startResolution         (uint8, uint32, uint32);
+LOCAL void      flushPendingPackets     (uint8, uint64);
+LOCAL boolean   isHotPeer               (uint32);
+LOCAL void      manageHotPeers          (uint32);
 
 
 
 
 /* ---------------- Exported functions declaration ------------------- */
 
-/* update router info: IP address and subnet mask */
-EXPORTED void ARP_setRouterInfo( uint32 ui32RouterIPAdd, uint32 ui32SubnetMask )
-{
-    stRouterInfo.ui32RouterIPAdd = ui32RouterIPAdd;
-    stRouterInfo.ui32SubnetMask = ui32SubnetMask;
-}
-
-
 /* update local IP addresses table */
 EXPORTED void ARP_setLocalIPAddress( uint32 ui32IPAdd )
 {
-    uint8 ui8Index;
+    uint8 ui8Index = UC_NULL;
 
     /* search in local IP addresses array */
-    while((aui32LocalIPAddArray[ui8Index] != ui32IPAdd)
-    &&    (aui32LocalIPAddArray[ui8Index] != UL_NULL)
-    &&    (ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD))
+    while((ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD)
+    &&    (aui32LocalIPAddArray[ui8Index] != ui32IPAdd)
+    &&    (aui32LocalIPAddArray[ui8Index] != UL_NULL))
     {
         /* next IP address */
         ui8Index++;
@@ -215,14 +257,16 @@ EXPORTED boolean ARP_checkLocalIPAdd( uint32 ui32IPAdd )
     boolean bIPAddFound;
 
     /* search in local IP addresses array */
-    while((aui32LocalIPAddArray[ui8Index] != ui32IPAdd)
-    &&    (ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD))
+    while((ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD)
+    &&    (aui32LocalIPAddArray[ui8Index] != ui32IPAdd))
     {
         /* next IP address */
         ui8Index++;
     }
 
-    if(ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD)
+    /* 0.0.0.0 marks free locations: it is never a local IP address */
+    if((ui8Index < UC_MAX_NUM_OF_LOCAL_IP_ADD)
+    && (ui32IPAdd != UL_NULL))
     {
         /* IP address found */
         bIPAddFound = B_TRUE;
@@ -237,57 +281,97 @@ EXPORTED boolean ARP_checkLocalIPAdd( uint32 ui32IPAdd )
 }
 
 
-/* get ETH address from IP address */
-EXPORTED uint64 ARP_getEthAddFromIPAdd( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd )
+/* get ETH address from the IP address of the next hop. Routing decision is taken by the IPv4 layer.
+   If the ETH address is unknown an ARP request is sent and the entry is INCOMPLETE until the reply arrives.
+   The ETH address is written only if the returned state is ARP_STATE_REACHABLE */
+EXPORTED ARP_keEntryState ARP_resolveEthAdd( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint64 *pui64DstEthAdd )
 {
-    uint8 ui8Index = UC_NULL;
-    uint64 ui64DstEthAdd;
-
-    /* If destination IP address is not in the local network */
-    if((ui32DstIPAdd & stRouterInfo.ui32SubnetMask) != (stRouterInfo.ui32RouterIPAdd & stRouterInfo.ui32SubnetMask))
-    {
-        /* drop the packet to the router */
-        ui32DstIPAdd = stRouterInfo.ui32RouterIPAdd;
-    }
-    else
-    {
-        /* destination IP address is in the local network */
-    }
+    ARP_keEntryState enState;
+    uint8 ui8Index;
+    uint32 ui32Now;
 
     /* If destination address is a IP broadcast address */
     if(0xFFFFFFFF == ui32DstIPAdd)
     {
         /* set HW address to broadcast */
-        ui64DstEthAdd = 0x0000FFFFFFFFFFFF;
+        *pui64DstEthAdd = BROADCAST_MAC_ADDRESS;
+        enState = ARP_STATE_REACHABLE;
     }
     else 
     {
-        /* find IP address */
-        while((astIPAddToEthAddArray[ui8Index].ui32IPAdd != ui32DstIPAdd)
-        &&    (ui8Index < UC_MAX_NUM_OF_IP_ADD))
+        ui32Now = RTOS_tickCountGet();
+
+        /* find IP address in ARP cache */
+        ui8Index = findCacheEntry(ui32DstIPAdd);
+
+        if(ui8Index >= ARP_UC_CACHE_SIZE)
         {
-            /* next array element */
-            ui8Index++;
+            /* unknown destination: add it and send the first request */
+            ui8Index = addCacheEntry(ui32DstIPAdd, ui32Now);
+            startResolution(ui8Index, ui32SrcIPAdd, ui32Now);
+        }
+        else if((ARP_STATE_REACHABLE == astARPCache[ui8Index].ui8State)
+             && (IS_ENTRY_EXPIRED(&astARPCache[ui8Index], ui32Now)))
+        {
+            /* stale ETH address: ask again */
+            startResolution(ui8Index, ui32SrcIPAdd, ui32Now);
+        }
+        else
+        {
+            /* INCOMPLETE entries are requested again by periodic task only */
         }
 
-        /* if IP address is present and found index is valid */
-        if((ui8Index < UC_MAX_NUM_OF_IP_ADD)
-        && (astIPAddToEthAddArray[ui8Index].ui8EthAddIndex < UC_MAX_NUM_OF_ETH_ADD))
+        enState = (ARP_keEntryState)astARPCache[ui8Index].ui8State;
+
+        /* if ETH address is known */
+        if(ARP_STATE_REACHABLE == enState)
         {
             /* get found dst ETH address */
-            ui64DstEthAdd = aui64EthAddArray[(astIPAddToEthAddArray[ui8Index].ui8EthAddIndex)];
+            *pui64DstEthAdd = astARPCache[ui8Index].ui64EthAdd;
+            astARPCache[ui8Index].ui32UseTime = ui32Now;
         }
         else
         {
-            /* send a ARP request */
-            prepareAndSendRequest(ui32SrcIPAdd, ui32DstIPAdd);
-
             /* dst ETH address not available */
-            ui64DstEthAdd = ULL_NULL;
         }
     }
     
-    return ui64DstEthAdd;
+    return enState;
+}
+
+
+/* queue a packet handle on the INCOMPLETE entry of an IP address. The handle is passed to the pending packets
+   callback as soon as the entry is resolved or discarded. Return B_FALSE if the packet cannot wait */
+EXPORTED boolean ARP_queuePendingPacket( uint32 ui32DstIPAdd, uint8 ui8PacketHandle )
+{
+    boolean bQueued;
+    uint8 ui8Index;
+
+    ui8Index = findCacheEntry(ui32DstIPAdd);
+
+    /* if entry is waiting for the reply and its queue is not full */
+    if((ui8Index < ARP_UC_CACHE_SIZE)
+    && (ARP_STATE_INCOMPLETE == astARPCache[ui8Index].ui8State)
+    && (astARPCache[ui8Index].ui8PendingNum < ARP_UC_MAX_PENDING_PACKETS))
+    {
+        astARPCache[ui8Index].aui8PendingPackets[astARPCache[ui8Index].ui8PendingNum] = ui8PacketHandle;
+        astARPCache[ui8Index].ui8PendingNum++;
+
+        bQueued = B_TRUE;
+    }
+    else
+    {
+        bQueued = B_FALSE;
+    }
+
+    return bQueued;
+}
+
+
+/* set the callback to pass resolved or discarded pending packets to */
+EXPORTED void ARP_setPendingCallback( ARP_pfPendingCallback pfCallback )
+{
+    pfPendingCallback = pfCallback;
 }
 
 
@@ -298,15 +382,151 @@ EXPORTED void ARP_setEthAddToIPAdd( uint32 ui32IPAdd, uint64 ui64EthAdd )
     //...
 
     /* call function to update dst ETH and IP addresses tables */
-    updateDstEthAddTable(ui32IPAdd, ui64EthAdd);
+    updateDstEthAddTable(ui32IPAdd, ui64EthAdd, B_TRUE);
+}
+
+
+/* announce a local IP address with gratuitous ARP requests: peers update their stale entries for our ETH address.
+   The first request is sent immediately, the others by periodic task */
+EXPORTED void ARP_sendGratuitousARP( uint32 ui32IPAdd )
+{
+    if(ui32IPAdd != UL_NULL)
+    {
+        /* sender and target protocol addresses are both the announced one */
+        prepareAndSendRequest(ui32IPAdd, ui32IPAdd);
+
+        ui32AnnouncedIPAdd = ui32IPAdd;
+        ui8AnnouncementsLeft = (ARP_UC_GRATUITOUS_ARP_NUM - UC_1);
+        ui32AnnouncementTime = RTOS_tickCountGet();
+    }
+    else
+    {
+        /* no address to announce */
+    }
+}
+
+
+/* add a hot peer: its ETH address is resolved as soon as a local IP address is available and it is refreshed
+   before it expires. Return B_FALSE if hot peers table is full */
+EXPORTED boolean ARP_addHotPeer( uint32 ui32IPAdd )
+{
+    uint8 ui8Index = UC_NULL;
+    boolean bAdded;
+
+    /* search the IP address or a free location */
+    while((ui8Index < ARP_UC_MAX_NUM_OF_HOT_PEERS)
+    &&    (aui32HotPeersArray[ui8Index] != ui32IPAdd)
+    &&    (aui32HotPeersArray[ui8Index] != UL_NULL))
+    {
+        ui8Index++;
+    }
+
+    /* 0.0.0.0 and broadcast addresses are not resolved */
+    if((ui8Index < ARP_UC_MAX_NUM_OF_HOT_PEERS)
+    && (ui32IPAdd != UL_NULL)
+    && (ui32IPAdd != 0xFFFFFFFF))
+    {
+        aui32HotPeersArray[ui8Index] = ui32IPAdd;
+        bAdded = B_TRUE;
+    }
+    else
+    {
+        bAdded = B_FALSE;
+    }
+
+    return bAdded;
 }
 
 
-/* Periodic task */
+/* remove a hot peer. Its ARP cache entry is kept and ages as the others */
+EXPORTED void ARP_removeHotPeer( uint32 ui32IPAdd )
+{
+    uint8 ui8Index;
+
+    for(ui8Index = UC_NULL; ui8Index < ARP_UC_MAX_NUM_OF_HOT_PEERS; ui8Index++)
+    {
+        if((ui32IPAdd != UL_NULL)
+        && (aui32HotPeersArray[ui8Index] == ui32IPAdd))
+        {
+            aui32HotPeersArray[ui8Index] = UL_NULL;
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+}
+
+
+/* Periodic task: send again unanswered ARP requests with exponential back-off and remove stale entries */
 EXPORTED void ARP_PeriodicTask( void )
 {
-    /* implement IP addresses table counters management */
-    //...
+    uint8 ui8Index;
+    uint32 ui32Now;
+    st_ARPCacheEntry *pstEntry;
+
+    ui32Now = RTOS_tickCountGet();
+
+    for(ui8Index = UC_NULL; ui8Index < ARP_UC_CACHE_SIZE; ui8Index++)
+    {
+        pstEntry = &astARPCache[ui8Index];
+
+        if(UL_NULL == pstEntry->ui32IPAdd)
+        {
+            /* free entry */
+        }
+        else if(ARP_STATE_INCOMPLETE == pstEntry->ui8State)
+        {
+            /* if last request has not been answered in time */
+            if(IS_RETRY_EXPIRED(pstEntry, ui32Now))
+            {
+                if(pstEntry->ui8Requests < ARP_UC_MAX_REQUESTS)
+                {
+                    /* request again and double the waiting time */
+                    prepareAndSendRequest(pstEntry->ui32SrcIPAdd, pstEntry->ui32IPAdd);
+                    pstEntry->ui8Requests++;
+                    pstEntry->ui32StateTime = ui32Now;
+                }
+                else
+                {
+                    /* destination is unreachable: discard waiting packets */
+                    pstEntry->ui8State = ARP_STATE_FAILED;
+                    pstEntry->ui32StateTime = ui32Now;
+                    flushPendingPackets(ui8Index, NULL_MAC_ADDRESS);
+                }
+            }
+            else
+            {
+                /* keep waiting */
+            }
+        }
+        else if(((ARP_STATE_REACHABLE == pstEntry->ui8State) && (IS_ENTRY_EXPIRED(pstEntry, ui32Now)))
+             || ((ARP_STATE_FAILED == pstEntry->ui8State) && (GET_STATE_TIME(pstEntry, ui32Now) >= ARP_UL_FAILED_HOLD_PERIOD_MS)))
+        {
+            /* stale entry */
+            removeCacheEntry(ui8Index);
+        }
+        else
+        {
+            /* still valid */
+        }
+    }
+
+    /* send remaining gratuitous ARP requests */
+    if((ui8AnnouncementsLeft > UC_NULL)
+    && ((uint32)(ui32Now - ui32AnnouncementTime) >= ARP_UL_GRATUITOUS_ARP_PERIOD_MS))
+    {
+        prepareAndSendRequest(ui32AnnouncedIPAdd, ui32AnnouncedIPAdd);
+        ui8AnnouncementsLeft--;
+        ui32AnnouncementTime = ui32Now;
+    }
+    else
+    {
+        /* nothing to announce now */
+    }
+
+    /* resolve and refresh hot peers */
+    manageHotPeers(ui32Now);
 }
 
 
@@ -332,6 +552,7 @@ LOCAL void decodeARPPacket( uint8 *pui8BufferPtr )
     uint64 ui64SenderEthAdd;
     uint32 ui32TargetProtAdd;
     uint32 ui32SenderProtAdd;
+    boolean bTargetIsLocal;
     
     /* set the 32-bit pointer */
     pui32BufPtr = (uint32 *)pui8BufferPtr;
@@ -372,18 +593,21 @@ LOCAL void decodeARPPacket( uint8 *pui8BufferPtr )
     ui32TargetProtAdd = (GET_HIGH_16BIT(*pui32BufPtr) << UL_SHIFT_16) & 0xFFFF0000;
     ui32TargetProtAdd |= (GET_LOW_16BIT(*pui32BufPtr) & 0x0000FFFF);
 
+    /* search target IP add in our local IP add */
+    bTargetIsLocal = ARP_checkLocalIPAdd(ui32TargetProtAdd);
+
+    /* update destination ETH addresses table as RFC 826: the sender entry is refreshed if it is already cached
+       and it is added only if this host is the target */
+    updateDstEthAddTable(ui32SenderProtAdd, ui64SenderEthAdd, bTargetIsLocal);
+
     /* manage operation request */
     switch(ui16Operation)
     {
         /* request */
         case ARP_OP_REQUEST:
         {
-            /* update destination ETH addresses table */
-            /* not needed - called early from IPv4 layer at every received packet */
-            updateDstEthAddTable(ui32SenderProtAdd, ui64SenderEthAdd);
-
-            /* search target IP add in our local IP add */
-            if(B_TRUE == ARP_checkLocalIPAdd(ui32TargetProtAdd))
+            /* if this host is the target */
+            if(B_TRUE == bTargetIsLocal)
             {
                 /* found it - prepare frame and send it */
                 /* - set this Protocol address as sender */
@@ -401,8 +625,7 @@ LOCAL void decodeARPPacket( uint8 *pui8BufferPtr )
         /* reply */
         case ARP_OP_REPLY:
         {
-            /* update destination ETH addresses table */
-            updateDstEthAddTable(ui32SenderProtAdd, ui64SenderEthAdd);
+            /* sender entry has been already updated */
 
             break;
         }
@@ -422,48 +645,56 @@ LOCAL void prepareAndSendReply(uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint64
 
     /* ATTENTION: set datagram pointer (use the first one at the moment) */
     pui8BufPtr = (uint8 *)ETHMAC_getTXBufferPointer((uint16)ARP_MESSAGE_BYTE_LENGTH);
-    /* perform a 32-bit word alignment */
-    ALIGN_32BIT_OF_8BIT_PTR(pui8BufPtr);
-
-    /* update shared buffer pointer */
-    pui32HdrWords = (uint32 *)pui8BufPtr;
-
-    /* clear the buffer */
-    memset(pui32HdrWords, UC_NULL, ARP_MESSAGE_BYTE_LENGTH);
-
-    /* prepare fields */
-    SET_HW_TYPE(*pui32HdrWords, ARP_HW_TYPE);
-    SET_PROT_TYPE(*pui32HdrWords, ARP_PROT_TYPE);
-    pui32HdrWords++;
-    SET_HW_ADD_LENGTH(*pui32HdrWords, HW_ADD_BYTE_LENGTH);
-    SET_PROT_ADD_LENGTH(*pui32HdrWords, PROT_ADD_BYTE_LENGTH);
-    SET_OPERATION(*pui32HdrWords, ARP_OP_REPLY);
-    pui32HdrWords++;
-
-    /* sender MAC address */
-    SET_HIGH_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x0000FFFF00000000) >> ULL_SHIFT_32));
-    SET_LOW_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x00000000FFFF0000) >> ULL_SHIFT_16));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, (ETHMAC_ui64MACAddress & 0x000000000000FFFF));
-
-    /* sender protocol address */
-    SET_LOW_16BIT(*pui32HdrWords, ((ui32SrcIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, (ui32SrcIPAdd & 0x0000FFFF));
-
-    /* target MAC address */
-    SET_LOW_16BIT(*pui32HdrWords, ((ui64DstEthAdd & 0x0000FFFF00000000) >> ULL_SHIFT_32));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, ((ui64DstEthAdd & 0x00000000FFFF0000) >> ULL_SHIFT_16));
-    SET_LOW_16BIT(*pui32HdrWords, (ui64DstEthAdd & 0x000000000000FFFF));
-
-    pui32HdrWords++;
-    /* target protocol address */
-    SET_HIGH_16BIT(*pui32HdrWords, ((ui32DstIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
-    SET_LOW_16BIT(*pui32HdrWords, (ui32DstIPAdd & 0x0000FFFF));
-
-    /* request ETH packet transmission */
-    ETHMAC_sendPacket(pui8BufPtr, ARP_MESSAGE_BYTE_LENGTH, ETHMAC_ui64MACAddress, ui64DstEthAdd, US_ETH_TYPE_ARP);
+    /* the message is not sent if the TX ring is full */
+    if(pui8BufPtr != NULL_PTR)
+    {
+        /* perform a 32-bit word alignment */
+        ALIGN_32BIT_OF_8BIT_PTR(pui8BufPtr);
+
+        /* update shared buffer pointer */
+        pui32HdrWords = (uint32 *)pui8BufPtr;
+
+        /* clear the buffer */
+        memset(pui32HdrWords, UC_NULL, ARP_MESSAGE_BYTE_LENGTH);
+
+        /* prepare fields */
+        SET_HW_TYPE(*pui32HdrWords, ARP_HW_TYPE);
+        SET_PROT_TYPE(*pui32HdrWords, ARP_PROT_TYPE);
+        pui32HdrWords++;
+        SET_HW_ADD_LENGTH(*pui32HdrWords, HW_ADD_BYTE_LENGTH);
+        SET_PROT_ADD_LENGTH(*pui32HdrWords, PROT_ADD_BYTE_LENGTH);
+        SET_OPERATION(*pui32HdrWords, ARP_OP_REPLY);
+        pui32HdrWords++;
+
+        /* sender MAC address */
+        SET_HIGH_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x0000FFFF00000000) >> ULL_SHIFT_32));
+        SET_LOW_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x00000000FFFF0000) >> ULL_SHIFT_16));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, (ETHMAC_ui64MACAddress & 0x000000000000FFFF));
+
+        /* sender protocol address */
+        SET_LOW_16BIT(*pui32HdrWords, ((ui32SrcIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, (ui32SrcIPAdd & 0x0000FFFF));
+
+        /* target MAC address */
+        SET_LOW_16BIT(*pui32HdrWords, ((ui64DstEthAdd & 0x0000FFFF00000000) >> ULL_SHIFT_32));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, ((ui64DstEthAdd & 0x00000000FFFF0000) >> ULL_SHIFT_16));
+        SET_LOW_16BIT(*pui32HdrWords, (ui64DstEthAdd & 0x000000000000FFFF));
+
+        pui32HdrWords++;
+        /* target protocol address */
+        SET_HIGH_16BIT(*pui32HdrWords, ((ui32DstIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
+        SET_LOW_16BIT(*pui32HdrWords, (ui32DstIPAdd & 0x0000FFFF));
+
+        /* request ETH packet transmission */
+        (void)ETHMAC_sendPacket(pui8BufPtr, ARP_MESSAGE_BYTE_LENGTH, ETHMAC_ui64MACAddress, ui64DstEthAdd, US_ETH_TYPE_ARP);
+    }
+    else
+    {
+        /* TX ring is full: the reply is lost. The requester asks again */
+    }
 }
 
 
@@ -475,95 +706,335 @@ LOCAL void prepareAndSendRequest( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd )
 
     /* ATTENTION: set datagram pointer (use the first one at the moment) */
     pui8BufPtr = (uint8 *)ETHMAC_getTXBufferPointer((uint16)ARP_MESSAGE_BYTE_LENGTH);
-    /* perform a 32-bit word alignment */
-    ALIGN_32BIT_OF_8BIT_PTR(pui8BufPtr);
-
-    /* update shared buffer pointer */
-    pui32HdrWords = (uint32 *)pui8BufPtr;
-
-    /* clear the buffer */
-    memset(pui32HdrWords, UC_NULL, ARP_MESSAGE_BYTE_LENGTH);
-
-    /* prepare fields */
-    SET_HW_TYPE(*pui32HdrWords, ARP_HW_TYPE);
-    SET_PROT_TYPE(*pui32HdrWords, ARP_PROT_TYPE);
-    pui32HdrWords++;
-    SET_HW_ADD_LENGTH(*pui32HdrWords, HW_ADD_BYTE_LENGTH);
-    SET_PROT_ADD_LENGTH(*pui32HdrWords, PROT_ADD_BYTE_LENGTH);
-    SET_OPERATION(*pui32HdrWords, ARP_OP_REQUEST);
-    pui32HdrWords++;
-
-    /* sender MAC address */
-    SET_HIGH_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x0000FFFF00000000) >> ULL_SHIFT_32));
-    SET_LOW_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x00000000FFFF0000) >> ULL_SHIFT_16));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, (ETHMAC_ui64MACAddress & 0x000000000000FFFF));
-
-    /* sender protocol address */
-    SET_LOW_16BIT(*pui32HdrWords, ((ui32SrcIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, (ui32SrcIPAdd & 0x0000FFFF));
-
-    /* target MAC address */
-    SET_LOW_16BIT(*pui32HdrWords, ((NULL_MAC_ADDRESS & 0x0000FFFF00000000) >> ULL_SHIFT_32));
-    pui32HdrWords++;
-    SET_HIGH_16BIT(*pui32HdrWords, ((NULL_MAC_ADDRESS & 0x00000000FFFF0000) >> ULL_SHIFT_16));
-    SET_LOW_16BIT(*pui32HdrWords, (NULL_MAC_ADDRESS & 0x000000000000FFFF));
-
-    pui32HdrWords++;
-    /* target protocol address */
-    SET_HIGH_16BIT(*pui32HdrWords, ((ui32DstIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
-    SET_LOW_16BIT(*pui32HdrWords, (ui32DstIPAdd & 0x0000FFFF));
-
-    /* request ETH packet transmission */
-    ETHMAC_sendPacket(pui8BufPtr, ARP_MESSAGE_BYTE_LENGTH, ETHMAC_ui64MACAddress, BROADCAST_MAC_ADDRESS, US_ETH_TYPE_ARP);
+    /* the message is not sent if the TX ring is full */
+    if(pui8BufPtr != NULL_PTR)
+    {
+        /* perform a 32-bit word alignment */
+        ALIGN_32BIT_OF_8BIT_PTR(pui8BufPtr);
+
+        /* update shared buffer pointer */
+        pui32HdrWords = (uint32 *)pui8BufPtr;
+
+        /* clear the buffer */
+        memset(pui32HdrWords, UC_NULL, ARP_MESSAGE_BYTE_LENGTH);
+
+        /* prepare fields */
+        SET_HW_TYPE(*pui32HdrWords, ARP_HW_TYPE);
+        SET_PROT_TYPE(*pui32HdrWords, ARP_PROT_TYPE);
+        pui32HdrWords++;
+        SET_HW_ADD_LENGTH(*pui32HdrWords, HW_ADD_BYTE_LENGTH);
+        SET_PROT_ADD_LENGTH(*pui32HdrWords, PROT_ADD_BYTE_LENGTH);
+        SET_OPERATION(*pui32HdrWords, ARP_OP_REQUEST);
+        pui32HdrWords++;
+
+        /* sender MAC address */
+        SET_HIGH_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x0000FFFF00000000) >> ULL_SHIFT_32));
+        SET_LOW_16BIT(*pui32HdrWords, ((ETHMAC_ui64MACAddress & 0x00000000FFFF0000) >> ULL_SHIFT_16));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, (ETHMAC_ui64MACAddress & 0x000000000000FFFF));
+
+        /* sender protocol address */
+        SET_LOW_16BIT(*pui32HdrWords, ((ui32SrcIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, (ui32SrcIPAdd & 0x0000FFFF));
+
+        /* target MAC address */
+        SET_LOW_16BIT(*pui32HdrWords, ((NULL_MAC_ADDRESS & 0x0000FFFF00000000) >> ULL_SHIFT_32));
+        pui32HdrWords++;
+        SET_HIGH_16BIT(*pui32HdrWords, ((NULL_MAC_ADDRESS & 0x00000000FFFF0000) >> ULL_SHIFT_16));
+        SET_LOW_16BIT(*pui32HdrWords, (NULL_MAC_ADDRESS & 0x000000000000FFFF));
+
+        pui32HdrWords++;
+        /* target protocol address */
+        SET_HIGH_16BIT(*pui32HdrWords, ((ui32DstIPAdd & 0xFFFF0000) >> UL_SHIFT_16));
+        SET_LOW_16BIT(*pui32HdrWords, (ui32DstIPAdd & 0x0000FFFF));
+
+        /* request ETH packet transmission */
+        (void)ETHMAC_sendPacket(pui8BufPtr, ARP_MESSAGE_BYTE_LENGTH, ETHMAC_ui64MACAddress, BROADCAST_MAC_ADDRESS, US_ETH_TYPE_ARP);
+    }
+    else
+    {
+        /* TX ring is full: the message is lost. ARP retries it */
+    }
 }
 
 
-/* update destination ETH addresses table */
-LOCAL void updateDstEthAddTable(uint32 ui32IPAdd, uint64 ui64EthAdd)
+/* update ARP cache entry of an IP address. The entry is added if missing and adding is requested.
+   Waiting packets are passed on */
+LOCAL void updateDstEthAddTable(uint32 ui32IPAdd, uint64 ui64EthAdd, boolean bAddIfMissing)
 {
-    uint8 ui8EthIndex = UC_NULL;
-    uint8 ui8IPIndex = UC_NULL;
+    uint8 ui8Index;
+    uint32 ui32Now;
+
+    /* 0.0.0.0 marks free entries and a null ETH address is not valid */
+    if((ui32IPAdd != UL_NULL)
+    && (ui64EthAdd != NULL_MAC_ADDRESS))
+    {
+        ui32Now = RTOS_tickCountGet();
+
+        /* find if IP address is already present */
+        ui8Index = findCacheEntry(ui32IPAdd);
 
-    /* find if ETH address is already present */
-    while((aui64EthAddArray[ui8EthIndex] != ui64EthAdd)
-    &&    (aui64EthAddArray[ui8EthIndex] != UL_NULL)
-    &&    (ui8EthIndex < UC_MAX_NUM_OF_ETH_ADD))
+        if(ui8Index < ARP_UC_CACHE_SIZE)
+        {
+            /* already present: refresh it */
+        }
+        else if(B_TRUE == bAddIfMissing)
+        {
+            /* add it */
+            ui8Index = addCacheEntry(ui32IPAdd, ui32Now);
+        }
+        else
+        {
+            /* not cached and not to be added */
+        }
+
+        if(ui8Index < ARP_UC_CACHE_SIZE)
+        {
+            astARPCache[ui8Index].ui64EthAdd = ui64EthAdd;
+            astARPCache[ui8Index].ui8State = ARP_STATE_REACHABLE;
+            astARPCache[ui8Index].ui8Requests = UC_NULL;
+            astARPCache[ui8Index].ui32StateTime = ui32Now;
+            astARPCache[ui8Index].ui32UseTime = ui32Now;
+
+            /* send packets waiting for this address */
+            flushPendingPackets(ui8Index, ui64EthAdd);
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+    else
     {
-        /* next array element */
-        ui8EthIndex++;
+        /* invalid addresses: discard them */
     }
+}
+
+
+/* get the ARP cache entry index of an IP address. Return ARP_UC_CACHE_SIZE if not found */
+LOCAL uint8 findCacheEntry(uint32 ui32IPAdd)
+{
+    uint8 ui8ListItem;
 
-    /* if array is not full */
-    if(ui8EthIndex < UC_MAX_NUM_OF_ETH_ADD)
+    /* walk the bucket list */
+    ui8ListItem = aui8CacheHashTable[GET_CACHE_HASH(ui32IPAdd)];
+    while((ui8ListItem != UC_HASH_END_OF_LIST)
+    &&    (astARPCache[(ui8ListItem - UC_1)].ui32IPAdd != ui32IPAdd))
     {
-        /* if ETH address is missing then add it */
-        /* if ETH address is already present then overwrite its value anyway */
-        aui64EthAddArray[ui8EthIndex] = ui64EthAdd;
+        ui8ListItem = astARPCache[(ui8ListItem - UC_1)].ui8NextHashIdx;
+    }
 
-        /* find if IP address is already present */
-        while((astIPAddToEthAddArray[ui8IPIndex].ui32IPAdd != ui32IPAdd)
-        &&    (astIPAddToEthAddArray[ui8IPIndex].ui32IPAdd != UL_NULL)
-        &&    (ui8IPIndex < UC_MAX_NUM_OF_IP_ADD))
+    return ((ui8ListItem != UC_HASH_END_OF_LIST) ? (ui8ListItem - UC_1) : ARP_UC_CACHE_SIZE);
+}
+
+
+/* add an IP address to the ARP cache and to its hash table bucket. Return the entry index */
+LOCAL uint8 addCacheEntry(uint32 ui32IPAdd, uint32 ui32Now)
+{
+    uint8 ui8Index;
+
+    /* get a free entry or the least recently used one */
+    ui8Index = getFreeCacheEntry(ui32Now);
+
+    astARPCache[ui8Index].ui32IPAdd = ui32IPAdd;
+    astARPCache[ui8Index].ui8State = ARP_STATE_INCOMPLETE;
+    astARPCache[ui8Index].ui8Requests = UC_NULL;
+    astARPCache[ui8Index].ui8PendingNum = UC_NULL;
+    astARPCache[ui8Index].ui32StateTime = ui32Now;
+    astARPCache[ui8Index].ui32UseTime = ui32Now;
+
+    /* insert it in its hash table bucket */
+    astARPCache[ui8Index].ui8NextHashIdx = aui8CacheHashTable[GET_CACHE_HASH(ui32IPAdd)];
+    aui8CacheHashTable[GET_CACHE_HASH(ui32IPAdd)] = (ui8Index + UC_1);
+
+    return ui8Index;
+}
+
+
+/* get a free ARP cache entry. If the cache is full then the least recently used entry is removed */
+LOCAL uint8 getFreeCacheEntry(uint32 ui32Now)
+{
+    uint8 ui8Index = UC_NULL;
+    uint8 ui8LRUIndex = UC_NULL;
+    uint32 ui32MaxUnusedTime = UL_NULL;
+
+    while((ui8Index < ARP_UC_CACHE_SIZE)
+    &&    (astARPCache[ui8Index].ui32IPAdd != UL_NULL))
+    {
+        /* keep track of the least recently used entry. Hot peers are never replaced */
+        if(((uint32)(ui32Now - astARPCache[ui8Index].ui32UseTime) >= ui32MaxUnusedTime)
+        && (B_FALSE == isHotPeer(astARPCache[ui8Index].ui32IPAdd)))
         {
-            /* next array element */
-            ui8IPIndex++;
+            ui32MaxUnusedTime = (uint32)(ui32Now - astARPCache[ui8Index].ui32UseTime);
+            ui8LRUIndex = ui8Index;
+        }
+        else
+        {
+            /* do nothing */
         }
 
-        /* if array is not full */
-        if(ui8IPIndex < UC_MAX_NUM_OF_IP_ADD)
+        ui8Index++;
+    }
+
+    /* if cache is full */
+    if(ui8Index >= ARP_UC_CACHE_SIZE)
+    {
+        /* replace the least recently used entry */
+        removeCacheEntry(ui8LRUIndex);
+        ui8Index = ui8LRUIndex;
+    }
+    else
+    {
+        /* free entry found */
+    }
+
+    return ui8Index;
+}
+
+
+/* remove an entry from the ARP cache and from its hash table bucket. Its waiting packets are discarded */
+LOCAL void removeCacheEntry(uint8 ui8Index)
+{
+    uint8 *pui8Link;
+
+    /* discard waiting packets */
+    flushPendingPackets(ui8Index, NULL_MAC_ADDRESS);
+
+    /* search the link pointing to the entry */
+    pui8Link = &aui8CacheHashTable[GET_CACHE_HASH(astARPCache[ui8Index].ui32IPAdd)];
+    while((*pui8Link != UC_HASH_END_OF_LIST)
+    &&    (*pui8Link != (ui8Index + UC_1)))
+    {
+        pui8Link = &astARPCache[(*pui8Link - UC_1)].ui8NextHashIdx;
+    }
+
+    /* unlink it */
+    if(*pui8Link != UC_HASH_END_OF_LIST)
+    {
+        *pui8Link = astARPCache[ui8Index].ui8NextHashIdx;
+    }
+    else
+    {
+        /* not found: nothing to unlink */
+    }
+
+    /* free entry */
+    astARPCache[ui8Index].ui32IPAdd = UL_NULL;
+    astARPCache[ui8Index].ui8NextHashIdx = UC_HASH_END_OF_LIST;
+}
+
+
+/* set an entry as INCOMPLETE and send the first ARP request */
+LOCAL void startResolution(uint8 ui8Index, uint32 ui32SrcIPAdd, uint32 ui32Now)
+{
+    astARPCache[ui8Index].ui8State = ARP_STATE_INCOMPLETE;
+    astARPCache[ui8Index].ui32SrcIPAdd = ui32SrcIPAdd;
+    astARPCache[ui8Index].ui32StateTime = ui32Now;
+    astARPCache[ui8Index].ui8Requests = UC_1;
+
+    prepareAndSendRequest(ui32SrcIPAdd, astARPCache[ui8Index].ui32IPAdd);
+}
+
+
+/* pass packets waiting for an entry to the pending packets callback in arrival order.
+   A null ETH address means the packets shall be discarded */
+LOCAL void flushPendingPackets(uint8 ui8Index, uint64 ui64EthAdd)
+{
+    uint8 aui8Packets[ARP_UC_MAX_PENDING_PACKETS];
+    uint8 ui8PacketsNum;
+    uint8 ui8PacketIdx;
+
+    /* empty the queue before the calls */
+    ui8PacketsNum = astARPCache[ui8Index].ui8PendingNum;
+    for(ui8PacketIdx = UC_NULL; ui8PacketIdx < ui8PacketsNum; ui8PacketIdx++)
+    {
+        aui8Packets[ui8PacketIdx] = astARPCache[ui8Index].aui8PendingPackets[ui8PacketIdx];
+    }
+    astARPCache[ui8Index].ui8PendingNum = UC_NULL;
+
+    if(pfPendingCallback != NULL_PTR)
+    {
+        for(ui8PacketIdx = UC_NULL; ui8PacketIdx < ui8PacketsNum; ui8PacketIdx++)
         {
-            /* add the IP address value in case of it is not present (ui32IPAdd == UL_NULL) */
-            /* if the IP address is already present then this operation overwrites the IP address value */
-            astIPAddToEthAddArray[ui8IPIndex].ui32IPAdd = ui32IPAdd;
-            /* and update Eth address index */
-            astIPAddToEthAddArray[ui8IPIndex].ui8EthAddIndex = ui8EthIndex;
+            pfPendingCallback(aui8Packets[ui8PacketIdx], ui64EthAdd);
+        }
+    }
+    else
+    {
+        /* nobody to pass packets to */
+    }
+}
+
+
+/* check if an IP address is a hot peer */
+LOCAL boolean isHotPeer(uint32 ui32IPAdd)
+{
+    uint8 ui8Index = UC_NULL;
+
+    while((ui8Index < ARP_UC_MAX_NUM_OF_HOT_PEERS)
+    &&    (aui32HotPeersArray[ui8Index] != ui32IPAdd))
+    {
+        ui8Index++;
+    }
+
+    return ((ui8Index < ARP_UC_MAX_NUM_OF_HOT_PEERS) ? B_TRUE : B_FALSE);
+}
+
+
+/* resolve hot peers missing from the ARP cache and refresh the reachable ones before they expire.
+   Unanswered refresh requests are sent again every retry base period. Requests use the first local IP address */
+LOCAL void manageHotPeers(uint32 ui32Now)
+{
+    uint8 ui8PeerIdx;
+    uint8 ui8Index;
+    uint32 ui32SrcIPAdd;
+    st_ARPCacheEntry *pstEntry;
+
+    ui32SrcIPAdd = aui32LocalIPAddArray[UC_NULL];
+
+    /* if a local IP address is available */
+    if(ui32SrcIPAdd != UL_NULL)
+    {
+        for(ui8PeerIdx = UC_NULL; ui8PeerIdx < ARP_UC_MAX_NUM_OF_HOT_PEERS; ui8PeerIdx++)
+        {
+            if(aui32HotPeersArray[ui8PeerIdx] != UL_NULL)
+            {
+                ui8Index = findCacheEntry(aui32HotPeersArray[ui8PeerIdx]);
+
+                if(ui8Index >= ARP_UC_CACHE_SIZE)
+                {
+                    /* resolve it in advance */
+                    ui8Index = addCacheEntry(aui32HotPeersArray[ui8PeerIdx], ui32Now);
+                    startResolution(ui8Index, ui32SrcIPAdd, ui32Now);
+                }
+                else
+                {
+                    pstEntry = &astARPCache[ui8Index];
+
+                    /* entry stays REACHABLE while refresh requests are sent */
+                    if((ARP_STATE_REACHABLE == pstEntry->ui8State)
+                    && (pstEntry->ui8Requests < ARP_UC_MAX_REQUESTS)
+                    && (GET_STATE_TIME(pstEntry, ui32Now) >= (UL_HOT_PEER_REFRESH_MS + (pstEntry->ui8Requests * ARP_UL_RETRY_BASE_PERIOD_MS))))
+                    {
+                        prepareAndSendRequest(ui32SrcIPAdd, pstEntry->ui32IPAdd);
+                        pstEntry->ui8Requests++;
+                    }
+                    else
+                    {
+                        /* INCOMPLETE and FAILED entries are managed as the others */
+                    }
+                }
+            }
+            else
+            {
+                /* free location */
+            }
         }
     }
     else
     {
-        /* array is full - discard both addresses at the moment */
+        /* hot peers cannot be requested yet */
     }
 }
 
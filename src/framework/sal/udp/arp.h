@@ -38,13 +38,77 @@
 
 
 
+/* --------------- Exported defines ----------------- */
+
+/* Num of entries of the ARP cache. When it is full the least recently used entry is replaced.
+   ATTENTION: it shall not be greater than 254 */
+#define ARP_UC_CACHE_SIZE                   (16)
+
+/* Num of buckets of the ARP cache hash table. ATTENTION: it must be a power of 2 */
+#define ARP_UC_CACHE_HASH_TABLE_SIZE        (16)
+
+/* Time in seconds an ARP cache entry stays valid after its last update from the network */
+#define ARP_UL_CACHE_ENTRY_TIMEOUT_S        (300)
+
+/* Max num of packets waiting for the resolution of each ARP cache entry */
+#define ARP_UC_MAX_PENDING_PACKETS          (3)
+
+/* Time in ms before the first ARP request is sent again. It doubles at each further request */
+#define ARP_UL_RETRY_BASE_PERIOD_MS         (250)
+
+/* Max num of ARP requests sent for a destination before considering it unreachable */
+#define ARP_UC_MAX_REQUESTS                 (4)
+
+/* Time in ms an unreachable destination is not requested again. Packets to it are discarded meanwhile */
+#define ARP_UL_FAILED_HOLD_PERIOD_MS        (10000)
+
+/* Num of gratuitous ARP requests sent when a local IP address is set and time in ms between them */
+#define ARP_UC_GRATUITOUS_ARP_NUM           (2)
+#define ARP_UL_GRATUITOUS_ARP_PERIOD_MS     (2000)
+
+/* Max num of hot peers: they are resolved in advance and refreshed before their ARP cache entry expires.
+   ATTENTION: it shall be lower than ARP_UC_CACHE_SIZE */
+#define ARP_UC_MAX_NUM_OF_HOT_PEERS         (4)
+
+/* Time in seconds before the expiry of a hot peer entry when its refresh requests start */
+#define ARP_UL_HOT_PEER_REFRESH_MARGIN_S    (30)
+
+
+
+
+/* --------------- Exported enums definitions ---------------- */
+
+/* ARP cache entries resolution states */
+typedef enum
+{
+    ARP_STATE_INCOMPLETE        /* ARP request sent, waiting for the reply */
+   ,ARP_STATE_REACHABLE         /* ETH address is known */
+   ,ARP_STATE_FAILED            /* no reply to the ARP requests */
+} ARP_keEntryState;
+
+
+
+
+/* --------------- Exported types definitions ---------------- */
+
+/* pending packets callback type: packet handle and ETH address of its destination.
+   ETH address is 0 if the destination is unreachable or the packet has been discarded */
+typedef void (* ARP_pfPendingCallback)(uint8, uint64);
+
+
+
+
 /* ------------- Exported functions prototypes --------------- */
 
-EXTERN void     ARP_setRouterInfo       (uint32, uint32);
 EXTERN void     ARP_setLocalIPAddress   (uint32);
 EXTERN boolean  ARP_checkLocalIPAdd     (uint32);
-EXTERN uint64   ARP_getEthAddFromIPAdd  (uint32, uint32);
+EXTERN ARP_keEntryState ARP_resolveEthAdd(uint32, uint32, uint64 *);
+EXTERN boolean  ARP_queuePendingPacket  (uint32, uint8);
+EXTERN void     ARP_setPendingCallback  (ARP_pfPendingCallback);
 EXTERN void     ARP_setEthAddToIPAdd    (uint32, uint64);
+EXTERN void     ARP_sendGratuitousARP   (uint32);
+EXTERN boolean  ARP_addHotPeer          (uint32);
+EXTERN void     ARP_removeHotPeer       (uint32);
 EXTERN void     ARP_PeriodicTask        (void);
 EXTERN void     ARP_decodeARPPacket     (uint8 *);
 
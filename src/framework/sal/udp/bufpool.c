@@ -0,0 +1,314 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file bufpool.c represents the data buffers pool of the UDP/IP stack.
+ * Buffers are statically allocated in a few size classes, 32-bit aligned,
+ * and reference counted so they can be shared between layers.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "../../fw_common.h"
+#include "bufpool.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* value check */
+#if ((BUFPOOL_US_SMALL_BUF_LENGTH % 4) != 0) || ((BUFPOOL_US_MEDIUM_BUF_LENGTH % 4) != 0) || ((BUFPOOL_US_LARGE_BUF_LENGTH % 4) != 0)
+#error BUFPOOL buffers lengths must be multiple of 4
+#endif
+
+/* value check */
+#if (BUFPOOL_US_SMALL_BUF_LENGTH >= BUFPOOL_US_MEDIUM_BUF_LENGTH) || (BUFPOOL_US_MEDIUM_BUF_LENGTH >= BUFPOOL_US_LARGE_BUF_LENGTH)
+#error BUFPOOL buffers lengths must be in increasing order
+#endif
+
+
+
+
+/* --------------- Local types definitions ----------------- */
+
+/* size classes enum */
+typedef enum
+{
+    KE_FIRST_CLASS
+   ,KE_SMALL_CLASS = KE_FIRST_CLASS
+   ,KE_MEDIUM_CLASS
+   ,KE_LARGE_CLASS
+   ,KE_LAST_CLASS = KE_LARGE_CLASS
+   ,KE_CLASS_MAX_NUM
+} ke_SizeClasses;
+
+/* size class info structure */
+typedef struct
+{
+    uint8 *pui8Storage;         /* first buffer of the class */
+    uint8 *pui8RefCount;        /* reference counter of each buffer. 0 means free */
+    uint16 ui16BufLength;
+    uint8 ui8NumOfBufs;
+} st_SizeClassInfo;
+
+
+
+
+/* --------------- Local variables declaration ----------------- */
+
+/* buffers storage: 32-bit words to get 32-bit aligned buffers */
+LOCAL uint32 aui32SmallBufs[BUFPOOL_UC_SMALL_BUF_NUM][(BUFPOOL_US_SMALL_BUF_LENGTH / 4)];
+LOCAL uint32 aui32MediumBufs[BUFPOOL_UC_MEDIUM_BUF_NUM][(BUFPOOL_US_MEDIUM_BUF_LENGTH / 4)];
+LOCAL uint32 aui32LargeBufs[BUFPOOL_UC_LARGE_BUF_NUM][(BUFPOOL_US_LARGE_BUF_LENGTH / 4)];
+
+/* buffers reference counters */
+LOCAL uint8 aui8SmallRefCount[BUFPOOL_UC_SMALL_BUF_NUM];
+LOCAL uint8 aui8MediumRefCount[BUFPOOL_UC_MEDIUM_BUF_NUM];
+LOCAL uint8 aui8LargeRefCount[BUFPOOL_UC_LARGE_BUF_NUM];
+
+/* size classes info in increasing length order */
+LOCAL const st_SizeClassInfo stSizeClassInfo[KE_CLASS_MAX_NUM] =
+{
+    {(uint8 *)aui32SmallBufs,  aui8SmallRefCount,  BUFPOOL_US_SMALL_BUF_LENGTH,  BUFPOOL_UC_SMALL_BUF_NUM},   /* KE_SMALL_CLASS */
+    {(uint8 *)aui32MediumBufs, aui8MediumRefCount, BUFPOOL_US_MEDIUM_BUF_LENGTH, BUFPOOL_UC_MEDIUM_BUF_NUM},  /* KE_MEDIUM_CLASS */
+    {(uint8 *)aui32LargeBufs,  aui8LargeRefCount,  BUFPOOL_US_LARGE_BUF_LENGTH,  BUFPOOL_UC_LARGE_BUF_NUM}    /* KE_LARGE_CLASS */
+};
+
+/* num of failed allocations */
+LOCAL uint32 ui32AllocFailCnt = UL_NULL;
+
+
+
+
+/* --------------- Local functions prototypes ----------------- */
+
+LOCAL uint8 *   getBufferRefCount   (uint8 *);
+
+
+
+
+/* --------------- Exported functions declaration -------------- */
+
+/* Init buffers pool: all buffers are free */
+EXPORTED void BUFPOOL_Init( void )
+{
+    ke_SizeClasses eClass;
+    uint8 ui8BufIdx;
+
+    for(eClass = KE_FIRST_CLASS; eClass <= KE_LAST_CLASS; eClass++)
+    {
+        for(ui8BufIdx = UC_NULL; ui8BufIdx < stSizeClassInfo[eClass].ui8NumOfBufs; ui8BufIdx++)
+        {
+            stSizeClassInfo[eClass].pui8RefCount[ui8BufIdx] = UC_NULL;
+        }
+    }
+
+    ui32AllocFailCnt = UL_NULL;
+}
+
+
+/* Get a free buffer of at least the required length from the smallest size class that has one.
+   The buffer is returned with one reference. Return NULL_PTR if no buffer is available */
+EXPORTED uint8 * BUFPOOL_alloc( uint16 ui16Length )
+{
+    uint8 *pui8BufPtr = NULL_PTR;
+    ke_SizeClasses eClass;
+    uint8 ui8BufIdx;
+
+    for(eClass = KE_FIRST_CLASS; ((eClass <= KE_LAST_CLASS) && (pui8BufPtr == NULL_PTR)); eClass++)
+    {
+        /* if buffers of this class are long enough */
+        if(ui16Length <= stSizeClassInfo[eClass].ui16BufLength)
+        {
+            /* search a free one */
+            for(ui8BufIdx = UC_NULL; ((ui8BufIdx < stSizeClassInfo[eClass].ui8NumOfBufs) && (pui8BufPtr == NULL_PTR)); ui8BufIdx++)
+            {
+                if(UC_NULL == stSizeClassInfo[eClass].pui8RefCount[ui8BufIdx])
+                {
+                    stSizeClassInfo[eClass].pui8RefCount[ui8BufIdx] = UC_1;
+
+                    pui8BufPtr = stSizeClassInfo[eClass].pui8Storage + ((uint32)ui8BufIdx * stSizeClassInfo[eClass].ui16BufLength);
+                }
+                else
+                {
+                    /* buffer in use */
+                }
+            }
+        }
+        else
+        {
+            /* too short: try next class */
+        }
+    }
+
+    if(NULL_PTR == pui8BufPtr)
+    {
+        ui32AllocFailCnt++;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    return pui8BufPtr;
+}
+
+
+/* Add a reference to an allocated buffer. Any pointer inside the buffer is accepted.
+   Return B_FALSE if the pointer is not inside an allocated pool buffer */
+EXPORTED boolean BUFPOOL_hold( uint8 *pui8DataPtr )
+{
+    boolean bSuccess;
+    uint8 *pui8RefCount;
+
+    pui8RefCount = getBufferRefCount(pui8DataPtr);
+
+    /* if allocated and the counter does not overflow */
+    if((pui8RefCount != NULL_PTR)
+    && (*pui8RefCount > UC_NULL)
+    && (*pui8RefCount < UC_MAX_UCHAR))
+    {
+        (*pui8RefCount)++;
+
+        bSuccess = B_TRUE;
+    }
+    else
+    {
+        bSuccess = B_FALSE;
+    }
+
+    return bSuccess;
+}
+
+
+/* Remove a reference to an allocated buffer. Any pointer inside the buffer is accepted.
+   The buffer is free once all references have been removed */
+EXPORTED void BUFPOOL_free( uint8 *pui8DataPtr )
+{
+    uint8 *pui8RefCount;
+
+    pui8RefCount = getBufferRefCount(pui8DataPtr);
+
+    if((pui8RefCount != NULL_PTR)
+    && (*pui8RefCount > UC_NULL))
+    {
+        (*pui8RefCount)--;
+    }
+    else
+    {
+        /* not a pool buffer or already free: do nothing */
+    }
+}
+
+
+/* Check if a pointer is inside a pool buffer */
+EXPORTED boolean BUFPOOL_isPoolBuffer( uint8 *pui8DataPtr )
+{
+    return (getBufferRefCount(pui8DataPtr) != NULL_PTR) ? B_TRUE : B_FALSE;
+}
+
+
+/* Get the num of free buffers of at least the required length */
+EXPORTED uint8 BUFPOOL_getFreeNum( uint16 ui16Length )
+{
+    uint8 ui8FreeNum = UC_NULL;
+    ke_SizeClasses eClass;
+    uint8 ui8BufIdx;
+
+    for(eClass = KE_FIRST_CLASS; eClass <= KE_LAST_CLASS; eClass++)
+    {
+        /* if buffers of this class are long enough */
+        if(ui16Length <= stSizeClassInfo[eClass].ui16BufLength)
+        {
+            for(ui8BufIdx = UC_NULL; ui8BufIdx < stSizeClassInfo[eClass].ui8NumOfBufs; ui8BufIdx++)
+            {
+                if(UC_NULL == stSizeClassInfo[eClass].pui8RefCount[ui8BufIdx])
+                {
+                    ui8FreeNum++;
+                }
+                else
+                {
+                    /* buffer in use */
+                }
+            }
+        }
+        else
+        {
+            /* too short: try next class */
+        }
+    }
+
+    return ui8FreeNum;
+}
+
+
+/* Get the num of failed allocations */
+EXPORTED uint32 BUFPOOL_getAllocFailures( void )
+{
+    return ui32AllocFailCnt;
+}
+
+
+
+
+/* ----------------- Local functions declaration ----------------- */
+
+/* get the reference counter of the buffer containing a pointer. Return NULL_PTR if not a pool buffer */
+LOCAL uint8 * getBufferRefCount( uint8 *pui8DataPtr )
+{
+    uint8 *pui8RefCount = NULL_PTR;
+    ke_SizeClasses eClass;
+    uint32 ui32Offset;
+
+    for(eClass = KE_FIRST_CLASS; ((eClass <= KE_LAST_CLASS) && (pui8RefCount == NULL_PTR)); eClass++)
+    {
+        /* if pointer is inside the class storage */
+        if((pui8DataPtr >= stSizeClassInfo[eClass].pui8Storage)
+        && (pui8DataPtr < (stSizeClassInfo[eClass].pui8Storage + ((uint32)stSizeClassInfo[eClass].ui8NumOfBufs * stSizeClassInfo[eClass].ui16BufLength))))
+        {
+            ui32Offset = (uint32)(pui8DataPtr - stSizeClassInfo[eClass].pui8Storage);
+
+            pui8RefCount = &stSizeClassInfo[eClass].pui8RefCount[(ui32Offset / stSizeClassInfo[eClass].ui16BufLength)];
+        }
+        else
+        {
+            /* try next class */
+        }
+    }
+
+    return pui8RefCount;
+}
+
+
+
+
+/* End of file */
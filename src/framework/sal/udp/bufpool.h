@@ -0,0 +1,72 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file bufpool.h represents the data buffers pool inclusion file of the UDP/IP stack.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+/* ------------ Inclusion files --------------- */
+#include "../../fw_common.h"
+
+
+
+
+/* --------------- Exported defines ----------------- */
+
+/* Small buffers length in bytes and num. ATTENTION: lengths must be multiple of 4 */
+#define BUFPOOL_US_SMALL_BUF_LENGTH         (128)
+#define BUFPOOL_UC_SMALL_BUF_NUM            (8)
+
+/* Medium buffers length in bytes and num */
+#define BUFPOOL_US_MEDIUM_BUF_LENGTH        (576)
+#define BUFPOOL_UC_MEDIUM_BUF_NUM           (4)
+
+/* Large buffers length in bytes and num. ATTENTION: IPv4 re-assembly contexts can hold one each, so the num
+   shall leave room for large datagrams to send (see IPV4_UC_REASM_TX_RESERVED_BUFS) */
+#define BUFPOOL_US_LARGE_BUF_LENGTH         (2048)
+#define BUFPOOL_UC_LARGE_BUF_NUM            (3)
+
+
+
+
+/* -------------- Exported functions prototypes -------------- */
+
+EXTERN void     BUFPOOL_Init            (void);
+EXTERN uint8 *  BUFPOOL_alloc           (uint16);
+EXTERN boolean  BUFPOOL_hold            (uint8 *);
+EXTERN void     BUFPOOL_free            (uint8 *);
+EXTERN boolean  BUFPOOL_isPoolBuffer    (uint8 *);
+EXTERN uint8    BUFPOOL_getFreeNum      (uint16);
+EXTERN uint32   BUFPOOL_getAllocFailures(void);
+
+
+
+
+/* End of file */
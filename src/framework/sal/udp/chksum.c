@@ -0,0 +1,341 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file chksum.c represents the Internet checksum (RFC 1071) shared by the
+ * IPv4, ICMP and UDP layers of the UDP/IP stack.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+/*
+TODO LIST:
+    1)  implement a 32-bit words copy for source and destination pointers with different alignment.
+        See CHKSUM_copyAndAccumulate() function
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "../../fw_common.h"
+#include "chksum.h"
+
+
+
+
+/* --------------- Local macros definitions ------------------ */
+
+/* fold a 64-bit sum into 32 bits adding carries */
+#define FOLD_64BIT_SUM(x)           ((x) = ((x) & 0xFFFFFFFF) + ((x) >> ULL_SHIFT_32)); \
+                                    ((x) = ((x) & 0xFFFFFFFF) + ((x) >> ULL_SHIFT_32))
+
+/* fold a 32-bit sum into 16 bits adding carries */
+#define FOLD_32BIT_SUM(x)           ((x) = ((x) & 0xFFFF) + ((x) >> UL_SHIFT_16)); \
+                                    ((x) = ((x) & 0xFFFF) + ((x) >> UL_SHIFT_16))
+
+/* check if a pointer is 16-bit or 32-bit aligned */
+#define IS_ODD_ADDRESS(x)           (((uint32)(x) & 0x1) != 0)
+#define IS_NOT_32BIT_ALIGNED(x)     (((uint32)(x) & 0x2) != 0)
+
+
+
+
+/* --------------- Local functions prototypes ----------------- */
+
+LOCAL uint32    completeSum     (uint32, uint64, boolean, uint8);
+
+
+
+
+/* --------------- Exported functions declaration -------------- */
+
+/* Add data to a partial checksum. Data are considered as starting at an even offset of the message.
+   16-bit words are summed in memory byte order. Data are read as 32-bit words once aligned */
+EXPORTED uint32 CHKSUM_accumulate( uint32 ui32Sum, const uint8 *pui8DataPtr, uint16 ui16Length )
+{
+    uint64 ui64Sum = ULL_NULL;
+    const uint32 *pui32Words;
+    uint16 ui16NumOfWords;
+    boolean bOddAddress = B_FALSE;
+    uint8 ui8FirstByte = UC_NULL;
+
+    /* if data start at an odd address then sum the first byte apart */
+    if((ui16Length > US_NULL)
+    && (IS_ODD_ADDRESS(pui8DataPtr)))
+    {
+        ui8FirstByte = *pui8DataPtr++;
+        ui16Length--;
+        bOddAddress = B_TRUE;
+    }
+    else
+    {
+        /* already 16-bit aligned */
+    }
+
+    /* if data are not 32-bit aligned then sum a 16-bit word apart */
+    if((ui16Length > US_1)
+    && (IS_NOT_32BIT_ALIGNED(pui8DataPtr)))
+    {
+        ui64Sum += *((const uint16 *)pui8DataPtr);
+        pui8DataPtr += UC_2;
+        ui16Length -= US_2;
+    }
+    else
+    {
+        /* already 32-bit aligned */
+    }
+
+    /* 32-bit words loop: unrolled by 4 */
+    pui32Words = (const uint32 *)pui8DataPtr;
+    ui16NumOfWords = (ui16Length >> US_SHIFT_2);
+    while(ui16NumOfWords >= US_4)
+    {
+        ui64Sum += pui32Words[0];
+        ui64Sum += pui32Words[1];
+        ui64Sum += pui32Words[2];
+        ui64Sum += pui32Words[3];
+        pui32Words += UC_4;
+        ui16NumOfWords -= US_4;
+    }
+    while(ui16NumOfWords > US_NULL)
+    {
+        ui64Sum += *pui32Words++;
+        ui16NumOfWords--;
+    }
+
+    /* remaining bytes */
+    pui8DataPtr = (const uint8 *)pui32Words;
+    ui16Length &= US_3;
+    if(ui16Length > US_1)
+    {
+        ui64Sum += *((const uint16 *)pui8DataPtr);
+        pui8DataPtr += UC_2;
+        ui16Length -= US_2;
+    }
+    else
+    {
+        /* do nothing */
+    }
+    /* take care of left over byte */
+    if(ui16Length > US_NULL)
+    {
+        ui64Sum += *pui8DataPtr;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    return completeSum(ui32Sum, ui64Sum, bOddAddress, ui8FirstByte);
+}
+
+
+/* Copy data and add them to a partial checksum in a single pass. Data are considered as starting at an even
+   offset of the message. If source and destination pointers have different alignment then a copy is performed
+   before summing */
+EXPORTED uint32 CHKSUM_copyAndAccumulate( uint8 *pui8DestPtr, const uint8 *pui8SrcPtr, uint16 ui16Length, uint32 ui32Sum )
+{
+    uint64 ui64Sum = ULL_NULL;
+    const uint32 *pui32SrcWords;
+    uint32 *pui32DestWords;
+    uint32 ui32Word;
+    uint16 ui16NumOfWords;
+    boolean bOddAddress = B_FALSE;
+    uint8 ui8FirstByte = UC_NULL;
+
+    /* if pointers cannot be aligned together */
+    if((((uint32)pui8DestPtr ^ (uint32)pui8SrcPtr) & 0x3) != 0)
+    {
+        /* copy and then sum */
+        MEM_COPY(pui8DestPtr, pui8SrcPtr, ui16Length);
+        ui32Sum = CHKSUM_accumulate(ui32Sum, pui8DestPtr, ui16Length);
+    }
+    else
+    {
+        /* if data start at an odd address then copy and sum the first byte apart */
+        if((ui16Length > US_NULL)
+        && (IS_ODD_ADDRESS(pui8SrcPtr)))
+        {
+            ui8FirstByte = *pui8SrcPtr++;
+            *pui8DestPtr++ = ui8FirstByte;
+            ui16Length--;
+            bOddAddress = B_TRUE;
+        }
+        else
+        {
+            /* already 16-bit aligned */
+        }
+
+        /* if data are not 32-bit aligned then copy and sum a 16-bit word apart */
+        if((ui16Length > US_1)
+        && (IS_NOT_32BIT_ALIGNED(pui8SrcPtr)))
+        {
+            *((uint16 *)pui8DestPtr) = *((const uint16 *)pui8SrcPtr);
+            ui64Sum += *((const uint16 *)pui8SrcPtr);
+            pui8SrcPtr += UC_2;
+            pui8DestPtr += UC_2;
+            ui16Length -= US_2;
+        }
+        else
+        {
+            /* already 32-bit aligned */
+        }
+
+        /* 32-bit words loop: unrolled by 4 */
+        pui32SrcWords = (const uint32 *)pui8SrcPtr;
+        pui32DestWords = (uint32 *)pui8DestPtr;
+        ui16NumOfWords = (ui16Length >> US_SHIFT_2);
+        while(ui16NumOfWords >= US_4)
+        {
+            ui32Word = pui32SrcWords[0];
+            pui32DestWords[0] = ui32Word;
+            ui64Sum += ui32Word;
+            ui32Word = pui32SrcWords[1];
+            pui32DestWords[1] = ui32Word;
+            ui64Sum += ui32Word;
+            ui32Word = pui32SrcWords[2];
+            pui32DestWords[2] = ui32Word;
+            ui64Sum += ui32Word;
+            ui32Word = pui32SrcWords[3];
+            pui32DestWords[3] = ui32Word;
+            ui64Sum += ui32Word;
+            pui32SrcWords += UC_4;
+            pui32DestWords += UC_4;
+            ui16NumOfWords -= US_4;
+        }
+        while(ui16NumOfWords > US_NULL)
+        {
+            ui32Word = *pui32SrcWords++;
+            *pui32DestWords++ = ui32Word;
+            ui64Sum += ui32Word;
+            ui16NumOfWords--;
+        }
+
+        /* remaining bytes */
+        pui8SrcPtr = (const uint8 *)pui32SrcWords;
+        pui8DestPtr = (uint8 *)pui32DestWords;
+        ui16Length &= US_3;
+        if(ui16Length > US_1)
+        {
+            *((uint16 *)pui8DestPtr) = *((const uint16 *)pui8SrcPtr);
+            ui64Sum += *((const uint16 *)pui8SrcPtr);
+            pui8SrcPtr += UC_2;
+            pui8DestPtr += UC_2;
+            ui16Length -= US_2;
+        }
+        else
+        {
+            /* do nothing */
+        }
+        /* take care of left over byte */
+        if(ui16Length > US_NULL)
+        {
+            *pui8DestPtr = *pui8SrcPtr;
+            ui64Sum += *pui8SrcPtr;
+        }
+        else
+        {
+            /* do nothing */
+        }
+
+        ui32Sum = completeSum(ui32Sum, ui64Sum, bOddAddress, ui8FirstByte);
+    }
+
+    return ui32Sum;
+}
+
+
+/* Get the checksum field value from a partial sum: fold, invert and swap bytes order.
+   A received message is valid if the checksum calculated over it (checksum field included) is 0 */
+EXPORTED uint16 CHKSUM_getChecksum( uint32 ui32Sum )
+{
+    /* fold 32-bit sum to 16 bits */
+    FOLD_32BIT_SUM(ui32Sum);
+
+    /* invert it */
+    ui32Sum = (~ui32Sum) & 0xFFFF;
+
+    /* swap bytes order */
+    return (uint16)SWAP_BYTES_ORDER_16BIT_(ui32Sum);
+}
+
+
+/* Update a checksum field value when a 16-bit word of the message changes, without summing the whole message
+   again (RFC 1624: HC' = ~(~HC + ~m + m')). Checksum and words shall be given in the same bytes order */
+EXPORTED uint16 CHKSUM_updateChecksum( uint16 ui16Checksum, uint16 ui16OldWord, uint16 ui16NewWord )
+{
+    uint32 ui32Sum;
+
+    ui32Sum = ((~(uint32)ui16Checksum) & 0xFFFF) + ((~(uint32)ui16OldWord) & 0xFFFF) + ui16NewWord;
+
+    /* fold 32-bit sum to 16 bits */
+    FOLD_32BIT_SUM(ui32Sum);
+
+    /* invert it */
+    return (uint16)((~ui32Sum) & 0xFFFF);
+}
+
+
+
+
+/* ----------------- Local functions declaration ----------------- */
+
+/* fold the data sum, realign it if data started at an odd address and add it to the previous partial sum */
+LOCAL uint32 completeSum( uint32 ui32PrevSum, uint64 ui64DataSum, boolean bOddAddress, uint8 ui8FirstByte )
+{
+    uint32 ui32DataSum;
+
+    /* fold data sum to 16 bits */
+    FOLD_64BIT_SUM(ui64DataSum);
+    ui32DataSum = (uint32)ui64DataSum;
+    FOLD_32BIT_SUM(ui32DataSum);
+
+    /* if data started at an odd address then 16-bit words have been summed with swapped bytes */
+    if(B_TRUE == bOddAddress)
+    {
+        ui32DataSum = CHKSUM_SWAP_PARTIAL_SUM(ui32DataSum);
+        /* the first byte is the low order byte of the first word */
+        ui32DataSum += ui8FirstByte;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    /* add to previous partial sum and fold */
+    ui32PrevSum = (ui32PrevSum & 0xFFFF) + (ui32PrevSum >> UL_SHIFT_16) + ui32DataSum;
+    FOLD_32BIT_SUM(ui32PrevSum);
+
+    return ui32PrevSum;
+}
+
+
+
+
+/* End of file */
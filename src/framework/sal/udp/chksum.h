@@ -0,0 +1,59 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file chksum.h represents the Internet checksum inclusion file of the UDP/IP stack.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+/* ------------ Inclusion files --------------- */
+#include "../../fw_common.h"
+
+
+
+
+/* --------------- Exported macros ----------------- */
+
+/* Swap bytes of a partial sum. To be used for data starting at an odd offset of the checksummed message */
+#define CHKSUM_SWAP_PARTIAL_SUM(x)          (SWAP_BYTES_ORDER_16BIT_((x) & 0xFFFF))
+
+
+
+
+/* -------------- Exported functions prototypes -------------- */
+
+EXTERN uint32   CHKSUM_accumulate           (uint32, const uint8 *, uint16);
+EXTERN uint32   CHKSUM_copyAndAccumulate    (uint8 *, const uint8 *, uint16, uint32);
+EXTERN uint16   CHKSUM_getChecksum          (uint32);
+EXTERN uint16   CHKSUM_updateChecksum       (uint16, uint16, uint16);
+
+
+
+
+/* End of file */
@@ -511,11 +511,13 @@ EXPORTED void DHCP_PeriodicTask( void )
         case KE_WAIT_TO_STATE:
         {
             /* check if a DHCP offer has been received */
-            UDP_checkReceivedData(UC_UDP_SOCKET_NUM, &pui8UDPRXDataPtr, &ui16UDPRXDataLength);
-            if(pui8UDPRXDataPtr != NULL_PTR)
+            if(UDP_OP_OK == UDP_getNextRXData(UC_UDP_SOCKET_NUM, &pui8UDPRXDataPtr, &ui16UDPRXDataLength))
             {
                 /* unpack received DCHP message */
                 ui8OptType = unpackReceivedMsg(&stDhcpNetInfo, pui8UDPRXDataPtr, ui16UDPRXDataLength);
+                /* received data are not used anymore: release them */
+                UDP_releaseRXData(UC_UDP_SOCKET_NUM);
+
                 if(DHCP_OPT_TYPE_OFFER == ui8OptType)
                 {
                     /* prepare REQUEST message */
@@ -608,8 +610,14 @@ EXPORTED void DHCP_PeriodicTask( void )
 
             break;
         }
-        case KE_DEINIT_STATE:
         case KE_INIT_STATE:
+        {
+            /* discard eventual DHCP messages received out of a request: their RX buffers are released */
+            while(UDP_OP_OK == UDP_getNextRXData(UC_UDP_SOCKET_NUM, &pui8UDPRXDataPtr, &ui16UDPRXDataLength));
+
+            break;
+        }
+        case KE_DEINIT_STATE:
         default:
             /* do nothing */
             break;
@@ -35,7 +35,6 @@
 /*
 TODO LIST:
 	1) manage multiple ECHO REQUESTS at the same time
-        2) share checksum calculation with IP layer (maybe)
 */
 
 
@@ -46,6 +45,7 @@ TODO LIST:
 #include "icmp.h"
 
 #include "ipv4.h"
+#include "chksum.h"
 #include "../rtos/rtos.h"
 
 
@@ -209,7 +209,6 @@ LOCAL st_PendingEchoReq stPendingEchoReq =
 LOCAL uint8 * 	prepareEchoRequestMsg	(st_PendingEchoReq *);
 LOCAL uint8 *	prepareEchoReplyMsg	(st_PendingEchoReply *);
 LOCAL void 	checkReceivedEchoReply	(uint8 *, uint16);
-LOCAL uint16    calculateChecksum       (uint8 *, uint8);
 
 
 
@@ -414,7 +413,7 @@ EXPORTED void ICMP_manageICMPMsg( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint
     if(B_TRUE == IPV4_checkLocalIPAdd(ui32DstIPAdd))
     {
         /* if checksum is valid */
-        if(US_NULL == calculateChecksum(pui8BufPtr, ui16MsgLength))
+        if(US_NULL == CHKSUM_getChecksum(CHKSUM_accumulate(UL_NULL, pui8BufPtr, ui16MsgLength)))
         {
             /* get CODE */
             GET_FIELD_CODE(pui8BufPtr, ui8Code);
@@ -502,31 +501,38 @@ LOCAL uint8 * prepareEchoReplyMsg( st_PendingEchoReply *pstPendEchoReply )
     IPV4_keOpResult unIPOpResult;
     IPv4_st_PacketDescriptor stIPv4PacketDscpt;
     uint16 ui16Checksum;
+    uint32 ui32Sum;
     uint8 *pui8MsgPtr = NULL_PTR;
 
     /* get IPV4 buffer data pointer */
-    pui8MsgPtr = IPV4_getDataBuffPtr();
+    pui8MsgPtr = IPV4_getDataBuffPtr(pstPendEchoReply->ui16MsgLength, IPV4_UC_DSCP_DEFAULT);
     if(pui8MsgPtr != NULL_PTR)
     {
         ALIGN_32BIT_OF_8BIT_PTR(pui8MsgPtr);
-        /* copy the entire REQUEST message as REPLY message (same identifier, seq num and data) */
-        MEM_COPY(pui8MsgPtr,
-                 (uint8 *)pstPendEchoReply->aui8ReqMsgCpy,
-                 pstPendEchoReply->ui16MsgLength);
+        /* copy the REQUEST message after the checksum field as REPLY message (same identifier, seq num and data)
+           and sum it in the same pass */
+        ui32Sum = CHKSUM_copyAndAccumulate((uint8 *)(pui8MsgPtr + UC_IDENTIF_BYTE_POS),
+                                           (uint8 *)(pstPendEchoReply->aui8ReqMsgCpy + UC_IDENTIF_BYTE_POS),
+                                           (pstPendEchoReply->ui16MsgLength - UC_IDENTIF_BYTE_POS),
+                                           UL_NULL);
         /* set echo type as REPLY */
         SET_FIELD_TYPE(pui8MsgPtr, UC_TYPE_ECHO_REPLY);
+        /* set echo code */
+        SET_FIELD_CODE(pui8MsgPtr, UC_CODE_ECHO);
         /* for checksum calculation the checksum should be at 0 */
         SET_FIELD_CHECKSUM(pui8MsgPtr, US_NULL);
-        /* calculate message checksum and update it */
-        ui16Checksum = calculateChecksum(pui8MsgPtr, pstPendEchoReply->ui16MsgLength);
+        /* add type, code and checksum fields to the sum and update checksum */
+        ui16Checksum = CHKSUM_getChecksum(CHKSUM_accumulate(ui32Sum, pui8MsgPtr, UC_IDENTIF_BYTE_POS));
         SET_FIELD_CHECKSUM(pui8MsgPtr, ui16Checksum);
 
         /* set IPv4 descriptor */
         stIPv4PacketDscpt.enProtocol = IPV4_PROT_ICMP;
         stIPv4PacketDscpt.bDoNotFragment = B_FALSE; /* ATTENTION: this value can change according to application request */
+        stIPv4PacketDscpt.ui8Dscp = IPV4_UC_DSCP_DEFAULT;
         stIPv4PacketDscpt.ui16DataLength = pstPendEchoReply->ui16MsgLength;
         stIPv4PacketDscpt.ui32IPDstAddress = pstPendEchoReply->ui32SrcIPAdd;
         stIPv4PacketDscpt.ui32IPSrcAddress = pstPendEchoReply->ui32DstIPAdd;
+        stIPv4PacketDscpt.pstHdrTemplate = NULL_PTR;
 
         /* send ICMP packet through IP */
         unIPOpResult = IPV4_SendPacket(stIPv4PacketDscpt);
@@ -552,10 +558,11 @@ LOCAL uint8 * prepareEchoRequestMsg( st_PendingEchoReq * pstPendEchoReq )
     IPV4_keOpResult unIPOpResult;
     IPv4_st_PacketDescriptor stIPv4PacketDscpt;
     uint16 ui16Checksum;
+    uint32 ui32Sum;
     uint8 *pui8MsgPtr = NULL_PTR;
 
     /* get IPV4 buffer data pointer */
-    pui8MsgPtr = IPV4_getDataBuffPtr();
+    pui8MsgPtr = IPV4_getDataBuffPtr(pstPendEchoReq->ui16MsgLength, IPV4_UC_DSCP_DEFAULT);
     if(pui8MsgPtr != NULL_PTR)
     {
         ALIGN_32BIT_OF_8BIT_PTR(pui8MsgPtr);
@@ -577,19 +584,21 @@ LOCAL uint8 * prepareEchoRequestMsg( st_PendingEchoReq * pstPendEchoReq )
         /* set sequence number field */
         SET_FIELD_SEQ_NUM(pui8MsgPtr, pstPendEchoReq->ui16SequenceNum);
 
-        /* set payload data */
-        MEM_COPY((uint8 *)(pui8MsgPtr + UC_FIRST_DATA_BYTE_POS), (uint8 *)(pstPendEchoReq->aui8DataPayload), (pstPendEchoReq->ui16MsgLength - UC_ECHO_REQ_HDR_LENGTH));
+        /* set payload data and sum it in the same pass */
+        ui32Sum = CHKSUM_copyAndAccumulate((uint8 *)(pui8MsgPtr + UC_FIRST_DATA_BYTE_POS), (uint8 *)(pstPendEchoReq->aui8DataPayload), (pstPendEchoReq->ui16MsgLength - UC_ECHO_REQ_HDR_LENGTH), UL_NULL);
 
-        /* calculate message checksum and update it */
-        ui16Checksum = calculateChecksum(pui8MsgPtr, pstPendEchoReq->ui16MsgLength);
+        /* add header to the sum and update checksum */
+        ui16Checksum = CHKSUM_getChecksum(CHKSUM_accumulate(ui32Sum, pui8MsgPtr, UC_ECHO_REQ_HDR_LENGTH));
         SET_FIELD_CHECKSUM(pui8MsgPtr, ui16Checksum);
 
         /* set IPv4 descriptor */
         stIPv4PacketDscpt.enProtocol = IPV4_PROT_ICMP;
         stIPv4PacketDscpt.bDoNotFragment = B_FALSE; /* ATTENTION: this value can change according to application request */
+        stIPv4PacketDscpt.ui8Dscp = IPV4_UC_DSCP_DEFAULT;
         stIPv4PacketDscpt.ui16DataLength = pstPendEchoReq->ui16MsgLength;
         stIPv4PacketDscpt.ui32IPDstAddress = pstPendEchoReq->ui32DstIPAdd;
         stIPv4PacketDscpt.ui32IPSrcAddress = pstPendEchoReq->ui32SrcIPAdd;
+        stIPv4PacketDscpt.pstHdrTemplate = NULL_PTR;
 
         /* send ICMP packet through IP */
         unIPOpResult = IPV4_SendPacket(stIPv4PacketDscpt);
@@ -638,50 +647,6 @@ LOCAL void checkReceivedEchoReply( uint8 *pui8BufPtr, uint16 ui16MsgLength )
 }
 
 
-/* calculate checksum */
-LOCAL uint16 calculateChecksum(uint8 *pui8Header, uint8 ui8HdrLength)
-{
-    uint16 *ui16HdrPointer;
-    uint32 ui32Checksum = 0;
-
-    ui16HdrPointer = (uint16 *)pui8Header;
-
-    while(ui8HdrLength > UC_1)
-    {
-        ui32Checksum += (*ui16HdrPointer);
-
-        ui16HdrPointer++;
-
-        /* if high order bit set, fold */
-        if(ui32Checksum & 0x80000000)
-        {
-            ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
-        }
-
-        ui8HdrLength -= 2;
-    }
-
-    /* take care of left over byte */
-    if(ui8HdrLength)
-    {
-        ui32Checksum += (uint16)(*((uint8 *)pui8Header));
-    }
-
-    while(ui32Checksum >> UL_SHIFT_16)
-    {
-        ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
-    }
-
-    /* invert it */
-    ui32Checksum = (~ui32Checksum);
-
-    /* swap bytes order */
-    ui32Checksum = SWAP_BYTES_ORDER_16BIT_((uint16)ui32Checksum);
-
-    return (uint16)ui32Checksum;
-}
-
-
 
 
 /* End of file */
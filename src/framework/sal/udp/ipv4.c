@@ -38,14 +38,18 @@
 #include "ipv4.h"
 #include "../../hal/ethmac.h"
 #include "arp.h"
+#include "route.h"
 #include "icmp.h"
 #include "udp.h"
+#include "chksum.h"
+#include "bufpool.h"
+#include "../rtos/rtos.h"
 
 
 /* 
 TODO LIST:
     1)  call ARP module to update ETH/IP addresses table. See manageReceivedPacket() function
-    2)  set a proper value to ui8Dscp, ui8Dscp and ui8TimeToLive. See sendPendingIPv4Packet() function and GET_TIME_TO_LIVE() macro
+    2)  set a proper value to ui8Ecn and ui8TimeToLive. See IPV4_prepareHeaderTemplate() function and GET_TIME_TO_LIVE() macro
     3)  ensure avoid data corruption of pui8DataBufferPtr: now it depends by IPV4_getDataBuffPtr() function
     4)  avoid to send data or return data pointer if module has been deinitialised. Refer to IPV4_Deinit function
 */
@@ -64,6 +68,12 @@ TODO LIST:
 /* Position in 32-bits words of checksum field in an IPv4 header (the first one is 0) */
 #define UC_IPV4_HDR_WORDS_CHK_POS       ((uint8)2)
 
+/* Position in 16-bits words of fields patched in a header template (the first one is 0) */
+#define UC_IPV4_HDR_TOT_LENGTH_POS      ((uint8)1)
+#define UC_IPV4_HDR_IDENTIF_POS         ((uint8)2)
+#define UC_IPV4_HDR_FLAGS_OFFSET_POS    ((uint8)3)
+#define UC_IPV4_HDR_CHECKSUM_POS        ((uint8)5)
+
 /* Ethernet type header field IPv4 value */
 #define US_ETH_TYPE_IPV4                ((uint16)0x0800)
 
@@ -78,12 +88,19 @@ TODO LIST:
 /* Byte position of source IP address in IPv4 header */
 #define UC_IPV4_SRC_IPADD_BYTE_POS      (12)
 
+/* Byte position of destination IP address in IPv4 header */
+#define UC_IPV4_DST_IPADD_BYTE_POS      (16)
+
+/* Limited broadcast IP address */
+#define UL_IPV4_BROADCAST_IP_ADD        ((uint32)0xFFFFFFFF)
+
+/* Multicast IP addresses range: 224.0.0.0/4 */
+#define UL_IPV4_MULTICAST_MASK          ((uint32)0xF0000000)
+#define UL_IPV4_MULTICAST_PREFIX        ((uint32)0xE0000000)
+
 /* IPv4 maximum options length in bytes */
 #define IPV4_HDR_OPT_MAX_BYTE_LENGTH    (40)
 
-/* Max allowed data length in bytes to transmit (fragmentation) */
-#define IPV4_US_MAX_TRANS_UNIT          ((uint16)IPV4_US_FRAG_MAX_LENGTH)
-
 /* Num of octects for each NFB */
 #define IPV4_UC_OCTECTS_EACH_NFB        ((uint8)8)      /* 8 octects */
 
@@ -97,6 +114,99 @@ TODO LIST:
 /* End of options list byte value */
 #define UC_END_OF_OPTIONS_LIST          ((uint8)0x00)
 
+/* Num of 8 octects blocks of the longest re-assembled datagram */
+#define US_REASM_MAX_BLOCKS             (IPV4_US_MAX_PAYLOAD_LENGTH / 8)
+
+/* Length in bytes of the received blocks map of a re-assembly context: one bit for each block */
+#define US_REASM_BLOCKS_MAP_LENGTH      ((US_REASM_MAX_BLOCKS + 7) / 8)
+
+/* RTOS callback used for the aging of re-assembly contexts */
+#define REASM_AGING_CALLBACK_ID         (RTOS_CB_ID_1)
+
+/* RTOS callback used to poll received frames left by a run that reached the RX frames budget */
+#define RX_REPOLL_CALLBACK_ID           (RTOS_CB_ID_2)
+
+/* RTOS event signalled by the ETHMAC interrupt at each received frame */
+#define RX_NOTIFY_EVENT_ID              (RTOS_EV_ID_1)
+
+/* RTOS event signalled by the ETHMAC interrupt at each sent or aborted frame */
+#define TX_NOTIFY_EVENT_ID              (RTOS_EV_ID_2)
+
+/* value check */
+#if IPV4_UC_HDR_TEMPLATE_WORDS != IPV4_HEADER_MIN_LENGTH
+#error IPV4_UC_HDR_TEMPLATE_WORDS define is different from IPV4_HEADER_MIN_LENGTH
+#endif
+
+/* value check */
+#if IPV4_US_DEFAULT_MTU > ETHMAC_US_MAX_MTU
+#error IPV4_US_DEFAULT_MTU define is greater than ETHMAC_US_MAX_MTU
+#endif
+
+/* value check */
+#if IPV4_UC_TX_QUEUE_DEPTH < 1
+#error IPV4_UC_TX_QUEUE_DEPTH define is lower than 1
+#endif
+
+/* value check: waiting packets are identified by their index */
+#if (IPV4_UC_ARP_WAIT_QUEUE_DEPTH < 1) || (IPV4_UC_ARP_WAIT_QUEUE_DEPTH > 255)
+#error IPV4_UC_ARP_WAIT_QUEUE_DEPTH define is out of range
+#endif
+
+/* value check */
+#if IPV4_UC_TX_MAX_PACKETS_PER_RUN < 1
+#error IPV4_UC_TX_MAX_PACKETS_PER_RUN define is lower than 1
+#endif
+
+/* value check */
+#if (IPV4_TX_SCHEDULING_POLICY != IPV4_TX_SCHED_STRICT_PRIORITY) && (IPV4_TX_SCHEDULING_POLICY != IPV4_TX_SCHED_WEIGHTED_RR)
+#error IPV4_TX_SCHEDULING_POLICY define is not a valid policy
+#endif
+
+/* value check */
+#if IPV4_US_MAX_PAYLOAD_LENGTH > BUFPOOL_US_LARGE_BUF_LENGTH
+#error IPV4_US_MAX_PAYLOAD_LENGTH define is greater than BUFPOOL_US_LARGE_BUF_LENGTH
+#endif
+
+/* value check: IPv4 header and data are sent as two ETHMAC segments */
+#if ETHMAC_UC_TX_MAX_SEGMENTS < 2
+#error ETHMAC_UC_TX_MAX_SEGMENTS define is lower than 2
+#endif
+
+/* value check */
+#if IPV4_UC_RX_FRAMES_BUDGET < 1
+#error IPV4_UC_RX_FRAMES_BUDGET define is lower than 1
+#endif
+
+/* value check */
+#if IPV4_UC_RX_COALESCE_FRAMES < 1
+#error IPV4_UC_RX_COALESCE_FRAMES define is lower than 1
+#endif
+
+/* value check */
+#if IPV4_UC_REASM_MAX_CONTEXTS < 1
+#error IPV4_UC_REASM_MAX_CONTEXTS define is lower than 1
+#endif
+
+/* value check */
+#if IPV4_UC_REASM_DONE_KEYS_NUM < 1
+#error IPV4_UC_REASM_DONE_KEYS_NUM define is lower than 1
+#endif
+
+/* value check */
+#if IPV4_US_REASM_MEMORY_BUDGET < IPV4_US_MAX_PAYLOAD_LENGTH
+#error IPV4_US_REASM_MEMORY_BUDGET define is lower than IPV4_US_MAX_PAYLOAD_LENGTH
+#endif
+
+/* value check: more budget than the contexts can hold is never used */
+#if IPV4_US_REASM_MEMORY_BUDGET > (IPV4_UC_REASM_MAX_CONTEXTS * IPV4_US_MAX_PAYLOAD_LENGTH)
+#error IPV4_US_REASM_MEMORY_BUDGET define is greater than IPV4_UC_REASM_MAX_CONTEXTS max length datagrams
+#endif
+
+/* value check: each re-assembly context can hold a large buffer and TX needs the reserved ones */
+#if BUFPOOL_UC_LARGE_BUF_NUM < (IPV4_UC_REASM_MAX_CONTEXTS + IPV4_UC_REASM_TX_RESERVED_BUFS)
+#error BUFPOOL_UC_LARGE_BUF_NUM define is lower than IPV4_UC_REASM_MAX_CONTEXTS plus IPV4_UC_REASM_TX_RESERVED_BUFS
+#endif
+
 
 
 
@@ -156,6 +266,16 @@ TODO LIST:
 /* Get source IP address from IPv4 header */
 #define GET_IPV4_SRC_IP_ADD(x,y)    READ_32BIT((x),(y))
 
+/* Get destination IP address from IPv4 header */
+#define GET_IPV4_DST_IP_ADD(x,y)    READ_32BIT((x),(y))
+
+/* Check if an IP address is a multicast one */
+#define IS_MULTICAST_IP_ADD(x)      (((x) & UL_IPV4_MULTICAST_MASK) == UL_IPV4_MULTICAST_PREFIX)
+
+/* Get TX class of a DSCP value from its precedence bits */
+#define GET_TX_CLASS(x)             (((x) >= UC_40) ? IPV4_TX_CLASS_CONTROL : \
+                                    ((((x) >> UC_SHIFT_3) == UC_1) ? IPV4_TX_CLASS_BULK : IPV4_TX_CLASS_BEST_EFFORT))
+
 /* Get time to live value. TODO: fixed at the moment. Implement something more clever */
 #define GET_TIME_TO_LIVE()          (0xFF)
 /* Get identifier number value. Just the current value and increment at the moment */
@@ -183,56 +303,164 @@ typedef struct
 } st_HeaderParams;
 
 
-/* RX pending fragmentation data struct */
+/* RX fragment struct */
+typedef struct
+{
+    uint16 ui16Identif;
+    uint32 ui32SrcIPAdd;
+    uint32 ui32DstIPAdd;
+    uint8 ui8Protocol;
+    boolean bMoreFrags;
+    uint16 ui16Offset;              /* offset of fragment data in bytes */
+    uint8 *pui8DataPtr;
+    uint16 ui16DataLength;
+    uint8 *pui8OptionsPtr;
+    uint8 ui8OptLength;
+} st_RXFragment;
+
+
+/* RX re-assembly context struct: one for each datagram under re-assembly */
 typedef struct
 {
+    boolean bInUse;
     uint16 ui16Identif;
     uint32 ui32SrcIPAdd;
     uint32 ui32DstIPAdd;
     uint8 ui8Protocol;
+    uint8 *pui8DataPtr;             /* pool buffer where fragments data are copied */
+    uint16 ui16BuffLength;          /* requested length of the pool buffer */
+    uint16 ui16TotLength;           /* datagram data length. Known at last fragment, 0 before */
+    uint16 ui16RXEnd;               /* highest end of fragments data received so far */
+    uint16 ui16RXBlocksNum;         /* num of 8 octects blocks received so far */
+    uint8 aui8RXBlocksMap[US_REASM_BLOCKS_MAP_LENGTH];   /* one bit for each received block: holes are 0 */
     uint8 aui8OptionsPtr[IPV4_HDR_OPT_MAX_BYTE_LENGTH];
     uint8 ui8OptLength;
     boolean bOptReady;
-    boolean bFragPending;
-} st_PendingFrag;
+    uint8 ui8Age;                   /* num of aging periods since the first received fragment */
+} st_ReasmContext;
+
+
+/* RX re-assembled datagram key: fragments matching it are late or duplicated ones */
+typedef struct
+{
+    boolean bInUse;
+    uint16 ui16Identif;
+    uint32 ui32SrcIPAdd;
+    uint32 ui32DstIPAdd;
+    uint8 ui8Protocol;
+    uint8 ui8Age;                   /* num of aging periods since the datagram has been re-assembled */
+} st_ReasmDoneKey;
+
+
+/* TX queue entry struct */
+typedef struct
+{
+    IPv4_st_PacketDescriptor stDscpt;
+    IPV4_st_HeaderTemplate stHdrTemplate;   /* header template of the packet. Descriptor template pointer is not kept */
+    uint8 *pui8DataPtr;             /* pool buffer owned by the entry until the packet is sent. NULL if free */
+    uint16 ui16Identif;             /* identifier of the packet: kept by all its fragments */
+    uint16 ui16SentDataLength;      /* data length already sent in fragments. Not 0 if TX ring got full meanwhile */
+} st_TXQueueEntry;
 
 
 
 
 /* ------------------- Local variables declaration ------------------- */
 
-/* TX data buffer pointer where upper layers write data */
-LOCAL uint8 *pui8TXDataBuffPtr;
+/* TX data buffer pointer where upper layers write data. Taken from the buffers pool on request
+   and moved into the TX queue by IPV4_SendPacket */
+LOCAL uint8 *pui8TXDataBuffPtr = NULL_PTR;
+
+/* packets waiting for transmission, one queue for each TX class. Entries from 0 to level - 1 are in FIFO order */
+LOCAL st_TXQueueEntry astTXQueue[IPV4_TX_CLASS_MAX_NUM][IPV4_UC_TX_QUEUE_DEPTH];
+
+/* num of queued packets of each TX class */
+LOCAL uint8 aui8TXQueueLevel[IPV4_TX_CLASS_MAX_NUM];
+
+#if (IPV4_TX_SCHEDULING_POLICY == IPV4_TX_SCHED_WEIGHTED_RR)
+/* weighted round-robin weights of TX classes */
+LOCAL const uint8 aui8TXClassWeight[IPV4_TX_CLASS_MAX_NUM] =
+{
+    IPV4_UC_TX_WRR_WEIGHT_CONTROL
+   ,IPV4_UC_TX_WRR_WEIGHT_BEST_EFFORT
+   ,IPV4_UC_TX_WRR_WEIGHT_BULK
+};
+#endif
+
+/* packets waiting for the ETH address of their next hop. Index is the handle queued in ARP module */
+LOCAL st_TXQueueEntry astARPWaitQueue[IPV4_UC_ARP_WAIT_QUEUE_DEPTH];
 
-/* RX data buffer pointer used for fragmented packets */
-LOCAL uint8 *pui8RXDataBuffPtr;
+/* num of packets discarded because their destination ETH address has not been resolved */
+LOCAL uint32 ui32TXDropCnt = UL_NULL;
 
-/* store pending packet to send */
-LOCAL IPv4_st_PacketDescriptor stPendingIPv4Packet;
+/* B_TRUE if last run of queued packets stopped because the ETHMAC TX ring was full. It is retried when a frame is sent */
+LOCAL boolean bTXRingFull = B_FALSE;
 
-/* signal a message ready to be sent */
-LOCAL boolean bPendingPacket = B_FALSE;
+/* MTU of the interface: max length in bytes of packets to transmit without fragmentation */
+LOCAL uint16 ui16MTU = IPV4_US_DEFAULT_MTU;
 
 /* counter of identifier field. Incremented at every packet send */
 LOCAL uint16 ui16IdentifCounter = 0x0500;
 
-/* RX pending fragmentation data struct */
-LOCAL st_PendingFrag stRXPendingFrag;
+/* RX re-assembly contexts */
+LOCAL st_ReasmContext astReasmContexts[IPV4_UC_REASM_MAX_CONTEXTS];
+
+/* num of bytes of the buffers pool held by re-assembly contexts */
+LOCAL uint32 ui32ReasmMemoryUsed = UL_NULL;
+
+/* keys of recently re-assembled datagrams. The oldest one is replaced by a new one */
+LOCAL st_ReasmDoneKey astReasmDoneKeys[IPV4_UC_REASM_DONE_KEYS_NUM];
+LOCAL uint8 ui8ReasmDoneNextIdx = UC_NULL;
+
+/* Num of ETHMAC payload checksums still to check against the software sum, and failed check flag */
+LOCAL uint8 ui8HWChecksumChecksLeft = IPV4_UC_HW_CHECKSUM_CHECKS;
+LOCAL boolean bHWChecksumFailed = B_FALSE;
 
 /* IP address obtained via DHCP. Init as 0.0.0.0 */
 LOCAL uint32 ui32ObtainedIPAdd = UL_NULL;
 
+/* Subnet mask of the local IP address. Init as 0.0.0.0: subnet not known */
+LOCAL uint32 ui32SubnetMask = UL_NULL;
+
+/* Router IP address set with the subnet mask. Init as 0.0.0.0: no default gateway */
+LOCAL uint32 ui32DHCPRouterIPAdd = UL_NULL;
+
+/* joined multicast groups. 0.0.0.0 means free entry */
+LOCAL uint32 aui32MulticastGroups[IPV4_UC_MAX_MULTICAST_GROUPS] = {0};
+
+/* RX destination filter statistics */
+LOCAL IPV4_st_RXFilterStats stRXFilterStats = {0};
+
+/* RX polling statistics */
+LOCAL IPV4_st_RXPollStats stRXPollStats = {0};
+
 
 
 
 /* ------------------ Local functions prototypes ------------------------ */
 
-LOCAL void      manageReceivedPacket    (void);
+LOCAL void      pollReceivedPackets     (void);
+LOCAL void      notifyReceivedPacket    (void);
+LOCAL void      notifySentPacket        (void);
+LOCAL void      manageSentPackets       (void);
+LOCAL boolean   manageReceivedPacket    (void);
+LOCAL boolean   isForThisHost           (uint32);
 LOCAL void      manageReceivedOptions   (uint8 *, uint8);
-LOCAL void      sendPendingIPv4Packet   (IPv4_st_PacketDescriptor *);
+LOCAL void      sendQueuedPackets       (void);
+LOCAL uint8     serveTXClass            (uint8, uint8);
+LOCAL boolean   waitForResolution       (st_TXQueueEntry *, uint32);
+LOCAL void      manageResolvedPacket    (uint8, uint64);
+LOCAL boolean   sendPendingIPv4Packet   (st_TXQueueEntry *);
+LOCAL void      applyHeaderTemplate     (uint8 *, const IPV4_st_HeaderTemplate *, st_HeaderParams *);
 LOCAL void      prepareIPv4Header       (uint8 *, st_HeaderParams *, st_HeaderOptions *);
 LOCAL void      decodeIPv4Packet        (uint8 *);
-LOCAL uint16    calcHeaderChecksum      (uint8 *, uint8);
+LOCAL st_ReasmContext * reassembleFragment  (st_RXFragment *);
+LOCAL st_ReasmContext * findReasmContext    (st_RXFragment *);
+LOCAL st_ReasmContext * createReasmContext  (st_RXFragment *, uint16);
+LOCAL void      releaseReasmContext     (st_ReasmContext *);
+LOCAL boolean   isReasmDone             (st_RXFragment *);
+LOCAL void      addReasmDoneKey         (st_ReasmContext *);
+LOCAL void      ageReasmContexts        (void);
 
 
 
@@ -249,6 +477,16 @@ EXPORTED uint32 IPV4_getObtainedIPAdd( void )
 /* set a new local IP address */
 EXPORTED void IPV4_setLocalIPAddress( uint32 ui32LocalIPAdd )
 {
+    /* if address changes then announce it: peers update their stale entries for our ETH address */
+    if(ui32LocalIPAdd != ui32ObtainedIPAdd)
+    {
+        ARP_sendGratuitousARP(ui32LocalIPAdd);
+    }
+    else
+    {
+        /* already announced: sockets opening set it again */
+    }
+
     /* store IP address in IPv4 module */
     ui32ObtainedIPAdd = ui32LocalIPAdd;
 
@@ -257,62 +495,182 @@ EXPORTED void IPV4_setLocalIPAddress( uint32 ui32LocalIPAdd )
 }
 
 
+/* add a hot peer: its ETH address is resolved in advance and kept refreshed by ARP module */
+EXPORTED boolean IPV4_addHotPeer( uint32 ui32IPAdd )
+{
+    return ARP_addHotPeer(ui32IPAdd);
+}
+
+
 /* set a router info: router IP address and subnet mask */
-EXPORTED void IPV4_setRouterInfo( uint32 ui32RouterIPAdd, uint32 ui32SubnetMask )
+EXPORTED void IPV4_setRouterInfo( uint32 ui32RouterIPAdd, uint32 ui32NewSubnetMask )
 {
-    /* update router info */
-    ARP_setRouterInfo(ui32RouterIPAdd, ui32SubnetMask);
+    /* remove the on-link route of the previous router info */
+    if(ui32SubnetMask != UL_NULL)
+    {
+        (void)ROUTE_removeRoute(ui32DHCPRouterIPAdd, ui32SubnetMask);
+    }
+    else
+    {
+        /* no previous on-link route */
+    }
+
+    /* router of the previous router info is no longer a hot peer */
+    ARP_removeHotPeer(ui32DHCPRouterIPAdd);
+
+    /* store router info. Subnet mask is used to recognise subnet broadcast */
+    ui32DHCPRouterIPAdd = ui32RouterIPAdd;
+    ui32SubnetMask = ui32NewSubnetMask;
+
+    /* router subnet is on-link */
+    if(ui32SubnetMask != UL_NULL)
+    {
+        (void)ROUTE_addRoute(ui32RouterIPAdd, ui32SubnetMask, ROUTE_UL_ON_LINK);
+    }
+    else
+    {
+        /* no on-link route */
+    }
+
+    /* router is the default gateway */
+    if(ui32RouterIPAdd != UL_NULL)
+    {
+        (void)ROUTE_addRoute(UL_NULL, UL_NULL, ui32RouterIPAdd);
+
+        /* first packets to the router shall not wait for ARP replies */
+        (void)ARP_addHotPeer(ui32RouterIPAdd);
+    }
+    else
+    {
+        (void)ROUTE_removeRoute(UL_NULL, UL_NULL);
+    }
 }
 
 
 /* Init IPv4 module */
 EXPORTED boolean IPV4_Init( void )
 {
-    boolean bInitSuccess;
+    uint8 ui8ContextIdx;
+    uint8 ui8ClassIdx;
+    uint8 ui8WaitIdx;
 
-    /* allocate TX data buffer */
-    pui8TXDataBuffPtr = (uint8 *)MEM_MALLOC(IPV4_US_ACCEPTED_MIN_LENGTH);
-    /* allocate RX data buffer */
-    pui8RXDataBuffPtr = (uint8 *)MEM_MALLOC(IPV4_US_ACCEPTED_MIN_LENGTH);
-    /* if both pointers are valid */
-    if((pui8TXDataBuffPtr != NULL_PTR) && (pui8RXDataBuffPtr != NULL_PTR))
+    /* init data buffers pool: TX and RX data buffers are taken from it on demand */
+    BUFPOOL_Init();
+    pui8TXDataBuffPtr = NULL_PTR;
+
+    /* TX queues are empty */
+    for(ui8ClassIdx = UC_NULL; ui8ClassIdx < IPV4_TX_CLASS_MAX_NUM; ui8ClassIdx++)
     {
-        /* init success */
-        bInitSuccess = B_TRUE;
+        aui8TXQueueLevel[ui8ClassIdx] = UC_NULL;
     }
-    else
+    ui32TXDropCnt = UL_NULL;
+    bTXRingFull = B_FALSE;
+
+    /* no packets waiting for ARP replies: ARP module passes them back once resolved */
+    for(ui8WaitIdx = UC_NULL; ui8WaitIdx < IPV4_UC_ARP_WAIT_QUEUE_DEPTH; ui8WaitIdx++)
+    {
+        astARPWaitQueue[ui8WaitIdx].pui8DataPtr = NULL_PTR;
+    }
+    ARP_setPendingCallback(&manageResolvedPacket);
+
+    /* data buffers referenced by TX frames are given back once the frames are sent */
+    ETHMAC_setTXDoneCallback(&BUFPOOL_free);
+
+    /* no datagram under re-assembly */
+    for(ui8ContextIdx = UC_NULL; ui8ContextIdx < IPV4_UC_REASM_MAX_CONTEXTS; ui8ContextIdx++)
+    {
+        astReasmContexts[ui8ContextIdx].bInUse = B_FALSE;
+    }
+    ui32ReasmMemoryUsed = UL_NULL;
+    for(ui8ContextIdx = UC_NULL; ui8ContextIdx < IPV4_UC_REASM_DONE_KEYS_NUM; ui8ContextIdx++)
     {
-        /* init fail */
-        bInitSuccess = B_FALSE;
+        astReasmDoneKeys[ui8ContextIdx].bInUse = B_FALSE;
     }
+    ui8ReasmDoneNextIdx = UC_NULL;
+
+    /* ETHMAC payload checksum is not trusted until checked */
+    ui8HWChecksumChecksLeft = IPV4_UC_HW_CHECKSUM_CHECKS;
+    bHWChecksumFailed = B_FALSE;
+
+    /* no routes until router info or static routes are set */
+    ROUTE_Init();
+    ui32DHCPRouterIPAdd = UL_NULL;
+    ui32SubnetMask = UL_NULL;
+
+    /* start aging of re-assembly contexts */
+    RTOS_SetCallback(REASM_AGING_CALLBACK_ID, RTOS_CB_TYPE_PERIODIC, IPV4_UL_REASM_AGING_PERIOD_MS, &ageReasmContexts);
 
-    return bInitSuccess;
+    /* received frames are polled as soon as they are notified, without waiting for next periodic task run */
+    RTOS_SetEventHandler(RX_NOTIFY_EVENT_ID, IPV4_UC_RX_COALESCE_FRAMES, IPV4_UL_RX_COALESCE_TIMEOUT_MS, &pollReceivedPackets);
+    ETHMAC_setRXNotifyCallback(&notifyReceivedPacket);
+
+    /* packets left queued by a full TX ring are sent again as soon as a frame is sent */
+    RTOS_SetEventHandler(TX_NOTIFY_EVENT_ID, UC_1, UL_NULL, &manageSentPackets);
+    ETHMAC_setTXNotifyCallback(&notifySentPacket);
+
+    /* init success */
+    return B_TRUE;
 }
 
 
 /* De-init IPv4 module */
 EXPORTED void IPV4_Deinit( void )
 {
+    uint8 ui8ContextIdx;
+    uint8 ui8ClassIdx;
+    uint8 ui8WaitIdx;
+
     /* free TX data buffer */
-    MEM_FREE(pui8TXDataBuffPtr);
-    /* free RX data buffer */
-    MEM_FREE(pui8RXDataBuffPtr);
+    BUFPOOL_free(pui8TXDataBuffPtr);
+    pui8TXDataBuffPtr = NULL_PTR;
+    /* discard queued packets */
+    for(ui8ClassIdx = UC_NULL; ui8ClassIdx < IPV4_TX_CLASS_MAX_NUM; ui8ClassIdx++)
+    {
+        while(aui8TXQueueLevel[ui8ClassIdx] > UC_NULL)
+        {
+            aui8TXQueueLevel[ui8ClassIdx]--;
+            BUFPOOL_free(astTXQueue[ui8ClassIdx][aui8TXQueueLevel[ui8ClassIdx]].pui8DataPtr);
+        }
+    }
+    for(ui8WaitIdx = UC_NULL; ui8WaitIdx < IPV4_UC_ARP_WAIT_QUEUE_DEPTH; ui8WaitIdx++)
+    {
+        BUFPOOL_free(astARPWaitQueue[ui8WaitIdx].pui8DataPtr);
+        astARPWaitQueue[ui8WaitIdx].pui8DataPtr = NULL_PTR;
+    }
+    /* stop aging and discard datagrams under re-assembly */
+    RTOS_StopCallback(REASM_AGING_CALLBACK_ID);
+    RTOS_StopCallback(RX_REPOLL_CALLBACK_ID);
+    /* stop polling received frames at notifications */
+    ETHMAC_setRXNotifyCallback(NULL_PTR);
+    RTOS_StopEventHandler(RX_NOTIFY_EVENT_ID);
+    ETHMAC_setTXNotifyCallback(NULL_PTR);
+    RTOS_StopEventHandler(TX_NOTIFY_EVENT_ID);
+    for(ui8ContextIdx = UC_NULL; ui8ContextIdx < IPV4_UC_REASM_MAX_CONTEXTS; ui8ContextIdx++)
+    {
+        releaseReasmContext(&astReasmContexts[ui8ContextIdx]);
+    }
 }
 
 
-/* Function to get data pointer */
-EXPORTED uint8 * IPV4_getDataBuffPtr( void )
+/* Function to get a data pointer where to write a payload of the required length to send with the given DSCP */
+EXPORTED uint8 * IPV4_getDataBuffPtr( uint16 ui16DataLength, uint8 ui8Dscp )
 {
     uint8 *pui8RetPtr;
 
-    /* If a previous packet is pending then return NULL */
-    /* The reason is to avoid data buffer corruption  */
-    if(B_TRUE == bPendingPacket)
+    /* If TX queue of the packet class is full then return NULL */
+    if((aui8TXQueueLevel[GET_TX_CLASS(ui8Dscp)] >= IPV4_UC_TX_QUEUE_DEPTH)
+    || (ui16DataLength > IPV4_US_MAX_PAYLOAD_LENGTH))
     {
         pui8RetPtr = NULL;
     }
     else
     {
+        /* give back an eventual buffer got before and not sent */
+        BUFPOOL_free(pui8TXDataBuffPtr);
+
+        /* get a buffer long enough */
+        pui8TXDataBuffPtr = BUFPOOL_alloc(ui16DataLength);
+
         pui8RetPtr = pui8TXDataBuffPtr;
     }
 
@@ -320,6 +678,45 @@ EXPORTED uint8 * IPV4_getDataBuffPtr( void )
 }
 
 
+/* Function to lend a received data buffer to upper layers. Any pointer inside the buffer is accepted.
+   The buffer is not reused until IPV4_releaseRXDataBuffer is called */
+EXPORTED boolean IPV4_lendRXDataBuffer( uint8 *pui8DataPtr )
+{
+    boolean bSuccess;
+
+    /* if pointer is inside a re-assembled packet buffer */
+    if(B_TRUE == BUFPOOL_isPoolBuffer(pui8DataPtr))
+    {
+        /* keep it until released */
+        bSuccess = BUFPOOL_hold(pui8DataPtr);
+    }
+    else
+    {
+        /* it is an ETHMAC RX buffer */
+        bSuccess = ETHMAC_lendRXDataBuffer(pui8DataPtr);
+    }
+
+    return bSuccess;
+}
+
+
+/* Function to release a previously lent data buffer */
+EXPORTED void IPV4_releaseRXDataBuffer( uint8 *pui8DataPtr )
+{
+    /* if pointer is inside a re-assembled packet buffer */
+    if(B_TRUE == BUFPOOL_isPoolBuffer(pui8DataPtr))
+    {
+        /* give it back to the buffers pool */
+        BUFPOOL_free(pui8DataPtr);
+    }
+    else
+    {
+        /* it is an ETHMAC RX buffer */
+        ETHMAC_releaseRXDataBuffer(pui8DataPtr);
+    }
+}
+
+
 /* Function to check if a IP address is a local one */
 EXPORTED boolean IPV4_checkLocalIPAdd( uint32 ui32IPAddress )
 {
@@ -330,40 +727,20 @@ EXPORTED boolean IPV4_checkLocalIPAdd( uint32 ui32IPAddress )
 /* Periodic task. Send pending TX packets and unpack received packets */
 EXPORTED void IPV4_PeriodicTask( void )
 {
-    uint64 ui64DstEthAdd;
-
-    /* manage eventual received packets */
-    manageReceivedPacket();
-
-    /* if a packet is ready to be sent */
-    if(B_TRUE == bPendingPacket)
-    {
-        /* update local IP addresses table */
-        ARP_setLocalIPAddress(stPendingIPv4Packet.ui32IPSrcAddress);
-        /* get ETH address from ARP module */
-        ui64DstEthAdd = ARP_getEthAddFromIPAdd(stPendingIPv4Packet.ui32IPSrcAddress, stPendingIPv4Packet.ui32IPDstAddress);
-//        ui64DstEthAdd = 0x000000262d904b96;
-
-        if(ui64DstEthAdd != ULL_NULL)
-        {
-            /* update dst ETH address */
-            stPendingIPv4Packet.ui64DstEthAdd = ui64DstEthAdd;
+    /* give back data buffers of sent frames */
+    ETHMAC_processTXDone();
 
-            /* prepare and send a packet */
-            sendPendingIPv4Packet(&stPendingIPv4Packet);
+    /* manage eventual received packets up to the RX frames budget */
+    pollReceivedPackets();
 
-            /* clear signal flag */
-            bPendingPacket = B_FALSE;
-        }
-        else
-        {
-            /* ETH address was unknown, an ARP request has been sent. Try at next run */
-        }
-    }
-    else
+    /* move UDP queued datagrams into the TX queue while there is room */
+    while(B_TRUE == UDP_sendNextQueuedData())
     {
         /* do nothing */
     }
+
+    /* send queued packets whose destination is resolved */
+    sendQueuedPackets();
 }
 
 
@@ -371,18 +748,42 @@ EXPORTED void IPV4_PeriodicTask( void )
 EXPORTED IPV4_keOpResult IPV4_SendPacket(IPv4_st_PacketDescriptor stPacketDescriptor)
 {
     IPV4_keOpResult unOpResult;
+    uint8 ui8Class;
+    st_TXQueueEntry *pstEntry;
+
+    /* TX class of the packet */
+    ui8Class = GET_TX_CLASS(stPacketDescriptor.ui8Dscp);
 
-    /* check data length */
-    if((stPacketDescriptor.ui16DataLength <= IPV4_US_MAX_DATAGRAM_LENGTH)
-    && (stPacketDescriptor.enProtocol < IPV4_PROT_CHECK_VALUE))
+    /* check data buffer, length and TX queue space */
+    if((pui8TXDataBuffPtr != NULL_PTR)
+    && (stPacketDescriptor.ui16DataLength <= IPV4_US_MAX_PAYLOAD_LENGTH)
+    && (stPacketDescriptor.enProtocol < IPV4_PROT_CHECK_VALUE)
+    && (aui8TXQueueLevel[ui8Class] < IPV4_UC_TX_QUEUE_DEPTH))
     {
-        /* copy requested packet to send */
-        stPendingIPv4Packet = stPacketDescriptor;
-        /* clear destination ethernet address */
-//        stPendingIPv4Packet.ui64DstEthAdd = ULL_NULL;
+        /* queue requested packet to send: the entry takes the data buffer */
+        pstEntry = &astTXQueue[ui8Class][aui8TXQueueLevel[ui8Class]];
+        pstEntry->stDscpt = stPacketDescriptor;
+        pstEntry->pui8DataPtr = pui8TXDataBuffPtr;
+
+        /* copy the given header template or prepare it */
+        if(stPacketDescriptor.pstHdrTemplate != NULL_PTR)
+        {
+            pstEntry->stHdrTemplate = *stPacketDescriptor.pstHdrTemplate;
+        }
+        else
+        {
+            IPV4_prepareHeaderTemplate(&pstEntry->stHdrTemplate,
+                                       stPacketDescriptor.ui32IPSrcAddress,
+                                       stPacketDescriptor.ui32IPDstAddress,
+                                       stPacketDescriptor.enProtocol,
+                                       stPacketDescriptor.ui8Dscp);
+        }
+        pstEntry->stDscpt.pstHdrTemplate = NULL_PTR;
+        pstEntry->ui16Identif = GET_IDENTIF_NUM();
+        pstEntry->ui16SentDataLength = US_NULL;
+        aui8TXQueueLevel[ui8Class]++;
 
-        /* set pending packet flag */
-        bPendingPacket = B_TRUE;
+        pui8TXDataBuffPtr = NULL_PTR;
 
         /* success */
         unOpResult = IPV4_OP_OK;
@@ -397,304 +798,1242 @@ EXPORTED IPV4_keOpResult IPV4_SendPacket(IPv4_st_PacketDescriptor stPacketDescri
 }
 
 
+/* Function to prepare a header template for packets with the given addresses, protocol and DSCP. Fields that change
+   for each packet are set as 0 */
+EXPORTED void IPV4_prepareHeaderTemplate( IPV4_st_HeaderTemplate *pstHdrTemplate, uint32 ui32IPSrcAddress, uint32 ui32IPDstAddress, IPV4_keSuppProtocols enProtocol, uint8 ui8Dscp )
+{
+    st_HeaderParams stHeaderParams;
+    st_HeaderOptions stHdrOptions;
+
+    /* constant fields */
+    stHeaderParams.ui8Protocol = (uint8)enProtocol;
+    stHeaderParams.ui32IPDstAddress = ui32IPDstAddress;
+    stHeaderParams.ui32IPSrcAddress = ui32IPSrcAddress;
+    stHeaderParams.ui8Dscp = ui8Dscp;
+    stHeaderParams.ui8Ecn = 0;                                              /* TODO: fixed at 0 at the moment */
+    stHeaderParams.ui8TimeToLive = GET_TIME_TO_LIVE();
+    stHeaderParams.ui8HdrLength = IPV4_HEADER_MIN_BYTE_LENGTH;
+
+    /* fields patched for each packet */
+    stHeaderParams.ui16TotLength = US_NULL;
+    stHeaderParams.ui16Identifier = US_NULL;
+    stHeaderParams.ui8Flags = UC_NULL;
+    stHeaderParams.ui16FragOffset = US_NULL;
 
+    /* no options in a template */
+    stHdrOptions.bSendOptions = B_FALSE;
+
+    prepareIPv4Header((uint8 *)pstHdrTemplate->aui32HdrWords, &stHeaderParams, &stHdrOptions);
+}
 
-/* ---------------- Local functions declaration ------------------- */
 
-/* unpack received packets from ETHMAC module */
-LOCAL void manageReceivedPacket( void )
+/* Function to get the num of packets discarded because their destination ETH address has not been resolved */
+EXPORTED uint32 IPV4_getTXDropCount( void )
 {
-    uint8 *pui8BufPtr;
-    uint16 ui16EthType = US_NULL;
-    uint32 ui32SrcIPAdd = UL_NULL;
-    uint64 ui64EthAddress = ULL_NULL;
+    return ui32TXDropCnt;
+}
 
-    /* get first buffer pointer */
-    pui8BufPtr = ETHMAC_getNextRXDataBuffer();
-    /* loop */
-    while(pui8BufPtr != NULL)
+
+/* Function to get the num of packets of a TX class waiting for transmission */
+EXPORTED uint8 IPV4_getTXQueueLevel( IPV4_keTXClass enClass )
+{
+    uint8 ui8Level;
+
+    if(enClass < IPV4_TX_CLASS_MAX_NUM)
     {
-        /* set pointer to src ETH address */
-        pui8BufPtr = (uint8 *)(pui8BufPtr + UC_ETH_MAC_ADD_LENGTH);
+        ui8Level = aui8TXQueueLevel[enClass];
+    }
+    else
+    {
+        /* invalid class */
+        ui8Level = UC_NULL;
+    }
 
-        /* get src ETH address */
-        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_40);
-        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_32);
-        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_24);
-        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_16);
-        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_8);
-        ui64EthAddress |= ((uint64)*pui8BufPtr++);
+    return ui8Level;
+}
 
-        /* get eth type */
-        ui16EthType = GET_ETHERTYPE(*((uint16 *)pui8BufPtr));
 
-        /* call related protocol function */
-        switch(ui16EthType)
-        {
-            case US_ETH_TYPE_IPV4:
-            {
-                /* get src IP address */
-                GET_IPV4_SRC_IP_ADD(((uint32 *)(pui8BufPtr + UC_IPV4_SRC_IPADD_BYTE_POS + UC_ETH_TYPE_LENGTH)), ui32SrcIPAdd);
+/* Function to set the MTU of the interface. Packets longer than it are fragmented */
+EXPORTED IPV4_keOpResult IPV4_setMTU( uint16 ui16NewMTU )
+{
+    IPV4_keOpResult unOpResult;
 
-                /* call ARP module to update ETH/IP addresses table */
-                ARP_setEthAddToIPAdd(ui32SrcIPAdd, ui64EthAddress);
-        
-                /* signal to IP layer that watermark has been reached */
-                decodeIPv4Packet((uint8 *)(pui8BufPtr + UC_ETH_TYPE_LENGTH));
+    /* MTU shall fit in ETHMAC buffers */
+    if((ui16NewMTU >= IPV4_US_MIN_MTU)
+    && (ui16NewMTU <= ETHMAC_US_MAX_MTU))
+    {
+        ui16MTU = ui16NewMTU;
+        unOpResult = IPV4_OP_OK;
+    }
+    else
+    {
+        unOpResult = IPV4_OP_FAIL;
+    }
 
-                break;
+    return unOpResult;
+}
+
+
+/* Function to get the MTU of the interface */
+EXPORTED uint16 IPV4_getMTU( void )
+{
+    return ui16MTU;
+}
+
+
+/* Function to join a multicast group: packets addressed to it are accepted */
+EXPORTED IPV4_keOpResult IPV4_joinMulticastGroup( uint32 ui32GroupIPAdd )
+{
+    IPV4_keOpResult unOpResult = IPV4_OP_FAIL;
+    uint8 ui8GroupIdx;
+    uint8 ui8FreeIdx = IPV4_UC_MAX_MULTICAST_GROUPS;
+
+    if(IS_MULTICAST_IP_ADD(ui32GroupIPAdd))
+    {
+        /* look for the group or for a free entry */
+        for(ui8GroupIdx = UC_NULL; ui8GroupIdx < IPV4_UC_MAX_MULTICAST_GROUPS; ui8GroupIdx++)
+        {
+            if(aui32MulticastGroups[ui8GroupIdx] == ui32GroupIPAdd)
+            {
+                /* already joined */
+                unOpResult = IPV4_OP_OK;
             }
-            case US_ETH_TYPE_ARP:
+            else if(aui32MulticastGroups[ui8GroupIdx] == UL_NULL)
             {
-                /* call ARP */
-                ARP_decodeARPPacket((uint8 *)(pui8BufPtr + UC_ETH_TYPE_LENGTH));
+                ui8FreeIdx = ui8GroupIdx;
             }
-            default:
+            else
             {
-                /* do nothing at the moment */
+                /* do nothing */
             }
         }
 
-        /* get next buffer pointer */
-        pui8BufPtr = ETHMAC_getNextRXDataBuffer();
+        /* if not joined yet and there is room then add it */
+        if((IPV4_OP_FAIL == unOpResult)
+        && (ui8FreeIdx < IPV4_UC_MAX_MULTICAST_GROUPS))
+        {
+            aui32MulticastGroups[ui8FreeIdx] = ui32GroupIPAdd;
+            unOpResult = IPV4_OP_OK;
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+    else
+    {
+        /* not a multicast address */
     }
+
+    return unOpResult;
 }
 
 
-/* decode received frame and call related upper layer */
-LOCAL void decodeIPv4Packet(uint8 *pui8FramePtr)
+/* Function to leave a multicast group */
+EXPORTED void IPV4_leaveMulticastGroup( uint32 ui32GroupIPAdd )
 {
-    uint32 ui32HdrLength;
-    uint32 ui32TotLength;
-    uint8 ui8Protocol;
-    uint8 ui8Flags;
-    uint16 ui16Identif;
-    uint16 ui16FragOffset;
-    uint16 ui16Checksum;
-    uint32 ui32SrcIPAdd;
-    uint32 ui32DstIPAdd;
-    uint32 *pui32HeaderPtr;
-    uint32 ui32HdrWord;
+    uint8 ui8GroupIdx;
+
+    for(ui8GroupIdx = UC_NULL; ui8GroupIdx < IPV4_UC_MAX_MULTICAST_GROUPS; ui8GroupIdx++)
+    {
+        if(aui32MulticastGroups[ui8GroupIdx] == ui32GroupIPAdd)
+        {
+            aui32MulticastGroups[ui8GroupIdx] = UL_NULL;
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+}
+
+
+/* Function to get the RX destination filter statistics */
+EXPORTED void IPV4_getRXFilterStats( IPV4_st_RXFilterStats *pstStats )
+{
+    *pstStats = stRXFilterStats;
+}
+
+
+/* Function to get the RX polling statistics */
+EXPORTED void IPV4_getRXPollStats( IPV4_st_RXPollStats *pstStats )
+{
+    *pstStats = stRXPollStats;
+}
+
+
+
+
+/* ---------------- Local functions declaration ------------------- */
+
+/* manage received packets up to the RX frames budget. If the budget is reached then schedule an RX poll
+   for the remaining ones. Called by periodic task and by the RX poll callback */
+LOCAL void pollReceivedPackets( void )
+{
+    stRXPollStats.ui32PollsCnt++;
+
+    if(B_TRUE == manageReceivedPacket())
+    {
+        /* frames are left: poll again without waiting for next periodic task run */
+        stRXPollStats.ui32BudgetExhaustedCnt++;
+        RTOS_SetCallback(RX_REPOLL_CALLBACK_ID, RTOS_CB_TYPE_SINGLE, IPV4_UL_RX_REPOLL_DELAY_MS, &pollReceivedPackets);
+    }
+    else
+    {
+        /* all received frames have been processed */
+    }
+}
+
+
+/* notify a received frame to the RTOS. ATTENTION: called by the ETHMAC interrupt */
+LOCAL void notifyReceivedPacket( void )
+{
+    RTOS_SignalEvent(RX_NOTIFY_EVENT_ID);
+}
+
+
+/* notify a sent frame to the RTOS. ATTENTION: called by the ETHMAC interrupt */
+LOCAL void notifySentPacket( void )
+{
+    RTOS_SignalEvent(TX_NOTIFY_EVENT_ID);
+}
+
+
+/* TX notify event handler: reclaim sent frames and send packets left queued by a full TX ring */
+LOCAL void manageSentPackets( void )
+{
+    /* give back data buffers of sent frames */
+    ETHMAC_processTXDone();
+
+    if(B_TRUE == bTXRingFull)
+    {
+        sendQueuedPackets();
+    }
+    else
+    {
+        /* nothing is waiting for a TX slot */
+    }
+}
+
+
+/* unpack received packets from ETHMAC module up to the RX frames budget.
+   Return B_TRUE if the budget has been reached and a received frame is still waiting, B_FALSE otherwise */
+LOCAL boolean manageReceivedPacket( void )
+{
+    uint8 *pui8BufPtr;
+    uint16 ui16EthType = US_NULL;
+    uint32 ui32SrcIPAdd = UL_NULL;
+    uint32 ui32DstIPAdd = UL_NULL;
+    uint64 ui64EthAddress;
+    uint8 *apui8FramesPtr[IPV4_UC_RX_FRAMES_BUDGET];
+    uint8 ui8FramesNum = UC_NULL;
+    uint8 ui8BatchNum;
+    uint8 ui8BatchIdx = UC_NULL;
+    boolean bBudgetReached = B_FALSE;
+
+    /* get the first batch of ready frames in arrival order */
+    ui8BatchNum = ETHMAC_getRXDataBuffers(apui8FramesPtr, IPV4_UC_RX_FRAMES_BUDGET);
+    /* loop */
+    while(ui8BatchIdx < ui8BatchNum)
+    {
+        pui8BufPtr = apui8FramesPtr[ui8BatchIdx];
+        ui8BatchIdx++;
+
+        /* reset src ETH address of previous packet */
+        ui64EthAddress = ULL_NULL;
+
+        /* set pointer to src ETH address */
+        pui8BufPtr = (uint8 *)(pui8BufPtr + UC_ETH_MAC_ADD_LENGTH);
+
+        /* get src ETH address */
+        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_40);
+        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_32);
+        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_24);
+        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_16);
+        ui64EthAddress |= ((uint64)*pui8BufPtr++ << ULL_SHIFT_8);
+        ui64EthAddress |= ((uint64)*pui8BufPtr++);
+
+        /* get eth type */
+        ui16EthType = GET_ETHERTYPE(*((uint16 *)pui8BufPtr));
+
+        /* call related protocol function */
+        switch(ui16EthType)
+        {
+            case US_ETH_TYPE_IPV4:
+            {
+                /* get dst IP address */
+                GET_IPV4_DST_IP_ADD(((uint32 *)(pui8BufPtr + UC_IPV4_DST_IPADD_BYTE_POS + UC_ETH_TYPE_LENGTH)), ui32DstIPAdd);
+
+                /* discard packets not addressed to this host before any other work */
+                if(B_TRUE == isForThisHost(ui32DstIPAdd))
+                {
+                    /* get src IP address */
+                    GET_IPV4_SRC_IP_ADD(((uint32 *)(pui8BufPtr + UC_IPV4_SRC_IPADD_BYTE_POS + UC_ETH_TYPE_LENGTH)), ui32SrcIPAdd);
+
+                    /* call ARP module to update ETH/IP addresses table */
+                    ARP_setEthAddToIPAdd(ui32SrcIPAdd, ui64EthAddress);
+
+                    /* signal to IP layer that watermark has been reached */
+                    decodeIPv4Packet((uint8 *)(pui8BufPtr + UC_ETH_TYPE_LENGTH));
+                }
+                else
+                {
+                    /* not for this host: discard it */
+                }
+
+                break;
+            }
+            case US_ETH_TYPE_ARP:
+            {
+                /* call ARP */
+                ARP_decodeARPPacket((uint8 *)(pui8BufPtr + UC_ETH_TYPE_LENGTH));
+            }
+            default:
+            {
+                /* do nothing at the moment */
+            }
+        }
+
+        ui8FramesNum++;
+
+        /* if the batch is over */
+        if(ui8BatchIdx >= ui8BatchNum)
+        {
+            /* get next batch if budget is not reached. Frames of the previous batch are given back to ETHMAC */
+            if(ui8FramesNum < IPV4_UC_RX_FRAMES_BUDGET)
+            {
+                ui8BatchNum = ETHMAC_getRXDataBuffers(apui8FramesPtr, (IPV4_UC_RX_FRAMES_BUDGET - ui8FramesNum));
+                ui8BatchIdx = UC_NULL;
+            }
+            else
+            {
+                /* stop here: remaining frames, if any, are left in ETHMAC buffers */
+                bBudgetReached = ETHMAC_isRXFrameWaiting();
+            }
+        }
+        else
+        {
+            /* next frame of the batch */
+        }
+    }
+
+    stRXPollStats.ui32FramesCnt += ui8FramesNum;
+
+    return bBudgetReached;
+}
+
+
+/* check if a packet destination IP address is one of this host: local unicast, limited or subnet broadcast
+   and joined multicast groups are accepted. Rejected packets are counted */
+LOCAL boolean isForThisHost( uint32 ui32DstIPAdd )
+{
+    boolean bAccepted = B_FALSE;
+    uint8 ui8GroupIdx;
+
+    /* if local IP address is not known yet (i.e. DHCP in progress) or it is the local one or limited broadcast */
+    if((UL_NULL == ui32ObtainedIPAdd)
+    || (ui32DstIPAdd == ui32ObtainedIPAdd)
+    || (ui32DstIPAdd == UL_IPV4_BROADCAST_IP_ADD))
+    {
+        bAccepted = B_TRUE;
+    }
+    /* if it is a multicast address then look for a joined group */
+    else if(IS_MULTICAST_IP_ADD(ui32DstIPAdd))
+    {
+        for(ui8GroupIdx = UC_NULL; ui8GroupIdx < IPV4_UC_MAX_MULTICAST_GROUPS; ui8GroupIdx++)
+        {
+            if(aui32MulticastGroups[ui8GroupIdx] == ui32DstIPAdd)
+            {
+                bAccepted = B_TRUE;
+            }
+            else
+            {
+                /* do nothing */
+            }
+        }
+
+        if(B_FALSE == bAccepted)
+        {
+            stRXFilterStats.ui32MulticastRejectCnt++;
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+    /* if subnet is known then check its broadcast address */
+    else if((ui32SubnetMask != UL_NULL)
+         && (ui32SubnetMask != UL_IPV4_BROADCAST_IP_ADD)
+         && ((ui32DstIPAdd | ui32SubnetMask) == UL_IPV4_BROADCAST_IP_ADD))
+    {
+        /* it is a broadcast address: accept the one of the local subnet only */
+        if((ui32DstIPAdd & ui32SubnetMask) == (ui32ObtainedIPAdd & ui32SubnetMask))
+        {
+            bAccepted = B_TRUE;
+        }
+        else
+        {
+            stRXFilterStats.ui32BroadcastRejectCnt++;
+        }
+    }
+    /* other local IP addresses are accepted */
+    else if(B_TRUE == ARP_checkLocalIPAdd(ui32DstIPAdd))
+    {
+        bAccepted = B_TRUE;
+    }
+    else
+    {
+        /* addressed to another host */
+        stRXFilterStats.ui32UnicastRejectCnt++;
+    }
+
+    return bAccepted;
+}
+
+
+/* decode received frame and call related upper layer */
+LOCAL void decodeIPv4Packet(uint8 *pui8FramePtr)
+{
+    uint32 ui32HdrLength;
+    uint32 ui32TotLength;
+    uint8 ui8Protocol;
+    uint8 ui8Flags;
+    uint16 ui16Identif;
+    uint16 ui16FragOffset;
+    uint16 ui16Checksum;
+    uint32 ui32SrcIPAdd;
+    uint32 ui32DstIPAdd;
+    uint32 *pui32HeaderPtr;
+    uint32 ui32HdrWord;
     uint8 *pui8DataPtr;
+    uint16 ui16DataLength;
+    uint32 ui32HdrSum;
+    uint32 ui32DataSum;
+    uint32 *pui32DataSum = NULL_PTR;
+    uint16 ui16HWChecksum;
+    uint16 ui16HWLength;
     uint8 *pui8OptionsPtr;
     uint8 ui8OptLength;
     boolean bOptReady = B_FALSE;
     boolean bSendDataUp = B_FALSE;
+    boolean bReassembled = B_FALSE;
+    st_RXFragment stFragment;
+    st_ReasmContext *pstContext = NULL_PTR;
+
+    /* decode header with pointer to uint32 */
+    pui32HeaderPtr = (uint32 *)pui8FramePtr;
+    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
+//    GET_HDR_VERSION(ui32HdrWord);
+    /* ATTENTION: ui32HdrLength field is in 32-bit words */
+    ui32HdrLength = GET_HDR_IHL(ui32HdrWord);
+//    GET_HDR_DSCP(ui32HdrWord);
+//    GET_HDR_ECN(ui32HdrWord);
+    ui32TotLength = GET_HDR_TOT_LENGTH(ui32HdrWord);
+    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
+    ui8Flags = GET_HDR_FLAGS(ui32HdrWord);
+    ui16Identif = GET_HDR_IDENTIF(ui32HdrWord);
+    ui16FragOffset = GET_HDR_FRAG_OFFSET(ui32HdrWord);
+    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
+//    GET_HDR_TIME_LIVE(ui32HdrWord);
+    ui8Protocol = GET_HDR_PROTOCOL(ui32HdrWord);
+    ui16Checksum = GET_HDR_CHECKSUM(ui32HdrWord);
+    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
+    ui32SrcIPAdd = GET_HDR_SRC_ADD(ui32HdrWord);
+    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
+    ui32DstIPAdd = GET_HDR_DST_ADD(ui32HdrWord);
+
+    /* sum header words. IHL is at most 15 words, so the sum never reads past the frame buffer */
+    ui32HdrSum = CHKSUM_accumulate(UL_NULL, pui8FramePtr, (ui32HdrLength * UC_4));
+
+    /* if header and total lengths are not consistent or the packet does not fit in the received frame */
+    if((ui32HdrLength < IPV4_HEADER_MIN_LENGTH)
+    || (ui32TotLength < (ui32HdrLength * UC_4))
+    || (ui32TotLength > ETHMAC_getRXPayloadLength(pui8FramePtr)))
+    {
+        /* malformed packet: discard it before any length derived from it is used */
+        stRXFilterStats.ui32MalformedCnt++;
+    }
+    /* if checksum is valid */
+    else if(US_NULL == CHKSUM_getChecksum(ui32HdrSum))
+    {
+        /* if it is a fragment */
+        if(((ui8Flags & IPV4_MORE_FRAG_FLAGS) != 0)
+        || (ui16FragOffset != US_NULL))
+        {
+            /* fill fragment struct */
+            stFragment.ui16Identif = ui16Identif;
+            stFragment.ui32SrcIPAdd = ui32SrcIPAdd;
+            stFragment.ui32DstIPAdd = ui32DstIPAdd;
+            stFragment.ui8Protocol = ui8Protocol;
+            stFragment.bMoreFrags = (((ui8Flags & IPV4_MORE_FRAG_FLAGS) != 0) ? B_TRUE : B_FALSE);
+            stFragment.ui16Offset = (uint16)(ui16FragOffset * IPV4_UC_OCTECTS_EACH_NFB);
+            stFragment.pui8DataPtr = (uint8 *)(pui8FramePtr + (ui32HdrLength * UC_4));
+            stFragment.ui16DataLength = (uint16)(ui32TotLength - (ui32HdrLength * UC_4));
+            stFragment.pui8OptionsPtr = (uint8 *)(pui8FramePtr + IPV4_HEADER_MIN_BYTE_LENGTH);
+            stFragment.ui8OptLength = (uint8)((ui32HdrLength - IPV4_HEADER_MIN_LENGTH) * UC_4);
+
+            /* add it to its datagram */
+            pstContext = reassembleFragment(&stFragment);
+
+            /* if the datagram is complete */
+            if(pstContext != NULL_PTR)
+            {
+                /* update options length. it depends by bOptReady flag, do it anyway */
+                ui8OptLength = pstContext->ui8OptLength;
+                /* update options pointer. it depends by bOptReady flag, do it anyway */
+                pui8OptionsPtr = pstContext->aui8OptionsPtr;
+                /* update option ready flag */
+                bOptReady = pstContext->bOptReady;
+                /* ui8Protocol, ui32SrcIPAdd and ui32DstIPAdd fields are the ones of the datagram */
+                /* set data pointer */
+                pui8DataPtr = pstContext->pui8DataPtr;
+                /* set re-assembled data length */
+                ui16DataLength = pstContext->ui16TotLength;
+
+                /* packet re-assembled: manage data */
+                bSendDataUp = B_TRUE;
+                bReassembled = B_TRUE;
+            }
+            else
+            {
+                /* wait for other fragments */
+            }
+        }
+        else
+        {
+            /* no fragmentation */
+
+            /* if options are present */
+            if(ui32HdrLength > IPV4_HEADER_MIN_LENGTH)
+            {
+                /* update options length */
+                ui8OptLength = ((ui32HdrLength - IPV4_HEADER_MIN_LENGTH) * UC_4);
+                /* update options pointer */
+                pui8OptionsPtr = (uint8 *)(pui8FramePtr + IPV4_HEADER_MIN_BYTE_LENGTH);
+                /* options are raady to be managed */
+                bOptReady = B_TRUE;
+            }
+            else
+            {
+                /* no options are present */
+                bOptReady = B_FALSE;
+            }
+
+            /* ui8Protocol, ui32SrcIPAdd and ui32DstIPAdd fields are already set */
+            /* set data pointer */
+            pui8DataPtr = (uint8 *)(pui8FramePtr + (ui32HdrLength * UC_4));
+            /* set data length */
+            ui16DataLength = (uint16)(ui32TotLength - (ui32HdrLength * UC_4));
+
+            /* if the hardware checksum is usable and available and it does not cover any frame padding */
+            if((B_TRUE != bHWChecksumFailed)
+            && (B_TRUE == ETHMAC_getRXPayloadChecksum(pui8FramePtr, &ui16HWChecksum, &ui16HWLength))
+            && (ui16HWLength == ui32TotLength))
+            {
+                /* remove the header from the hardware sum by adding its one's complement */
+                ui32DataSum = (uint32)SWAP_BYTES_ORDER_16BIT_(ui16HWChecksum);
+                ui32DataSum += ((~ui32HdrSum) & 0xFFFF);
+
+                /* if the hardware checksum is trusted then use it */
+                if(UC_NULL == ui8HWChecksumChecksLeft)
+                {
+                    pui32DataSum = &ui32DataSum;
+                }
+                /* check it against the software sum */
+                else if(CHKSUM_getChecksum(ui32DataSum) == CHKSUM_getChecksum(CHKSUM_accumulate(UL_NULL, pui8DataPtr, ui16DataLength)))
+                {
+                    ui8HWChecksumChecksLeft--;
+                    pui32DataSum = &ui32DataSum;
+                }
+                else
+                {
+                    /* hardware checksum is not the expected one: upper layers calculate it from now on */
+                    bHWChecksumFailed = B_TRUE;
+                }
+            }
+            else
+            {
+                /* data sum is not available: upper layers calculate it */
+            }
+
+            /* data ready to be managed */
+            bSendDataUp = B_TRUE;
+        }
+
+        /* if data are ready to be manged */
+        if(B_TRUE == bSendDataUp)
+        {
+            /* if options are present */
+            if(B_TRUE == bOptReady)
+            {
+                /* call function to manage options */
+                manageReceivedOptions(pui8OptionsPtr, ui8OptLength);
+            }
+            else
+            {
+                /* no options are present */
+            }
+
+            /* check protocol */
+            switch(ui8Protocol)
+            {
+                case IPV4_PROT_UDP:
+                {
+                    /* call UDP */
+                    UDP_unpackMessage(ui32SrcIPAdd, ui32DstIPAdd, (uint8 *)pui8DataPtr, ui16DataLength, pui32DataSum);
+                    /* source and destination IP addresses are passed to upper layer */
+
+                    break;
+                }
+                case IPV4_PROT_TCP:
+                {
+                    /* call TCP */
+                    /* not present at the moment */
+
+                    break;
+                }
+                case IPV4_PROT_ICMP:
+                {
+                    /* call ICMP */
+                    ICMP_manageICMPMsg(ui32SrcIPAdd, ui32DstIPAdd, (uint8 *)pui8DataPtr, ui16DataLength);
+                    /* source and destination IP addresses are passed to upper layer */
+
+                    break;
+                }
+                default:
+                {
+                    /* do nothing at the moment: discard message */
+                }
+            }
+
+            /* if data have been re-assembled then give the buffer back. It is kept if upper layers hold it */
+            if(B_TRUE == bReassembled)
+            {
+                releaseReasmContext(pstContext);
+            }
+            else
+            {
+                /* do nothing */
+            }
+        }
+    }
+    else
+    {
+        /* checksum is wrong: discard the packet! */
+    }
+}
+
+
+/* add a received fragment to the re-assembly context of its datagram. Fragments are accepted in any order:
+   received 8 octects blocks are marked in a map so duplicated and overlapping fragments are not counted twice.
+   Return the context if the datagram is complete, NULL otherwise */
+LOCAL st_ReasmContext * reassembleFragment( st_RXFragment *pstFragment )
+{
+    st_ReasmContext *pstContext;
+    st_ReasmContext *pstCompleted = NULL_PTR;
+    uint32 ui32FragEnd;
+    uint16 ui16BlockIdx;
+    uint16 ui16EndBlockIdx;
+    uint8 ui8BlockMask;
+
+    /* end of fragment data in the datagram */
+    ui32FragEnd = ((uint32)pstFragment->ui16Offset + pstFragment->ui16DataLength);
+
+    /* get the context of this datagram, if any */
+    pstContext = findReasmContext(pstFragment);
+
+    /* if the datagram has been already re-assembled then the fragment is a late or duplicated one */
+    if(B_TRUE == isReasmDone(pstFragment))
+    {
+        /* discard it: it would hold a new context until it expires */
+        stRXFilterStats.ui32LateFragmentCnt++;
+    }
+    /* if fragment exceeds the re-assembly buffer or it is not the last one and its length is not a multiple
+       of 8 octects then discard the whole datagram */
+    else if((ui32FragEnd > IPV4_US_MAX_PAYLOAD_LENGTH)
+         || ((B_TRUE == pstFragment->bMoreFrags)
+          && ((US_NULL == pstFragment->ui16DataLength)
+           || ((pstFragment->ui16DataLength % IPV4_UC_OCTECTS_EACH_NFB) != 0))))
+    {
+        releaseReasmContext(pstContext);
+    }
+    else
+    {
+        /* if this is the first received fragment of the datagram */
+        if(NULL_PTR == pstContext)
+        {
+            /* if it is the last fragment then the datagram length is known, otherwise take the max one */
+            if(B_FALSE == pstFragment->bMoreFrags)
+            {
+                pstContext = createReasmContext(pstFragment, (uint16)ui32FragEnd);
+            }
+            else
+            {
+                pstContext = createReasmContext(pstFragment, IPV4_US_MAX_PAYLOAD_LENGTH);
+            }
+        }
+        else
+        {
+            /* context already exists */
+        }
+
+        if(NULL_PTR == pstContext)
+        {
+            /* no room for a new datagram: discard the fragment */
+        }
+        /* if fragment does not fit in the buffer or it is inconsistent with the last fragment then discard the whole datagram */
+        else if((ui32FragEnd > pstContext->ui16BuffLength)
+             || ((pstContext->ui16TotLength != US_NULL)
+              && (ui32FragEnd > pstContext->ui16TotLength))
+             || ((B_FALSE == pstFragment->bMoreFrags)
+              && (((pstContext->ui16TotLength != US_NULL) && (ui32FragEnd != pstContext->ui16TotLength))
+               || (ui32FragEnd < pstContext->ui16RXEnd))))
+        {
+            releaseReasmContext(pstContext);
+        }
+        else
+        {
+            /* copy data in re-assembly buffer according to frag offset - discard eventual copied options */
+            MEM_COPY((pstContext->pui8DataPtr + pstFragment->ui16Offset),
+                     pstFragment->pui8DataPtr,
+                     pstFragment->ui16DataLength);
+
+            /* mark received blocks. The last block of the datagram may be partial */
+            ui16EndBlockIdx = (uint16)((ui32FragEnd + (IPV4_UC_OCTECTS_EACH_NFB - 1)) / IPV4_UC_OCTECTS_EACH_NFB);
+            for(ui16BlockIdx = (pstFragment->ui16Offset / IPV4_UC_OCTECTS_EACH_NFB); ui16BlockIdx < ui16EndBlockIdx; ui16BlockIdx++)
+            {
+                ui8BlockMask = (uint8)(UC_1 << (ui16BlockIdx & US_7));
+                if((pstContext->aui8RXBlocksMap[ui16BlockIdx >> US_SHIFT_3] & ui8BlockMask) == UC_NULL)
+                {
+                    pstContext->aui8RXBlocksMap[ui16BlockIdx >> US_SHIFT_3] |= ui8BlockMask;
+                    pstContext->ui16RXBlocksNum++;
+                }
+                else
+                {
+                    /* block already received */
+                }
+            }
+
+            /* update highest received end */
+            if(ui32FragEnd > pstContext->ui16RXEnd)
+            {
+                pstContext->ui16RXEnd = (uint16)ui32FragEnd;
+            }
+            else
+            {
+                /* do nothing */
+            }
+
+            /* if it is the last fragment then the datagram length is known */
+            if(B_FALSE == pstFragment->bMoreFrags)
+            {
+                pstContext->ui16TotLength = (uint16)ui32FragEnd;
+            }
+            else
+            {
+                /* do nothing */
+            }
+
+            /* if it is the first fragment and options are present */
+            if((US_NULL == pstFragment->ui16Offset)
+            && (pstFragment->ui8OptLength > UC_NULL))
+            {
+                /* copy options to manage later */
+                pstContext->ui8OptLength = pstFragment->ui8OptLength;
+                MEM_COPY(pstContext->aui8OptionsPtr, pstFragment->pui8OptionsPtr, pstContext->ui8OptLength);
+
+                /* options are valid and are pending to be managed */
+                pstContext->bOptReady = B_TRUE;
+            }
+            else
+            {
+                /* do nothing */
+            }
+
+            /* if datagram length is known and there are no holes then it is complete */
+            if((pstContext->ui16TotLength != US_NULL)
+            && (pstContext->ui16RXBlocksNum == ((pstContext->ui16TotLength + (IPV4_UC_OCTECTS_EACH_NFB - 1)) / IPV4_UC_OCTECTS_EACH_NFB)))
+            {
+                pstCompleted = pstContext;
+
+                /* fragments of this datagram received from now on are discarded */
+                addReasmDoneKey(pstContext);
+            }
+            else
+            {
+                /* wait for other fragments */
+            }
+        }
+    }
+
+    return pstCompleted;
+}
+
+
+/* find the re-assembly context of the datagram of a fragment. Return NULL if there is none */
+LOCAL st_ReasmContext * findReasmContext( st_RXFragment *pstFragment )
+{
+    st_ReasmContext *pstContext = NULL_PTR;
+    uint8 ui8ContextIdx;
+
+    for(ui8ContextIdx = UC_NULL; ((ui8ContextIdx < IPV4_UC_REASM_MAX_CONTEXTS) && (NULL_PTR == pstContext)); ui8ContextIdx++)
+    {
+        /* datagrams are identified by source and destination addresses, identifier and protocol */
+        if((B_TRUE == astReasmContexts[ui8ContextIdx].bInUse)
+        && (astReasmContexts[ui8ContextIdx].ui32SrcIPAdd == pstFragment->ui32SrcIPAdd)
+        && (astReasmContexts[ui8ContextIdx].ui32DstIPAdd == pstFragment->ui32DstIPAdd)
+        && (astReasmContexts[ui8ContextIdx].ui16Identif == pstFragment->ui16Identif)
+        && (astReasmContexts[ui8ContextIdx].ui8Protocol == pstFragment->ui8Protocol))
+        {
+            pstContext = &astReasmContexts[ui8ContextIdx];
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+
+    return pstContext;
+}
+
+
+/* create a re-assembly context for the datagram of a fragment with a buffer of the required length. Oldest datagrams
+   are discarded while there is no free context or the memory budget would be exceeded. Return NULL on failure */
+LOCAL st_ReasmContext * createReasmContext( st_RXFragment *pstFragment, uint16 ui16BuffLength )
+{
+    st_ReasmContext *pstFree;
+    st_ReasmContext *pstOldest;
+    uint8 ui8ContextIdx;
+    uint16 ui16MapIdx;
+    boolean bRoomAvailable;
+
+    do
+    {
+        pstFree = NULL_PTR;
+        pstOldest = NULL_PTR;
+
+        /* look for a free context and for the oldest used one */
+        for(ui8ContextIdx = UC_NULL; ui8ContextIdx < IPV4_UC_REASM_MAX_CONTEXTS; ui8ContextIdx++)
+        {
+            if(B_FALSE == astReasmContexts[ui8ContextIdx].bInUse)
+            {
+                pstFree = &astReasmContexts[ui8ContextIdx];
+            }
+            else if((NULL_PTR == pstOldest)
+                 || (astReasmContexts[ui8ContextIdx].ui8Age > pstOldest->ui8Age))
+            {
+                pstOldest = &astReasmContexts[ui8ContextIdx];
+            }
+            else
+            {
+                /* do nothing */
+            }
+        }
+
+        /* ATTENTION: it ends because the budget is not lower than the max buffer length */
+        if((NULL_PTR == pstFree)
+        || ((ui32ReasmMemoryUsed + ui16BuffLength) > IPV4_US_REASM_MEMORY_BUDGET))
+        {
+            /* discard the oldest datagram */
+            releaseReasmContext(pstOldest);
+            bRoomAvailable = B_FALSE;
+        }
+        else
+        {
+            bRoomAvailable = B_TRUE;
+        }
+    } while(B_FALSE == bRoomAvailable);
+
+    /* get a re-assembly buffer leaving the reserved ones to TX. ATTENTION: if no one is available then the fragment
+       is discarded */
+    if(BUFPOOL_getFreeNum(ui16BuffLength) > IPV4_UC_REASM_TX_RESERVED_BUFS)
+    {
+        pstFree->pui8DataPtr = BUFPOOL_alloc(ui16BuffLength);
+    }
+    else
+    {
+        pstFree->pui8DataPtr = NULL_PTR;
+    }
+    if(NULL_PTR == pstFree->pui8DataPtr)
+    {
+        pstFree = NULL_PTR;
+    }
+    else
+    {
+        /* copy all fragmentation related fields */
+        pstFree->ui16Identif = pstFragment->ui16Identif;
+        pstFree->ui32SrcIPAdd = pstFragment->ui32SrcIPAdd;
+        pstFree->ui32DstIPAdd = pstFragment->ui32DstIPAdd;
+        pstFree->ui8Protocol = pstFragment->ui8Protocol;
+
+        /* nothing received yet */
+        pstFree->ui16BuffLength = ui16BuffLength;
+        pstFree->ui16TotLength = US_NULL;
+        pstFree->ui16RXEnd = US_NULL;
+        pstFree->ui16RXBlocksNum = US_NULL;
+        for(ui16MapIdx = US_NULL; ui16MapIdx < US_REASM_BLOCKS_MAP_LENGTH; ui16MapIdx++)
+        {
+            pstFree->aui8RXBlocksMap[ui16MapIdx] = UC_NULL;
+        }
+        pstFree->bOptReady = B_FALSE;
+        pstFree->ui8Age = UC_NULL;
+
+        /* context is used */
+        ui32ReasmMemoryUsed += ui16BuffLength;
+        pstFree->bInUse = B_TRUE;
+    }
+
+    return pstFree;
+}
+
+
+/* release a re-assembly context and give its buffer back. It is kept if upper layers hold it. NULL is accepted */
+LOCAL void releaseReasmContext( st_ReasmContext *pstContext )
+{
+    if((pstContext != NULL_PTR)
+    && (B_TRUE == pstContext->bInUse))
+    {
+        BUFPOOL_free(pstContext->pui8DataPtr);
+        pstContext->pui8DataPtr = NULL_PTR;
+        ui32ReasmMemoryUsed -= pstContext->ui16BuffLength;
+        pstContext->bInUse = B_FALSE;
+    }
+    else
+    {
+        /* do nothing */
+    }
+}
+
+
+/* check if the datagram of a fragment has been recently re-assembled */
+LOCAL boolean isReasmDone( st_RXFragment *pstFragment )
+{
+    boolean bDone = B_FALSE;
+    uint8 ui8KeyIdx;
+
+    for(ui8KeyIdx = UC_NULL; ((ui8KeyIdx < IPV4_UC_REASM_DONE_KEYS_NUM) && (B_FALSE == bDone)); ui8KeyIdx++)
+    {
+        /* datagrams are identified by source and destination addresses, identifier and protocol */
+        if((B_TRUE == astReasmDoneKeys[ui8KeyIdx].bInUse)
+        && (astReasmDoneKeys[ui8KeyIdx].ui32SrcIPAdd == pstFragment->ui32SrcIPAdd)
+        && (astReasmDoneKeys[ui8KeyIdx].ui32DstIPAdd == pstFragment->ui32DstIPAdd)
+        && (astReasmDoneKeys[ui8KeyIdx].ui16Identif == pstFragment->ui16Identif)
+        && (astReasmDoneKeys[ui8KeyIdx].ui8Protocol == pstFragment->ui8Protocol))
+        {
+            bDone = B_TRUE;
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
 
-    /* decode header with pointer to uint32 */
-    pui32HeaderPtr = (uint32 *)pui8FramePtr;
-    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
-//    GET_HDR_VERSION(ui32HdrWord);
-    /* ATTENTION: ui32HdrLength field is in 32-bit words */
-    ui32HdrLength = GET_HDR_IHL(ui32HdrWord);
-//    GET_HDR_DSCP(ui32HdrWord);
-//    GET_HDR_ECN(ui32HdrWord);
-    ui32TotLength = GET_HDR_TOT_LENGTH(ui32HdrWord);
-    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
-    ui8Flags = GET_HDR_FLAGS(ui32HdrWord);
-    ui16Identif = GET_HDR_IDENTIF(ui32HdrWord);
-    ui16FragOffset = GET_HDR_FRAG_OFFSET(ui32HdrWord);
-    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
-//    GET_HDR_TIME_LIVE(ui32HdrWord);
-    ui8Protocol = GET_HDR_PROTOCOL(ui32HdrWord);
-    ui16Checksum = GET_HDR_CHECKSUM(ui32HdrWord);
-    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
-    ui32SrcIPAdd = GET_HDR_SRC_ADD(ui32HdrWord);
-    READ_32BIT_AND_NEXT(pui32HeaderPtr, ui32HdrWord);
-    ui32DstIPAdd = GET_HDR_DST_ADD(ui32HdrWord);
+    return bDone;
+}
 
-    /* if checksum is valid */
-    if(US_NULL == calcHeaderChecksum((uint8 *)pui8FramePtr, (ui32HdrLength * UC_4)))
+
+/* remember the key of a re-assembled datagram in place of the oldest one */
+LOCAL void addReasmDoneKey( st_ReasmContext *pstContext )
+{
+    st_ReasmDoneKey *pstKey = &astReasmDoneKeys[ui8ReasmDoneNextIdx];
+
+    pstKey->ui16Identif = pstContext->ui16Identif;
+    pstKey->ui32SrcIPAdd = pstContext->ui32SrcIPAdd;
+    pstKey->ui32DstIPAdd = pstContext->ui32DstIPAdd;
+    pstKey->ui8Protocol = pstContext->ui8Protocol;
+    pstKey->ui8Age = UC_NULL;
+    pstKey->bInUse = B_TRUE;
+
+    ui8ReasmDoneNextIdx = (uint8)((ui8ReasmDoneNextIdx + UC_1) % IPV4_UC_REASM_DONE_KEYS_NUM);
+}
+
+
+/* RTOS callback: age datagrams under re-assembly and discard the ones whose missing fragments did not arrive in time.
+   Keys of re-assembled datagrams are forgotten once late fragments cannot arrive anymore */
+LOCAL void ageReasmContexts( void )
+{
+    uint8 ui8ContextIdx;
+    uint8 ui8KeyIdx;
+
+    for(ui8KeyIdx = UC_NULL; ui8KeyIdx < IPV4_UC_REASM_DONE_KEYS_NUM; ui8KeyIdx++)
     {
-        /* if there is a pending fragmented packet */
-        if(B_TRUE == stRXPendingFrag.bFragPending)
+        if(B_TRUE == astReasmDoneKeys[ui8KeyIdx].bInUse)
         {
-            /* check if it is a fragment */
-            if((stRXPendingFrag.ui32DstIPAdd == ui32DstIPAdd)
-            && (stRXPendingFrag.ui32SrcIPAdd == ui32SrcIPAdd)
-            && (stRXPendingFrag.ui16Identif == ui16Identif)
-            && (stRXPendingFrag.ui8Protocol == ui8Protocol))
+            astReasmDoneKeys[ui8KeyIdx].ui8Age++;
+            if(astReasmDoneKeys[ui8KeyIdx].ui8Age >= IPV4_UC_REASM_MAX_AGE)
             {
-                /* copy data in RX buffer according to frag offset - discard eventual copied options */
-                MEM_COPY(((uint8 *)(pui8RXDataBuffPtr + (ui16FragOffset * IPV4_UC_OCTECTS_EACH_NFB))),
-                         ((uint32 *)(pui8FramePtr + (ui32HdrLength * UC_4))),
-                         (ui32TotLength - (ui32HdrLength * UC_4)));
-
-                /* if it is the last fragment */
-                if((ui8Flags & IPV4_MORE_FRAG_FLAGS) == 0)
-                {
-                    /* update options length. it depends by bOptReady flag, do it anyway */
-                    ui8OptLength = stRXPendingFrag.ui8OptLength;
-                    /* update options pointer. it depends by bOptReady flag, do it anyway */
-                    pui8OptionsPtr = stRXPendingFrag.aui8OptionsPtr;
-                    /* update option ready flag */
-                    bOptReady = stRXPendingFrag.bOptReady;
-                    /* update protocol field */
-                    ui8Protocol = stRXPendingFrag.ui8Protocol;
-                    /* set src IP address */
-                    ui32SrcIPAdd = stRXPendingFrag.ui32SrcIPAdd;
-                    /* set dst IP address */
-                    ui32DstIPAdd = stRXPendingFrag.ui32DstIPAdd;
-                    /* set data pointer */
-                    pui8DataPtr = (uint8 *)pui8RXDataBuffPtr;
-
-                    /* packet re-assembled: manage data */
-                    bSendDataUp = B_TRUE;
-					
-					/* reset flag */
-					stRXPendingFrag.bFragPending = B_FALSE;
-                }
-                else
-                {
-                    /* wait for other fragments */
-                }
+                astReasmDoneKeys[ui8KeyIdx].bInUse = B_FALSE;
             }
             else
             {
-                /* ATTENTION: other fragments than expected ones are discarded! */
+                /* late fragments can still arrive */
             }
         }
-        else    /* no pending fragmented packet */
+        else
+        {
+            /* do nothing */
+        }
+    }
+
+    for(ui8ContextIdx = UC_NULL; ui8ContextIdx < IPV4_UC_REASM_MAX_CONTEXTS; ui8ContextIdx++)
+    {
+        if(B_TRUE == astReasmContexts[ui8ContextIdx].bInUse)
         {
-            /* if there are more fragments and this is the first one */
-            if(((ui8Flags & IPV4_MORE_FRAG_FLAGS) == 1)
-            && (ui16FragOffset == US_NULL))
+            astReasmContexts[ui8ContextIdx].ui8Age++;
+            if(astReasmContexts[ui8ContextIdx].ui8Age >= IPV4_UC_REASM_MAX_AGE)
             {
-                /* copy all fragmentation related fields */
-                stRXPendingFrag.ui32DstIPAdd = ui32DstIPAdd;
-                stRXPendingFrag.ui32SrcIPAdd = ui32SrcIPAdd;
-                stRXPendingFrag.ui16Identif = ui16Identif;
-                stRXPendingFrag.ui8Protocol = ui8Protocol;
+                releaseReasmContext(&astReasmContexts[ui8ContextIdx]);
+            }
+            else
+            {
+                /* wait for missing fragments */
+            }
+        }
+        else
+        {
+            /* do nothing */
+        }
+    }
+}
 
-                /* copy data in RX buffer according to frag offset - discard eventual copied options */
-                MEM_COPY((uint8 *)pui8RXDataBuffPtr,
-                         ((uint32 *)(pui8FramePtr + (ui32HdrLength * UC_4))),
-                         (ui32TotLength - (ui32HdrLength * UC_4)));
 
-                /* if options are present */
-                if(ui32HdrLength > IPV4_HEADER_MIN_LENGTH)
-                {
-                    /* update options length */
-                    stRXPendingFrag.ui8OptLength = ((ui32HdrLength - IPV4_HEADER_MIN_LENGTH) * UC_4);
+/* manage received options */
+LOCAL void manageReceivedOptions( uint8 * pui8OptionsPtr, uint8 ui8OptLength )
+{
+    //TODO
+    //...
+}
 
-                    /* copy options to manage later */
-                    MEM_COPY(stRXPendingFrag.aui8OptionsPtr,
-                           (uint8 *)(pui8FramePtr + IPV4_HEADER_MIN_BYTE_LENGTH),
-                           stRXPendingFrag.ui8OptLength);
 
-                    /* options are valid and are pending to be managed */
-                    stRXPendingFrag.bOptReady = B_TRUE;
-                }
-                else
-                {
-                    /* no options are present */
-                    stRXPendingFrag.bOptReady = B_FALSE;
-                }
+/* send queued packets whose destination ETH address is resolved. TX classes are served according to
+   IPV4_TX_SCHEDULING_POLICY up to IPV4_UC_TX_MAX_PACKETS_PER_RUN packets or until the ETHMAC TX ring is full */
+LOCAL void sendQueuedPackets( void )
+{
+    uint8 ui8Budget = IPV4_UC_TX_MAX_PACKETS_PER_RUN;
+    uint8 ui8ClassIdx;
 
-                /* fragmentation pending */
-                stRXPendingFrag.bFragPending = B_TRUE;
-            }
-            else
+    /* TX ring is checked again by this run */
+    bTXRingFull = B_FALSE;
+
+#if (IPV4_TX_SCHEDULING_POLICY == IPV4_TX_SCHED_WEIGHTED_RR)
+    /* each class sends up to its weight */
+    for(ui8ClassIdx = UC_NULL; ui8ClassIdx < IPV4_TX_CLASS_MAX_NUM; ui8ClassIdx++)
+    {
+        ui8Budget -= serveTXClass(ui8ClassIdx, ((aui8TXClassWeight[ui8ClassIdx] < ui8Budget) ? aui8TXClassWeight[ui8ClassIdx] : ui8Budget));
+    }
+#endif
+
+    /* left budget goes to classes in priority order */
+    for(ui8ClassIdx = UC_NULL; ui8ClassIdx < IPV4_TX_CLASS_MAX_NUM; ui8ClassIdx++)
+    {
+        ui8Budget -= serveTXClass(ui8ClassIdx, ui8Budget);
+    }
+}
+
+
+/* send up to the given num of queued packets of a TX class in FIFO order. Packets whose next hop ETH address
+   is unknown are moved to the ARP wait queue, packets to unreachable next hops are discarded.
+   A packet that does not get a TX slot keeps its place and stops the run.
+   Return the num of sent packets */
+LOCAL uint8 serveTXClass( uint8 ui8Class, uint8 ui8MaxNum )
+{
+    uint64 ui64DstEthAdd;
+    uint32 ui32NextHop;
+    ARP_keEntryState enARPState;
+    uint8 ui8EntryIdx;
+    uint8 ui8KeptNum = UC_NULL;
+    uint8 ui8SentNum = UC_NULL;
+    boolean bKeepEntry;
+    st_TXQueueEntry *pstEntry;
+
+    for(ui8EntryIdx = UC_NULL; ui8EntryIdx < aui8TXQueueLevel[ui8Class]; ui8EntryIdx++)
+    {
+        pstEntry = &astTXQueue[ui8Class][ui8EntryIdx];
+        bKeepEntry = B_TRUE;
+
+        /* if budget is left and the TX ring is not full */
+        if((ui8SentNum < ui8MaxNum)
+        && (B_FALSE == bTXRingFull))
+        {
+            /* update local IP addresses table */
+            ARP_setLocalIPAddress(pstEntry->stDscpt.ui32IPSrcAddress);
+            /* get ETH address of the next hop from ARP module */
+            ui32NextHop = ROUTE_getNextHop(pstEntry->stDscpt.ui32IPDstAddress);
+            enARPState = ARP_resolveEthAdd(pstEntry->stDscpt.ui32IPSrcAddress, ui32NextHop, &ui64DstEthAdd);
+
+            if(ARP_STATE_REACHABLE == enARPState)
             {
-                /* no fragmentation */
+                /* update dst ETH address */
+                pstEntry->stDscpt.ui64DstEthAdd = ui64DstEthAdd;
 
-                /* if options are present */
-                if(ui32HdrLength > IPV4_HEADER_MIN_LENGTH)
+                /* prepare and send a packet */
+                if(B_TRUE == sendPendingIPv4Packet(pstEntry))
                 {
-                    /* update options length */
-                    ui8OptLength = ((ui32HdrLength - IPV4_HEADER_MIN_LENGTH) * UC_4);
-                    /* update options pointer */
-                    pui8OptionsPtr = (uint8 *)(pui8FramePtr + IPV4_HEADER_MIN_BYTE_LENGTH);
-                    /* options are raady to be managed */
-                    bOptReady = B_TRUE;
+                    /* sent frames hold their own references: give data buffer back */
+                    BUFPOOL_free(pstEntry->pui8DataPtr);
+                    ui8SentNum++;
+                    bKeepEntry = B_FALSE;
                 }
                 else
                 {
-                    /* no options are present */
-                    bOptReady = B_FALSE;
+                    /* TX ring is full: packet keeps its place and is sent again when a frame is sent */
+                    bTXRingFull = B_TRUE;
                 }
-
-                /* ui8Protocol, ui32SrcIPAdd and ui32DstIPAdd fields are already set */
-                /* set data pointer */
-                pui8DataPtr = (uint8 *)(pui8FramePtr + (ui32HdrLength * UC_4));
-
-                /* data ready to be managed */
-                bSendDataUp = B_TRUE;
             }
-        }
-
-        /* if data are ready to be manged */
-        if(B_TRUE == bSendDataUp)
-        {
-            /* if options are present */
-            if(B_TRUE == bOptReady)
+            else if(ARP_STATE_FAILED == enARPState)
             {
-                /* call function to manage options */
-                manageReceivedOptions(pui8OptionsPtr, ui8OptLength);
+                /* next hop is not answering: discard the packet */
+                BUFPOOL_free(pstEntry->pui8DataPtr);
+                ui32TXDropCnt++;
+                bKeepEntry = B_FALSE;
+            }
+            else if(B_TRUE == waitForResolution(pstEntry, ui32NextHop))
+            {
+                /* packet waits for the ARP reply out of the TX queue */
+                bKeepEntry = B_FALSE;
             }
             else
             {
-                /* no options are present */
+                /* no room to wait for the ARP reply: try at next run */
             }
+        }
+        else
+        {
+            /* packet waits for next run */
+        }
 
-            /* check protocol */
-            switch(ui8Protocol)
-            {
-                case IPV4_PROT_UDP:
-                {
-                    /* call UDP */
-                    UDP_unpackMessage(ui32SrcIPAdd, ui32DstIPAdd, (uint8 *)pui8DataPtr);
-                    /* source and destination IP addresses are passed to upper layer */
+        if(B_TRUE == bKeepEntry)
+        {
+            /* keep the entry after the other kept ones */
+            astTXQueue[ui8Class][ui8KeptNum] = *pstEntry;
+            ui8KeptNum++;
+        }
+        else
+        {
+            /* entry has been released */
+        }
+    }
 
-                    break;
-                }
-                case IPV4_PROT_TCP:
-                {
-                    /* call TCP */
-                    /* not present at the moment */
+    /* update queue level */
+    aui8TXQueueLevel[ui8Class] = ui8KeptNum;
 
-                    break;
-                }
-                case IPV4_PROT_ICMP:
-                {
-                    /* call ICMP */
-                    ICMP_manageICMPMsg(ui32SrcIPAdd, ui32DstIPAdd, (uint8 *)pui8DataPtr, (uint16)(ui32TotLength - (ui32HdrLength * UC_4)));
-                    /* source and destination IP addresses are passed to upper layer */
+    return ui8SentNum;
+}
 
-                    break;
+
+/* move a queued packet into a free entry of the ARP wait queue and queue its handle on the ARP cache entry
+   of its next hop. Return B_FALSE if the packet cannot wait there */
+LOCAL boolean waitForResolution( st_TXQueueEntry *pstEntry, uint32 ui32NextHop )
+{
+    boolean bWaiting = B_FALSE;
+    uint8 ui8WaitIdx = UC_NULL;
+
+    /* search a free entry */
+    while((ui8WaitIdx < IPV4_UC_ARP_WAIT_QUEUE_DEPTH)
+    &&    (astARPWaitQueue[ui8WaitIdx].pui8DataPtr != NULL_PTR))
+    {
+        ui8WaitIdx++;
+    }
+
+    /* if found and the ARP cache entry accepts it */
+    if((ui8WaitIdx < IPV4_UC_ARP_WAIT_QUEUE_DEPTH)
+    && (B_TRUE == ARP_queuePendingPacket(ui32NextHop, ui8WaitIdx)))
+    {
+        astARPWaitQueue[ui8WaitIdx] = *pstEntry;
+
+        bWaiting = B_TRUE;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    return bWaiting;
+}
+
+
+/* ARP pending packets callback: send a waiting packet once its next hop ETH address is known,
+   discard it if the next hop is unreachable. If the TX ring is full then the packet goes back to its TX queue */
+LOCAL void manageResolvedPacket( uint8 ui8WaitIdx, uint64 ui64DstEthAdd )
+{
+    st_TXQueueEntry *pstEntry;
+    uint8 ui8Class;
+
+    if((ui8WaitIdx < IPV4_UC_ARP_WAIT_QUEUE_DEPTH)
+    && (astARPWaitQueue[ui8WaitIdx].pui8DataPtr != NULL_PTR))
+    {
+        pstEntry = &astARPWaitQueue[ui8WaitIdx];
+
+        if(ui64DstEthAdd != ULL_NULL)
+        {
+            /* update dst ETH address */
+            pstEntry->stDscpt.ui64DstEthAdd = ui64DstEthAdd;
+
+            /* prepare and send a packet */
+            if(B_TRUE == sendPendingIPv4Packet(pstEntry))
+            {
+                /* sent frames hold their own references: give data buffer back */
+                BUFPOOL_free(pstEntry->pui8DataPtr);
+            }
+            else
+            {
+                /* TX ring is full: the packet is sent again from its TX queue when a frame is sent */
+                ui8Class = GET_TX_CLASS(pstEntry->stDscpt.ui8Dscp);
+                bTXRingFull = B_TRUE;
+
+                if(aui8TXQueueLevel[ui8Class] < IPV4_UC_TX_QUEUE_DEPTH)
+                {
+                    /* the queue entry takes the data buffer */
+                    astTXQueue[ui8Class][aui8TXQueueLevel[ui8Class]] = *pstEntry;
+                    aui8TXQueueLevel[ui8Class]++;
                 }
-                default:
+                else
                 {
-                    /* do nothing at the moment: discard message */
+                    /* no room in the TX queue: discard the packet */
+                    BUFPOOL_free(pstEntry->pui8DataPtr);
+                    ui32TXDropCnt++;
                 }
             }
         }
+        else
+        {
+            /* next hop is not answering: discard the packet */
+            BUFPOOL_free(pstEntry->pui8DataPtr);
+            ui32TXDropCnt++;
+        }
+
+        /* free the entry */
+        pstEntry->pui8DataPtr = NULL_PTR;
     }
     else
     {
-        /* checksum is wrong: discard the packet! */
+        /* invalid or already released handle */
     }
 }
 
 
-/* manage received options */
-LOCAL void manageReceivedOptions( uint8 * pui8OptionsPtr, uint8 ui8OptLength )
-{
-    //TODO
-    //...
-}
-
-
-/* send IPv4 packet through ETHMAC layer. Fragment packet if necessary */
-LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
+/* send a queued IPv4 packet through ETHMAC layer. Fragment packet if necessary. If the TX ring gets full then
+   the fragments already sent are recorded in the entry and next call goes on from the first unsent one.
+   Return B_FALSE if the packet has to be sent again, B_TRUE if it is done with (sent or discarded) */
+LOCAL boolean sendPendingIPv4Packet( st_TXQueueEntry *pstEntry )
 {
+    IPv4_st_PacketDescriptor *stPacketDscpt = &pstEntry->stDscpt;
+    uint8 *pui8DataPtr = pstEntry->pui8DataPtr;
+    const IPV4_st_HeaderTemplate *pstHdrTemplate = &pstEntry->stHdrTemplate;
+    boolean bPacketDone = B_TRUE;
+    boolean bFragFits;
     uint8 *pui8BuffPtr;
     st_HeaderParams stHeaderParams;
     st_HeaderOptions stHdrOptions;
     uint16 ui16TotalLength;
     uint16 ui16DataLength;
-    uint8 ui8NumOfFragPackets = UC_NULL;
     uint8 ui8NumOfNFB = UC_NULL;
+    uint8 *apui8SegmentsPtr[UC_2];
+    uint16 aui16SegmentsLength[UC_2];
+    uint8 ui8SegmentsNum;
+    uint8 *pui8HeldBuffer;
+    uint8 *pui8SlicePtr;
+    uint16 ui16CopyLength;
 
     /* copy option structure and examine it */
     stHdrOptions = stPacketDscpt->stOptions;
@@ -737,10 +2076,10 @@ LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
     stHeaderParams.ui8Protocol = (uint8)stPacketDscpt->enProtocol;          /* protocol */
     stHeaderParams.ui32IPDstAddress = stPacketDscpt->ui32IPDstAddress;      /* destination IP address */
     stHeaderParams.ui32IPSrcAddress = stPacketDscpt->ui32IPSrcAddress;      /* source IP address */
-    stHeaderParams.ui8Dscp = 0;                                             /* TODO: fixed at 0 at the moment */
+    stHeaderParams.ui8Dscp = stPacketDscpt->ui8Dscp;                        /* DSCP */
     stHeaderParams.ui8Ecn = 0;                                              /* TODO: fixed at 0 at the moment */
     stHeaderParams.ui8TimeToLive = GET_TIME_TO_LIVE();                      /* set time to live */
-    stHeaderParams.ui16Identifier = GET_IDENTIF_NUM();                      /* set identifier number */
+    stHeaderParams.ui16Identifier = pstEntry->ui16Identif;                  /* set identifier number */
     stHeaderParams.ui8Flags = UC_NULL;                                      /* reset flags */
     /* set flags field */
     if(B_TRUE == stPacketDscpt->bDoNotFragment)
@@ -756,11 +2095,11 @@ LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
     /* ATTENTION: stHeaderParams.ui8HdrLength field is in bytes */
     /* init header length to the minimum value */
     stHeaderParams.ui8HdrLength = IPV4_HEADER_MIN_BYTE_LENGTH;
-    /* calculate total length */
-    ui16TotalLength = stHeaderParams.ui8HdrLength + stHdrOptions.ui8TotOptLength + stPacketDscpt->ui16DataLength;
+    /* calculate total length. Data already sent in fragments are not considered */
+    ui16TotalLength = stHeaderParams.ui8HdrLength + stHdrOptions.ui8TotOptLength + (stPacketDscpt->ui16DataLength - pstEntry->ui16SentDataLength);
 
-    /* calculate num of NFB units once */
-    ui8NumOfNFB = (uint8)((IPV4_US_MAX_TRANS_UNIT - stHeaderParams.ui8HdrLength) / IPV4_UC_OCTECTS_EACH_NFB);
+    /* calculate num of NFB units once. Options length is considered in order to not exceed MTU */
+    ui8NumOfNFB = (uint8)((ui16MTU - (stHeaderParams.ui8HdrLength + stHdrOptions.ui8TotOptLength)) / IPV4_UC_OCTECTS_EACH_NFB);
 
     /* fragmentation loop */
     do
@@ -777,7 +2116,7 @@ LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
         }
 
         /* check if fragmentation is necessary and if yes then implement it */
-        if((ui16TotalLength > IPV4_US_MAX_TRANS_UNIT)
+        if((ui16TotalLength > ui16MTU)
         && (B_FALSE == stPacketDscpt->bDoNotFragment))
         {
             /* update total length */
@@ -792,14 +2131,14 @@ LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
             /* decrement remaining total length */
             ui16TotalLength -= ui16DataLength;
         }
-        /* ATTENTION: if do not fragment then send the datagram anyway without considering IPV4_US_MAX_TRANS_UNIT */
+        /* ATTENTION: if do not fragment then send the datagram anyway without considering MTU */
         else
         {
             /* update total length */
             stHeaderParams.ui16TotLength = ui16TotalLength;
 
-            /* set no more fragments flag */
-            stHeaderParams.ui8Flags = IPV4_NO_MORE_FRAG_FLAGS;
+            /* set no more fragments flag. Keep don't fragment flag if required */
+            stHeaderParams.ui8Flags = ((B_TRUE == stPacketDscpt->bDoNotFragment) ? IPV4_DO_NOT_FRAG_FLAGS : IPV4_NO_MORE_FRAG_FLAGS);
 
             /* update data length */
             ui16DataLength = (ui16TotalLength - stHeaderParams.ui8HdrLength);
@@ -809,28 +2148,138 @@ LOCAL void sendPendingIPv4Packet( IPv4_st_PacketDescriptor *stPacketDscpt )
         }
 
         /* update fragmentation offset field */
-        stHeaderParams.ui16FragOffset = (ui8NumOfFragPackets * ui8NumOfNFB);
+        stHeaderParams.ui16FragOffset = (pstEntry->ui16SentDataLength / IPV4_UC_OCTECTS_EACH_NFB);
+
+        /* fragment slice of the data buffer */
+        pui8SlicePtr = (pui8DataPtr + pstEntry->ui16SentDataLength);
+
+        /* frame is sent later: it holds a reference to the data buffer until then. If the reference cannot be taken
+           then data are copied after the header: the frame never points to a buffer that can be given back meanwhile */
+        if((US_NULL == ui16DataLength)
+        || (B_TRUE == BUFPOOL_hold(pui8DataPtr)))
+        {
+            pui8HeldBuffer = ((ui16DataLength > US_NULL) ? pui8DataPtr : NULL_PTR);
+            ui16CopyLength = US_NULL;
+        }
+        else
+        {
+            pui8HeldBuffer = NULL_PTR;
+            ui16CopyLength = ui16DataLength;
+        }
+
+        /* header and copied data shall fit in the TX buffer */
+        bFragFits = (((stHeaderParams.ui8HdrLength + ui16CopyLength) <= ETHMAC_US_MAX_MTU) ? B_TRUE : B_FALSE);
+
+        /* get next buffer pointer: the header and copied data only are written in it. NULL if TX ring is full */
+        if(B_TRUE == bFragFits)
+        {
+            pui8BuffPtr = (uint8 *)ETHMAC_getTXBufferPointer((uint16)(stHeaderParams.ui8HdrLength + ui16CopyLength));
+        }
+        else
+        {
+            pui8BuffPtr = NULL_PTR;
+        }
 
-        /* get next buffer pointer */
-        pui8BuffPtr = (uint8 *)ETHMAC_getTXBufferPointer(stHeaderParams.ui16TotLength);
-        /* perform a 32-bit word alignment */
-        ALIGN_32BIT_OF_8BIT_PTR(pui8BuffPtr);
+        if(pui8BuffPtr != NULL_PTR)
+        {
+            /* perform a 32-bit word alignment */
+            ALIGN_32BIT_OF_8BIT_PTR(pui8BuffPtr);
+
+            /* update header: options need a full header preparation, otherwise the template is patched */
+            if(B_TRUE == stHdrOptions.bSendOptions)
+            {
+                prepareIPv4Header(pui8BuffPtr, &stHeaderParams, &stHdrOptions);
+            }
+            else
+            {
+                applyHeaderTemplate(pui8BuffPtr, pstHdrTemplate, &stHeaderParams);
+            }
+
+            /* header segment */
+            apui8SegmentsPtr[UC_0] = pui8BuffPtr;
+            aui16SegmentsLength[UC_0] = stHeaderParams.ui8HdrLength;
+            ui8SegmentsNum = UC_1;
 
-        /* update header */
-        prepareIPv4Header(pui8BuffPtr, &stHeaderParams, &stHdrOptions);
+            /* if data are referenced then the fragment slice of the data buffer is sent as a second segment */
+            if(pui8HeldBuffer != NULL_PTR)
+            {
+                apui8SegmentsPtr[UC_1] = pui8SlicePtr;
+                aui16SegmentsLength[UC_1] = ui16DataLength;
+                ui8SegmentsNum++;
+            }
+            else
+            {
+                /* copied data, if any, are part of the first segment */
+                MEM_COPY((pui8BuffPtr + stHeaderParams.ui8HdrLength), pui8SlicePtr, ui16CopyLength);
+                aui16SegmentsLength[UC_0] += ui16CopyLength;
+            }
 
-        /* attach data */
-        MEM_COPY((uint8 *)(pui8BuffPtr + stHeaderParams.ui8HdrLength),
-                 (pui8TXDataBuffPtr + (ui8NumOfFragPackets * (ui8NumOfNFB * IPV4_UC_OCTECTS_EACH_NFB))),
-                 ui16DataLength);
+            /* request TX packet transmission. A slot is free since a buffer pointer has been given */
+            (void)ETHMAC_sendPacketVector(apui8SegmentsPtr, aui16SegmentsLength, ui8SegmentsNum, ETHMAC_ui64MACAddress, stPacketDscpt->ui64DstEthAdd, US_ETH_TYPE_IPV4, pui8HeldBuffer);
 
-        /* increment num of fragmentation packets */
-        ui8NumOfFragPackets++;
+            /* fragment is sent */
+            pstEntry->ui16SentDataLength += ui16DataLength;
+        }
+        else
+        {
+            /* the reference to the data buffer, if taken, is not used */
+            if(pui8HeldBuffer != NULL_PTR)
+            {
+                BUFPOOL_free(pui8HeldBuffer);
+            }
+            else
+            {
+                /* no reference */
+            }
 
-        /* request TX packet transmission */
-        ETHMAC_sendPacket(pui8BuffPtr, stHeaderParams.ui16TotLength, ETHMAC_ui64MACAddress, stPacketDscpt->ui64DstEthAdd, US_ETH_TYPE_IPV4);
+            /* if the TX ring is full then the fragment is sent at next call */
+            if(B_TRUE == bFragFits)
+            {
+                bPacketDone = B_FALSE;
+            }
+            else
+            {
+                /* data can be neither referenced nor copied: discard the rest of the datagram */
+                ui32TXDropCnt++;
+            }
 
+            ui16TotalLength = US_NULL;
+        }
     } while(ui16TotalLength > UC_NULL);
+
+    return bPacketDone;
+}
+
+
+/* copy a header template and patch total length, identifier, flags and fragment offset fields.
+   They are 0 in the template so the checksum is updated incrementally (RFC 1624) */
+LOCAL void applyHeaderTemplate(uint8 *pui8HdrPtr, const IPV4_st_HeaderTemplate *pstHdrTemplate, st_HeaderParams *stHdrParams)
+{
+    uint16 *pui16HdrWordsPtr;
+    uint16 ui16Checksum;
+    uint16 ui16FlagsOffset;
+
+    /* copy constant fields */
+    MEM_COPY(pui8HdrPtr, pstHdrTemplate->aui32HdrWords, IPV4_HEADER_MIN_BYTE_LENGTH);
+
+    pui16HdrWordsPtr = (uint16 *)pui8HdrPtr;
+    READ_16BIT(&pui16HdrWordsPtr[UC_IPV4_HDR_CHECKSUM_POS], ui16Checksum);
+
+    /* set total length */
+    WRITE_16BIT(&pui16HdrWordsPtr[UC_IPV4_HDR_TOT_LENGTH_POS], stHdrParams->ui16TotLength);
+    ui16Checksum = CHKSUM_updateChecksum(ui16Checksum, US_NULL, stHdrParams->ui16TotLength);
+
+    /* set identifier */
+    WRITE_16BIT(&pui16HdrWordsPtr[UC_IPV4_HDR_IDENTIF_POS], stHdrParams->ui16Identifier);
+    ui16Checksum = CHKSUM_updateChecksum(ui16Checksum, US_NULL, stHdrParams->ui16Identifier);
+
+    /* set flags and fragmentation offset */
+    ui16FlagsOffset = (uint16)(((stHdrParams->ui8Flags & 0x7) << UL_SHIFT_13) | (stHdrParams->ui16FragOffset & 0x1FFF));
+    WRITE_16BIT(&pui16HdrWordsPtr[UC_IPV4_HDR_FLAGS_OFFSET_POS], ui16FlagsOffset);
+    ui16Checksum = CHKSUM_updateChecksum(ui16Checksum, US_NULL, ui16FlagsOffset);
+
+    /* update header checksum field value */
+    WRITE_16BIT(&pui16HdrWordsPtr[UC_IPV4_HDR_CHECKSUM_POS], ui16Checksum);
 }
 
 
@@ -918,7 +2367,7 @@ LOCAL void prepareIPv4Header(uint8 *pui8HdrPtr, st_HeaderParams *stHdrParams, st
     /* re-store header pointer to the beginning of header */
     pui32HdrWordsPtr -= IPV4_HEADER_MIN_LENGTH;
     /* calculate header checksum */
-    ui16HdrChecksum = calcHeaderChecksum((uint8 *)pui32HdrWordsPtr, stHdrParams->ui8HdrLength);
+    ui16HdrChecksum = CHKSUM_getChecksum(CHKSUM_accumulate(UL_NULL, (uint8 *)pui32HdrWordsPtr, stHdrParams->ui8HdrLength));
     /* set header pointer to the checksum word position */
     pui32HdrWordsPtr += UC_IPV4_HDR_WORDS_CHK_POS;
     /* update header checksum field value */
@@ -926,50 +2375,6 @@ LOCAL void prepareIPv4Header(uint8 *pui8HdrPtr, st_HeaderParams *stHdrParams, st
 }
 
 
-/* calculate header checksum */
-LOCAL uint16 calcHeaderChecksum(uint8 *pui8Header, uint8 ui8HdrLength)
-{
-    uint16 *ui16HdrPointer;
-    uint32 ui32Checksum = 0;
-
-    ui16HdrPointer = (uint16 *)pui8Header;
-
-    while(ui8HdrLength > UC_1)
-    {
-        ui32Checksum += (*ui16HdrPointer);
-
-        ui16HdrPointer++;
-
-        /* if high order bit set, fold */
-        if(ui32Checksum & 0x80000000)
-        {
-            ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
-        }
-
-        ui8HdrLength -= 2;
-    }
-
-    /* take care of left over byte */
-    if(ui8HdrLength)
-    {
-        ui32Checksum += (uint16)(*((uint8 *)pui8Header));
-    }
-
-    while(ui32Checksum >> UL_SHIFT_16)
-    {
-        ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
-    }
-
-    /* invert it */
-    ui32Checksum = (~ui32Checksum);
-
-    /* swap bytes order */
-    ui32Checksum = SWAP_BYTES_ORDER_16BIT_((uint16)ui32Checksum);
-
-    return (uint16)ui32Checksum;
-}
-
-
 
 
 /* End of file */
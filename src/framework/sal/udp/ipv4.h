@@ -47,8 +47,94 @@
 /* Minimum length in octects of datagrams to receive */
 #define IPV4_US_ACCEPTED_MIN_LENGTH         ((uint16)576)
 
-/* Maximum data length for each fragment */
-#define IPV4_US_FRAG_MAX_LENGTH             ((uint16)576)
+/* Default MTU in octects of the interface. It can be changed at runtime by IPV4_setMTU function.
+   ATTENTION: it shall not be greater than ETHMAC_US_MAX_MTU */
+#define IPV4_US_DEFAULT_MTU                 (1500)
+
+/* Minimum MTU in octects accepted by IPV4_setMTU function (RFC 791) */
+#define IPV4_US_MIN_MTU                     (68)
+
+/* Maximum payload length of datagrams to send or to re-assemble. ATTENTION: buffers of this length are
+   taken from the buffers pool, so it shall not be greater than BUFPOOL_US_LARGE_BUF_LENGTH */
+#define IPV4_US_MAX_PAYLOAD_LENGTH          (2048)
+
+/* Num of packets of each TX class that can wait for transmission. Each one holds a buffer of the buffers pool */
+#define IPV4_UC_TX_QUEUE_DEPTH              (4)
+
+/* TX classes scheduling policies */
+#define IPV4_TX_SCHED_STRICT_PRIORITY       (0)
+#define IPV4_TX_SCHED_WEIGHTED_RR           (1)
+
+/* TX classes scheduling policy. With strict priority a class is served only when higher priority ones have
+   nothing to send. With weighted round-robin each class first sends up to its weight, then the left budget
+   is given to classes in priority order */
+#define IPV4_TX_SCHEDULING_POLICY           IPV4_TX_SCHED_WEIGHTED_RR
+
+/* Max num of packets sent at each periodic task run. Packets beyond it wait for next run */
+#define IPV4_UC_TX_MAX_PACKETS_PER_RUN      (8)
+
+/* Weighted round-robin weights: num of packets of each TX class sent at each run before the left budget is shared */
+#define IPV4_UC_TX_WRR_WEIGHT_CONTROL       (4)
+#define IPV4_UC_TX_WRR_WEIGHT_BEST_EFFORT   (2)
+#define IPV4_UC_TX_WRR_WEIGHT_BULK          (1)
+
+/* Some DSCP values (RFC 2474, RFC 3246, RFC 4594) */
+#define IPV4_UC_DSCP_DEFAULT                ((uint8)0)      /* best effort */
+#define IPV4_UC_DSCP_CS1                    ((uint8)8)      /* low priority bulk data */
+#define IPV4_UC_DSCP_EF                     ((uint8)46)     /* expedited forwarding */
+#define IPV4_UC_DSCP_CS6                    ((uint8)48)     /* network control */
+#define IPV4_UC_MAX_DSCP_VALUE              ((uint8)63)
+
+/* Num of packets that can wait out of the TX queues for the ETH address of their next hop. They are sent
+   as soon as the ARP reply arrives. ATTENTION: it shall not be greater than 255 */
+#define IPV4_UC_ARP_WAIT_QUEUE_DEPTH        (4)
+
+/* Num of 32-bit words of an IPv4 header template: header without options */
+#define IPV4_UC_HDR_TEMPLATE_WORDS          (5)
+
+/* Max num of multicast groups joined at the same time */
+#define IPV4_UC_MAX_MULTICAST_GROUPS        (4)
+
+/* Max num of received frames processed at each periodic task run or RX poll. If it is reached then the
+   remaining frames are processed by an RX poll scheduled after IPV4_UL_RX_REPOLL_DELAY_MS */
+#define IPV4_UC_RX_FRAMES_BUDGET            (4)
+
+/* Delay in ms of the RX poll scheduled when the RX frames budget has been reached. 0 means next RTOS tick */
+#define IPV4_UL_RX_REPOLL_DELAY_MS          (0)
+
+/* Num of received frames notified by the ETHMAC interrupt that make the RX poll run at once.
+   1 means no coalescing: each frame is processed as soon as the main loop runs */
+#define IPV4_UC_RX_COALESCE_FRAMES          (1)
+
+/* Max time in ms the RX poll is delayed to coalesce notified frames when IPV4_UC_RX_COALESCE_FRAMES is greater than 1 */
+#define IPV4_UL_RX_COALESCE_TIMEOUT_MS      (1)
+
+/* Num of received packets whose ETHMAC payload checksum is checked against the software sum before it is trusted.
+   If a check fails then the ETHMAC payload checksum is not used anymore */
+#define IPV4_UC_HW_CHECKSUM_CHECKS          (4)
+
+/* Num of datagrams that can be re-assembled at the same time. ATTENTION: each one can hold a large buffer
+   of the buffers pool */
+#define IPV4_UC_REASM_MAX_CONTEXTS          (2)
+
+/* Num of buffers of the buffers pool long enough for a datagram under re-assembly that re-assembly leaves free
+   for TX. Large buffers are sized for all the contexts plus these */
+#define IPV4_UC_REASM_TX_RESERVED_BUFS      (1)
+
+/* Num of re-assembled datagrams remembered to discard their late or duplicated fragments. Each one is forgotten
+   after IPV4_UC_REASM_MAX_AGE aging periods or when a newer datagram takes its place */
+#define IPV4_UC_REASM_DONE_KEYS_NUM         (4)
+
+/* Max num of bytes of the buffers pool held by datagrams under re-assembly. Oldest datagrams are discarded
+   to make room for new ones. ATTENTION: it shall not be lower than IPV4_US_MAX_PAYLOAD_LENGTH nor greater than
+   IPV4_UC_REASM_MAX_CONTEXTS times it */
+#define IPV4_US_REASM_MEMORY_BUDGET         (IPV4_UC_REASM_MAX_CONTEXTS * IPV4_US_MAX_PAYLOAD_LENGTH)
+
+/* Period in ms of the aging of datagrams under re-assembly */
+#define IPV4_UL_REASM_AGING_PERIOD_MS       (1000)
+
+/* Num of aging periods a datagram waits for its missing fragments before being discarded */
+#define IPV4_UC_REASM_MAX_AGE               (15)
 
 
 
@@ -71,6 +157,16 @@ typedef enum
    ,IPV4_PROT_CHECK_VALUE
 } IPV4_keSuppProtocols;
 
+/* IPV4 TX classes in priority order. Packets are assigned to a class by the precedence bits of their DSCP:
+   precedence 5 to 7 is control, precedence 1 is bulk and any other is best effort */
+typedef enum
+{
+    IPV4_TX_CLASS_CONTROL
+   ,IPV4_TX_CLASS_BEST_EFFORT
+   ,IPV4_TX_CLASS_BULK
+   ,IPV4_TX_CLASS_MAX_NUM
+} IPV4_keTXClass;
+
 
 
 
@@ -96,6 +192,15 @@ typedef struct
 } st_HeaderOptions;
 
 
+/* IPv4 header template: header words without options in network bytes order and with a valid checksum.
+   Prepared once for the constant fields, then total length, identifier, flags and fragment offset are
+   patched for each packet with incremental checksum updates */
+typedef struct
+{
+    uint32 aui32HdrWords[IPV4_UC_HDR_TEMPLATE_WORDS];
+} IPV4_st_HeaderTemplate;
+
+
 /* IPv4 packet descriptor */
 typedef struct
 {
@@ -105,23 +210,57 @@ typedef struct
     uint64 ui64DstEthAdd;
     IPV4_keSuppProtocols enProtocol;
     boolean bDoNotFragment;
+    uint8 ui8Dscp;                                  /* DSCP field value: it selects the TX class too */
     st_HeaderOptions stOptions;
+    const IPV4_st_HeaderTemplate *pstHdrTemplate;   /* template of the same addresses, protocol and DSCP. NULL if not available */
 } IPv4_st_PacketDescriptor;
 
 
+/* RX destination filter statistics */
+typedef struct
+{
+    uint32 ui32UnicastRejectCnt;        /* num of packets discarded because addressed to another host */
+    uint32 ui32BroadcastRejectCnt;      /* num of packets discarded because addressed to another subnet broadcast */
+    uint32 ui32MulticastRejectCnt;      /* num of packets discarded because addressed to a not joined multicast group */
+    uint32 ui32MalformedCnt;            /* num of packets discarded because their header lengths do not fit in the received frame */
+    uint32 ui32LateFragmentCnt;         /* num of fragments discarded because their datagram has been already re-assembled */
+} IPV4_st_RXFilterStats;
+
+
+/* RX polling statistics */
+typedef struct
+{
+    uint32 ui32PollsCnt;                /* num of periodic task runs and RX polls */
+    uint32 ui32FramesCnt;               /* num of processed frames */
+    uint32 ui32BudgetExhaustedCnt;      /* num of polls stopped by the RX frames budget with frames still waiting */
+} IPV4_st_RXPollStats;
+
+
 
 
 /* ----------------- Exported functions declaration --------------- */
 
 EXTERN uint32           IPV4_getObtainedIPAdd   (void);
 EXTERN void             IPV4_setLocalIPAddress  (uint32);
+EXTERN boolean          IPV4_addHotPeer         (uint32);
 EXTERN boolean          IPV4_checkLocalIPAdd    (uint32);
 EXTERN void             IPV4_setRouterInfo      (uint32, uint32);
 EXTERN boolean          IPV4_Init               (void);
 EXTERN void             IPV4_Deinit             (void);
 EXTERN void             IPV4_PeriodicTask       (void);
-EXTERN uint8 *          IPV4_getDataBuffPtr     (void);
+EXTERN uint8 *          IPV4_getDataBuffPtr     (uint16, uint8);
+EXTERN boolean          IPV4_lendRXDataBuffer   (uint8 *);
+EXTERN void             IPV4_releaseRXDataBuffer(uint8 *);
 EXTERN IPV4_keOpResult  IPV4_SendPacket         (IPv4_st_PacketDescriptor);
+EXTERN void             IPV4_prepareHeaderTemplate(IPV4_st_HeaderTemplate *, uint32, uint32, IPV4_keSuppProtocols, uint8);
+EXTERN uint32           IPV4_getTXDropCount     (void);
+EXTERN uint8            IPV4_getTXQueueLevel    (IPV4_keTXClass);
+EXTERN IPV4_keOpResult  IPV4_setMTU             (uint16);
+EXTERN uint16           IPV4_getMTU             (void);
+EXTERN IPV4_keOpResult  IPV4_joinMulticastGroup (uint32);
+EXTERN void             IPV4_leaveMulticastGroup(uint32);
+EXTERN void             IPV4_getRXFilterStats   (IPV4_st_RXFilterStats *);
+EXTERN void             IPV4_getRXPollStats     (IPV4_st_RXPollStats *);
 
 
 
@@ -0,0 +1,256 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file route.c represents the routing table of the UDP/IP stack.
+ * Routes are kept sorted from the longest to the shortest prefix, so the
+ * first matching route is the longest prefix match and a lookup checks at
+ * most ROUTE_UC_MAX_NUM_OF_ROUTES routes.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "../../fw_common.h"
+#include "route.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* Limited broadcast IP address */
+#define UL_LIMITED_BROADCAST_IP_ADD     ((uint32)0xFFFFFFFF)
+
+/* value check */
+#if ROUTE_UC_MAX_NUM_OF_ROUTES < 1
+#error ROUTE_UC_MAX_NUM_OF_ROUTES define is lower than 1
+#endif
+
+
+
+
+/* --------------- Local macros definitions ------------------ */
+
+/* check if a subnet mask is not made of contiguous ones followed by contiguous zeros */
+#define IS_NOT_CONTIGUOUS_MASK(x)       (((((~(x)) & 0xFFFFFFFF) + 1) & (~(x)) & 0xFFFFFFFF) != 0)
+
+
+
+
+/* --------------- Local types definitions ----------------- */
+
+/* route structure */
+typedef struct
+{
+    uint32 ui32Prefix;      /* network address: destinations masked by the subnet mask */
+    uint32 ui32Mask;        /* subnet mask. Longer prefixes have greater mask values */
+    uint32 ui32Gateway;     /* next hop IP address. ROUTE_UL_ON_LINK for on-link prefixes */
+} st_Route;
+
+
+
+
+/* --------------- Local variables declaration ----------------- */
+
+/* routing table sorted by decreasing mask value: entries from 0 to ui8NumOfRoutes - 1 are valid */
+LOCAL st_Route astRouteTable[ROUTE_UC_MAX_NUM_OF_ROUTES];
+
+/* num of valid routes */
+LOCAL uint8 ui8NumOfRoutes = UC_NULL;
+
+
+
+
+/* --------------- Local functions prototypes ----------------- */
+
+LOCAL uint8     findRoute           (uint32, uint32);
+
+
+
+
+/* --------------- Exported functions declaration -------------- */
+
+/* Init routing table: no routes */
+EXPORTED void ROUTE_Init( void )
+{
+    ui8NumOfRoutes = UC_NULL;
+}
+
+
+/* Add a route to a prefix through a gateway or on-link (ROUTE_UL_ON_LINK). The gateway of an existing route
+   to the same prefix is replaced. Return ROUTE_OP_FAIL if the mask is not contiguous or the table is full */
+EXPORTED ROUTE_keOpResult ROUTE_addRoute( uint32 ui32Prefix, uint32 ui32Mask, uint32 ui32Gateway )
+{
+    ROUTE_keOpResult unOpResult;
+    uint8 ui8RouteIdx;
+
+    /* consider only network bits of the prefix */
+    ui32Prefix &= ui32Mask;
+
+    ui8RouteIdx = findRoute(ui32Prefix, ui32Mask);
+
+    if(IS_NOT_CONTIGUOUS_MASK(ui32Mask))
+    {
+        /* fail - invalid mask */
+        unOpResult = ROUTE_OP_FAIL;
+    }
+    else if(ui8RouteIdx < ui8NumOfRoutes)
+    {
+        /* route already present: update gateway */
+        astRouteTable[ui8RouteIdx].ui32Gateway = ui32Gateway;
+
+        unOpResult = ROUTE_OP_OK;
+    }
+    else if(ui8NumOfRoutes < ROUTE_UC_MAX_NUM_OF_ROUTES)
+    {
+        /* move shorter prefixes down to keep the table sorted */
+        ui8RouteIdx = ui8NumOfRoutes;
+        while((ui8RouteIdx > UC_NULL)
+        &&    (astRouteTable[(ui8RouteIdx - UC_1)].ui32Mask < ui32Mask))
+        {
+            astRouteTable[ui8RouteIdx] = astRouteTable[(ui8RouteIdx - UC_1)];
+            ui8RouteIdx--;
+        }
+
+        /* insert new route */
+        astRouteTable[ui8RouteIdx].ui32Prefix = ui32Prefix;
+        astRouteTable[ui8RouteIdx].ui32Mask = ui32Mask;
+        astRouteTable[ui8RouteIdx].ui32Gateway = ui32Gateway;
+        ui8NumOfRoutes++;
+
+        unOpResult = ROUTE_OP_OK;
+    }
+    else
+    {
+        /* fail - table is full */
+        unOpResult = ROUTE_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* Remove the route to a prefix. Return ROUTE_OP_FAIL if not present */
+EXPORTED ROUTE_keOpResult ROUTE_removeRoute( uint32 ui32Prefix, uint32 ui32Mask )
+{
+    ROUTE_keOpResult unOpResult;
+    uint8 ui8RouteIdx;
+
+    ui8RouteIdx = findRoute((ui32Prefix & ui32Mask), ui32Mask);
+
+    if(ui8RouteIdx < ui8NumOfRoutes)
+    {
+        /* move next routes up to keep the table sorted */
+        ui8NumOfRoutes--;
+        while(ui8RouteIdx < ui8NumOfRoutes)
+        {
+            astRouteTable[ui8RouteIdx] = astRouteTable[(ui8RouteIdx + UC_1)];
+            ui8RouteIdx++;
+        }
+
+        unOpResult = ROUTE_OP_OK;
+    }
+    else
+    {
+        /* fail - route not present */
+        unOpResult = ROUTE_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* Get the next hop IP address of a destination from the longest prefix match. Destinations reached on-link,
+   the limited broadcast address and destinations without a matching route are returned as they are */
+EXPORTED uint32 ROUTE_getNextHop( uint32 ui32DstIPAdd )
+{
+    uint32 ui32NextHop = ui32DstIPAdd;
+    uint8 ui8RouteIdx = UC_NULL;
+
+    if(ui32DstIPAdd != UL_LIMITED_BROADCAST_IP_ADD)
+    {
+        /* first matching route has the longest prefix */
+        while((ui8RouteIdx < ui8NumOfRoutes)
+        &&    ((ui32DstIPAdd & astRouteTable[ui8RouteIdx].ui32Mask) != astRouteTable[ui8RouteIdx].ui32Prefix))
+        {
+            ui8RouteIdx++;
+        }
+
+        /* if found and not on-link */
+        if((ui8RouteIdx < ui8NumOfRoutes)
+        && (astRouteTable[ui8RouteIdx].ui32Gateway != ROUTE_UL_ON_LINK))
+        {
+            ui32NextHop = astRouteTable[ui8RouteIdx].ui32Gateway;
+        }
+        else
+        {
+            /* destination is reached directly */
+        }
+    }
+    else
+    {
+        /* limited broadcast is never forwarded */
+    }
+
+    return ui32NextHop;
+}
+
+
+/* Get the num of routes in the routing table */
+EXPORTED uint8 ROUTE_getNumOfRoutes( void )
+{
+    return ui8NumOfRoutes;
+}
+
+
+
+
+/* ----------------- Local functions declaration ----------------- */
+
+/* get the index of the route to a prefix. Return ui8NumOfRoutes if not present */
+LOCAL uint8 findRoute( uint32 ui32Prefix, uint32 ui32Mask )
+{
+    uint8 ui8RouteIdx = UC_NULL;
+
+    while((ui8RouteIdx < ui8NumOfRoutes)
+    &&    ((astRouteTable[ui8RouteIdx].ui32Prefix != ui32Prefix)
+    ||     (astRouteTable[ui8RouteIdx].ui32Mask != ui32Mask)))
+    {
+        ui8RouteIdx++;
+    }
+
+    return ui8RouteIdx;
+}
+
+
+
+
+/* End of file */
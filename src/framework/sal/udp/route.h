@@ -0,0 +1,75 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file route.h represents the routing table inclusion file of the UDP/IP stack.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+/* ------------ Inclusion files --------------- */
+#include "../../fw_common.h"
+
+
+
+
+/* --------------- Exported defines ----------------- */
+
+/* Max num of routes. A lookup checks at most this num of routes */
+#define ROUTE_UC_MAX_NUM_OF_ROUTES          (8)
+
+/* Gateway value of on-link routes: destinations are reached directly */
+#define ROUTE_UL_ON_LINK                    ((uint32)0)
+
+
+
+
+/* --------------- Exported enums definitions ---------------- */
+
+/* routing table operations result enum */
+typedef enum
+{
+    ROUTE_OP_OK
+   ,ROUTE_OP_FAIL
+} ROUTE_keOpResult;
+
+
+
+
+/* -------------- Exported functions prototypes -------------- */
+
+EXTERN void             ROUTE_Init              (void);
+EXTERN ROUTE_keOpResult ROUTE_addRoute          (uint32, uint32, uint32);
+EXTERN ROUTE_keOpResult ROUTE_removeRoute       (uint32, uint32);
+EXTERN uint32           ROUTE_getNextHop        (uint32);
+EXTERN uint8            ROUTE_getNumOfRoutes    (void);
+
+
+
+
+/* End of file */
@@ -36,12 +36,7 @@
 TODO LIST:
     1)  implement data buffer point validity check in UDP_SendDataBuffer() function
     2)  implement some parameters checks in UDP_OpenUDPSocket() function
-    3)  prepare TX packet and request transmission in a periodic task. See st_UDPSocketInfo structure.
-        This is done in UDP_SendDataBuffer() API function at the moment.
-        So, in the event of TX data buffer pointer not valid the request is discarded at the moment.
-        See UDP_SendDataBuffer() API function.
-    4)  implement header checksum validity check in UDP_unpackMessage() function
-    5)  do not close sockets in case of pending RX or TX data. See UDP_CloseUDPSocket() function
+    3)  do not close sockets in case of pending RX or TX data. See UDP_CloseUDPSocket() function
 */
 
 
@@ -53,6 +48,8 @@ TODO LIST:
 
 #include "../../hal/ethmac.h"
 #include "ipv4.h"
+#include "chksum.h"
+#include "bufpool.h"
 
 
 
@@ -62,6 +59,43 @@ TODO LIST:
 #define UDP_HEADER_LENGTH               (2)
 #define UDP_HEADER_BYTE_LENGTH          (UC_4 * UDP_HEADER_LENGTH)
 
+/* Hash table empty bucket or end of bucket list. Sockets are stored as socket index plus 1 */
+#define US_HASH_END_OF_LIST             ((uint16)0)
+
+/* Received checksum field value of datagrams sent without checksum */
+#define US_NO_CHECKSUM                  ((uint16)0)
+
+/* Remote IP address of sockets accepting datagrams from any sender */
+#define UL_ANY_REMOTE_IP_ADD            ((uint32)0xFFFFFFFF)
+
+/* Remote port of listening sockets: port 0 is reserved so it is never a valid sender port */
+#define US_ANY_REMOTE_PORT              ((uint16)0)
+
+/* value check */
+#if (UDP_US_SOCKET_HASH_TABLE_SIZE & (UDP_US_SOCKET_HASH_TABLE_SIZE - 1)) != 0
+#error UDP_US_SOCKET_HASH_TABLE_SIZE define is not a power of 2
+#endif
+
+/* value check */
+#if UDP_UC_RX_QUEUE_DEPTH < 1
+#error UDP_UC_RX_QUEUE_DEPTH define is lower than 1
+#endif
+
+/* value check */
+#if UDP_UC_TX_QUEUE_DEPTH < 1
+#error UDP_UC_TX_QUEUE_DEPTH define is lower than 1
+#endif
+
+/* value check */
+#if UDP_MAX_DATA_LENGTH_ALLOWED > (IPV4_US_MAX_PAYLOAD_LENGTH - 8)
+#error UDP_MAX_DATA_LENGTH_ALLOWED define is greater than the IPv4 payload length
+#endif
+
+/* value check */
+#if UDP_US_MAX_NUM_OF_SOCKETS < 8
+#error UDP_US_MAX_NUM_OF_SOCKETS define is lower than the number of named sockets
+#endif
+
 
 
 
@@ -84,14 +118,33 @@ TODO LIST:
 #define GET_HDR_DST_PORT(x)         ((((x) >> HDR_DST_PORT_POS) & 0xFFFF))
 #define GET_HDR_LENGTH(x)           ((((x) >> HDR_LENGTH_POS) & 0xFFFF))
 #define GET_HDR_CHECKSUM(x)         ((((x) >> HDR_CHECKSUM_POS) & 0xFFFF))
-/* update checksum field. TODO: optimize this operation */
-#define UPDATE_HDR_CHECKSUM(x,y)    ((*(x)) = SWAP_BYTES_ORDER_32BIT_(SWAP_BYTES_ORDER_32BIT_(*(x)) | (((y) & 0xFFFF) << HDR_CHECKSUM_POS)))
+
+/* get hash table bucket of a socket from remote IP address, local port and remote port */
+#define GET_SOCKET_HASH(x,y,z)      (getSocketHash((x), (y), (z)))
 
 
 
 
 /* --------------- Local types definitions ----------------- */
 
+/* RX queue slot structure */
+typedef struct
+{
+    uint8 *pui8DataPtr;
+    uint16 ui16DataLength;
+    uint32 ui32SrcIPAdd;        /* sender IP address */
+    uint16 ui16SrcPort;         /* sender port */
+} st_RXQueueSlot;
+
+/* TX queue slot structure */
+typedef struct
+{
+    uint8 *pui8DataPtr;         /* pool buffer taken at enqueue, given back once the datagram is passed to IPv4 layer */
+    uint16 ui16DataLength;
+    uint32 ui32DstIPAdd;        /* destination IP address */
+    uint16 ui16DstPort;         /* destination port */
+} st_TXQueueSlot;
+
 /* UDP connections info structure */
 typedef struct
 {
@@ -100,12 +153,20 @@ typedef struct
     uint32 ui32IPDstAddress;
     uint16 ui16UDPSrcPort;
     uint16 ui16UDPDstPort;
-    uint8 *pui8RXDataBufPtr;
-    uint16 ui16RXDataLength;
-    uint8 *pui8TXDataBufPtr;    /* not used at the moment. For future transmission in a periodic task */
-    uint16 ui16TXDataLength;    /* not used at the moment. For future transmission in a periodic task */
-    boolean bNewRXAvailData;
-    boolean bNewTXAvailData;    /* not used at the moment. For future transmission in a periodic task */
+    uint8 ui8Dscp;              /* DSCP of sent datagrams: it selects their IPv4 TX class */
+    st_RXQueueSlot astRXQueue[UDP_UC_RX_QUEUE_DEPTH];   /* slots point into RX buffers lent by lower layers */
+    uint8 ui8RXQueueHead;       /* oldest queued datagram */
+    uint8 ui8RXQueueLevel;      /* num of queued datagrams */
+    boolean bRXSlotPending;     /* head slot is in use by the application: release it at next dequeue */
+    UDP_st_SocketStats stStats;
+    UDP_pfRXCallback pfRXCallback;  /* if set, datagrams are passed to it at reception instead of being queued */
+    st_TXQueueSlot astTXQueue[UDP_UC_TX_QUEUE_DEPTH];   /* datagrams waiting for the IPv4 TX buffer */
+    uint8 ui8TXQueueHead;       /* oldest datagram to transmit */
+    uint8 ui8TXQueueLevel;      /* num of datagrams to transmit */
+    uint16 ui16NextHashIdx;     /* next socket in the same hash table bucket (index plus 1) */
+    uint32 ui32HdrPortsWord;    /* UDP header ports word of the connected destination in network bytes order */
+    uint32 ui32HdrTemplateSum;  /* checksum partial sum of pseudo header addresses and protocol and of UDP ports */
+    IPV4_st_HeaderTemplate stIPv4HdrTemplate;   /* IPv4 header template of the connected destination */
 } st_UDPSocketInfo;
 
 
@@ -116,45 +177,175 @@ typedef struct
 /* Array to store connections info */
 LOCAL st_UDPSocketInfo stUDPSocketInfo[UDP_SOCKET_MAX_NUM];
 
+/* Sockets demultiplexing hash table. Each bucket stores the first socket of the list (index plus 1) */
+LOCAL uint16 aui16SocketHashTable[UDP_US_SOCKET_HASH_TABLE_SIZE];
+
+/* Next socket to serve when draining TX queues (round-robin) */
+LOCAL uint16 ui16TXNextSocketIdx = US_NULL;
+
+/* num of received datagrams discarded because of a wrong checksum */
+LOCAL uint32 ui32RXChecksumErrCnt = UL_NULL;
+
 
 
 
 /* --------------- Local functions prototypes ----------------- */
 
-LOCAL uint8     getSocketIndex      (uint32, uint32, uint16, uint16);
-LOCAL uint16    calculateChecksum   (IPv4_st_PacketDescriptor *, uint16 *);
+LOCAL uint16    getSocketIndex      (uint32, uint32, uint16, uint16);
+LOCAL uint16    searchSocketBucket  (uint32, uint32, uint16, uint16);
+LOCAL uint16    getSocketHash       (uint32, uint16, uint16);
+LOCAL void      addSocketToHash     (uint16);
+LOCAL void      removeSocketFromHash(uint16);
+LOCAL void      releaseRXQueueHead  (st_UDPSocketInfo *);
+LOCAL void      releaseTXQueueHead  (st_UDPSocketInfo *);
+LOCAL UDP_keOpResult openSocket     (UDP_keSocketNum, uint32, uint32, uint16, uint16);
+LOCAL UDP_keOpResult sendVector     (UDP_keSocketNum, uint32, uint16, const UDP_st_DataSegment *, uint8);
+LOCAL UDP_keOpResult sendDatagram   (st_UDPSocketInfo *, uint32, uint16, const UDP_st_DataSegment *, uint8, uint16);
+LOCAL uint32    getSegmentsLength   (const UDP_st_DataSegment *, uint8);
+LOCAL uint32    gatherSegments      (uint8 *, const UDP_st_DataSegment *, uint8);
+LOCAL void      prepareHeaderTemplates(st_UDPSocketInfo *);
+LOCAL uint32    getHeaderTemplateSum(uint32, uint32, uint16, uint16);
+LOCAL uint16    calculateChecksum   (uint32, uint16);
+LOCAL uint32    addPseudoHeaderSum  (uint32, uint32, uint32, uint16);
+LOCAL boolean   isChecksumValid     (uint32, uint32, uint8 *, uint16, const uint32 *);
 
 
 
 
 /* --------------- Exported functions declaration -------------- */
 
-/* unpack an eventual received data buffer */
-EXPORTED void UDP_checkReceivedData(UDP_keSocketNum unSocketNum, uint8 **pui8DataPtr, uint16 *pui16DataLength )
+/* get the oldest received datagram of a socket. The returned pointer refers to the lower layers RX buffer
+   and it remains valid until the next call or an UDP_releaseRXData call for the same socket */
+EXPORTED UDP_keOpResult UDP_getNextRXData(UDP_keSocketNum unSocketNum, uint8 **pui8DataPtr, uint16 *pui16DataLength )
+{
+    uint32 ui32SrcIPAdd;
+    uint16 ui16SrcPort;
+
+    return UDP_ReceiveFrom(unSocketNum, pui8DataPtr, pui16DataLength, &ui32SrcIPAdd, &ui16SrcPort);
+}
+
+
+/* get the oldest received datagram of a socket together with its sender IP address and port.
+   The returned pointer remains valid as for UDP_getNextRXData */
+EXPORTED UDP_keOpResult UDP_ReceiveFrom(UDP_keSocketNum unSocketNum, uint8 **pui8DataPtr, uint16 *pui16DataLength, uint32 *pui32SrcIPAdd, uint16 *pui16SrcPort )
 {
-    /* if new data are available */
-    if(B_TRUE == stUDPSocketInfo[unSocketNum].bNewRXAvailData)
+    UDP_keOpResult unOpResult;
+    st_UDPSocketInfo *pstSocket;
+
+    /* check required socket number and if the socket is open */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE))
     {
-        /* copy buffer pointer */
-        *pui8DataPtr = stUDPSocketInfo[unSocketNum].pui8RXDataBufPtr;
-        /* copy data length */
-        *pui16DataLength = stUDPSocketInfo[unSocketNum].ui16RXDataLength;
+        pstSocket = &stUDPSocketInfo[unSocketNum];
 
-        /* reset flag. ATTENTION: should be an atomic operation */
-        stUDPSocketInfo[unSocketNum].bNewRXAvailData = B_FALSE;
+        /* if the previous datagram is still held then release it now */
+        if(B_TRUE == pstSocket->bRXSlotPending)
+        {
+            releaseRXQueueHead(pstSocket);
+        }
+        else
+        {
+            /* no slot to release */
+        }
+
+        /* if new data are available */
+        if(pstSocket->ui8RXQueueLevel > UC_NULL)
+        {
+            /* copy buffer pointer */
+            *pui8DataPtr = pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].pui8DataPtr;
+            /* copy data length */
+            *pui16DataLength = pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].ui16DataLength;
+            /* copy sender address and port */
+            *pui32SrcIPAdd = pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].ui32SrcIPAdd;
+            *pui16SrcPort = pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].ui16SrcPort;
+
+            /* head slot is held until the next call */
+            pstSocket->bRXSlotPending = B_TRUE;
+
+            /* success */
+            unOpResult = UDP_OP_OK;
+        }
+        else
+        {
+            /* queue is empty */
+            unOpResult = UDP_OP_FAIL;
+        }
     }
     else
+    {
+        /* fail - invalid socket number or socket is not open */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    /* in case of fail */
+    if(UDP_OP_OK != unOpResult)
     {
         /* set a NULL pointer */
         *pui8DataPtr = NULL_PTR;
         /* set data length at 0 */
         *pui16DataLength = US_NULL;
+        /* no sender */
+        *pui32SrcIPAdd = UL_NULL;
+        *pui16SrcPort = US_NULL;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
+    return unOpResult;
+}
+
+
+/* release the datagram previously returned by UDP_getNextRXData. Its RX buffer is given back to lower layers */
+EXPORTED void UDP_releaseRXData(UDP_keSocketNum unSocketNum)
+{
+    /* check required socket number, if the socket is open and if a datagram is held */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE)
+    && (stUDPSocketInfo[unSocketNum].bRXSlotPending == B_TRUE))
+    {
+        releaseRXQueueHead(&stUDPSocketInfo[unSocketNum]);
+    }
+    else
+    {
+        /* do nothing */
     }
 }
 
 
+/* get statistics of an open socket */
+EXPORTED UDP_keOpResult UDP_getSocketStats(UDP_keSocketNum unSocketNum, UDP_st_SocketStats *pstStats )
+{
+    UDP_keOpResult unOpResult;
+
+    /* check required socket number and if the socket is open */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE))
+    {
+        /* copy statistics */
+        *pstStats = stUDPSocketInfo[unSocketNum].stStats;
+        /* update current RX and TX queues level */
+        pstStats->ui8RXQueueLevel = stUDPSocketInfo[unSocketNum].ui8RXQueueLevel;
+        pstStats->ui8TXQueueLevel = stUDPSocketInfo[unSocketNum].ui8TXQueueLevel;
+
+        /* success */
+        unOpResult = UDP_OP_OK;
+    }
+    else
+    {
+        /* fail - invalid socket number or socket is not open */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
 /* request to unpack a data buffer */
-EXPORTED void UDP_unpackMessage( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8 *ui8MessagePtr )
+/* unpack a received UDP message. ui16MsgLength is the IPv4 payload length.
+   pui32MsgSum points to the checksum partial sum of the whole message if already calculated by lower layers, NULL_PTR otherwise */
+EXPORTED void UDP_unpackMessage( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8 *ui8MessagePtr, uint16 ui16MsgLength, const uint32 *pui32MsgSum )
 {
     uint32 *pui32HeaderPtr;
     uint32 ui32HdrWord;
@@ -162,7 +353,10 @@ EXPORTED void UDP_unpackMessage( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8
     uint16 ui16Length;
     uint16 ui16SourcePort;
     uint16 ui16DestPort;
-    uint8 ui8SocketIndex;
+    uint16 ui16SocketIndex;
+    st_UDPSocketInfo *pstSocket;
+    st_RXQueueSlot *pstSlot;
+    uint8 *pui8DataPtr = NULL_PTR;
 
     /* get buffer pointer */
     pui32HeaderPtr = (uint32 *)ui8MessagePtr;
@@ -176,33 +370,94 @@ EXPORTED void UDP_unpackMessage( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8
     ui16Length = GET_HDR_LENGTH(ui32HdrWord);
     /* get checksum */
     ui16Checksum = GET_HDR_CHECKSUM(ui32HdrWord);
-    /* checksum validity check */
-    //...
 
     /* get socket id from src and dst addresses and ports */
-    ui8SocketIndex = getSocketIndex(ui32SrcIPAdd, ui32DstIPAdd, ui16SourcePort, ui16DestPort);
-    if(ui8SocketIndex < UDP_SOCKET_MAX_NUM)
+    ui16SocketIndex = getSocketIndex(ui32SrcIPAdd, ui32DstIPAdd, ui16SourcePort, ui16DestPort);
+
+    /* check length */
+    if((ui16Length < UDP_HEADER_BYTE_LENGTH)
+    || (ui16Length > ui16MsgLength))
+    {
+        /* malformed datagram: discard data */
+    }
+    /* checksum validity check */
+    else if((US_NO_CHECKSUM != ui16Checksum)
+         && (B_TRUE != isChecksumValid(ui32SrcIPAdd, ui32DstIPAdd, ui8MessagePtr, ui16Length,
+                                       ((ui16Length == ui16MsgLength) ? pui32MsgSum : NULL_PTR))))
+    {
+        /* checksum is wrong: discard data */
+        ui32RXChecksumErrCnt++;
+    }
+    else if(ui16SocketIndex < UDP_SOCKET_MAX_NUM)
     {
         /* calculate data length: remove header length from total length */
         ui16Length -= UDP_HEADER_BYTE_LENGTH;
 
+        pstSocket = &stUDPSocketInfo[ui16SocketIndex];
+
         /* check length */
-        if(ui16Length <= UDP_MAX_DATA_LENGTH_ALLOWED)
+        if(ui16Length > UDP_MAX_DATA_LENGTH_ALLOWED)
+        {
+            /* length is more than maximum available: discard data */
+            pstSocket->stStats.ui32RXTooLongCnt++;
+        }
+        /* if a receive callback is registered then call it: no queueing */
+        else if(pstSocket->pfRXCallback != NULL_PTR)
         {
-            /* store data length */
-            stUDPSocketInfo[ui8SocketIndex].ui16RXDataLength = ui16Length;
+            pstSocket->stStats.ui32RXDatagramsCnt++;
 
-            /* copy received data */
-            MEM_COPY(stUDPSocketInfo[ui8SocketIndex].pui8RXDataBufPtr,
-                     pui32HeaderPtr,
-                     ui16Length);
+            pstSocket->pfRXCallback((UDP_keSocketNum)ui16SocketIndex, ui32SrcIPAdd, ui16SourcePort, (uint8 *)pui32HeaderPtr, ui16Length);
+        }
+        /* check RX queue space */
+        else if(pstSocket->ui8RXQueueLevel >= UDP_UC_RX_QUEUE_DEPTH)
+        {
+            /* RX queue is full: discard data */
+            pstSocket->stStats.ui32RXOverflowCnt++;
+        }
+        else
+        {
+            /* keep the lower layers RX buffer: no data copy */
+            if(B_TRUE == IPV4_lendRXDataBuffer((uint8 *)pui32HeaderPtr))
+            {
+                pui8DataPtr = (uint8 *)pui32HeaderPtr;
+            }
+            else
+            {
+                /* RX buffer cannot be lent: copy data into a pool buffer so lower layers can reuse it */
+                pui8DataPtr = BUFPOOL_alloc(ui16Length);
+                if(pui8DataPtr != NULL_PTR)
+                {
+                    MEM_COPY(pui8DataPtr, (uint8 *)pui32HeaderPtr, ui16Length);
+                    pstSocket->stStats.ui32RXCopiedCnt++;
+                }
+                else
+                {
+                    /* no memory: discard data */
+                    pstSocket->stStats.ui32RXNoBufferCnt++;
+                }
+            }
+        }
 
-            /* set flag. ATTENTION: should be an atomic operation */
-            stUDPSocketInfo[ui8SocketIndex].bNewRXAvailData = B_TRUE;
+        /* if data have been stored then queue them */
+        if(pui8DataPtr != NULL_PTR)
+        {
+            /* get the first free slot */
+            pstSlot = &pstSocket->astRXQueue[((pstSocket->ui8RXQueueHead + pstSocket->ui8RXQueueLevel) % UDP_UC_RX_QUEUE_DEPTH)];
+
+            /* store data pointer and length */
+            pstSlot->pui8DataPtr = pui8DataPtr;
+            pstSlot->ui16DataLength = ui16Length;
+            /* store sender address and port */
+            pstSlot->ui32SrcIPAdd = ui32SrcIPAdd;
+            pstSlot->ui16SrcPort = ui16SourcePort;
+
+            /* datagram queued */
+            pstSocket->ui8RXQueueLevel++;
+            pstSocket->stStats.ui32RXDatagramsCnt++;
         }
         else
         {
-            /* length is more than maximum available: discard data at the moment */
+            /* datagram passed to the callback or discarded */
         }
     }
     else
@@ -214,240 +469,849 @@ EXPORTED void UDP_unpackMessage( uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8
 }
 
 
-/* open an UDP socket */
+/* set the receive callback of an open socket. It is called from the IPv4 periodic task as soon as a datagram
+   for the socket is received. Already queued datagrams remain available through UDP_getNextRXData.
+   Set a NULL_PTR callback to go back to the RX queue */
+EXPORTED UDP_keOpResult UDP_setRXCallback(UDP_keSocketNum unSocketNum, UDP_pfRXCallback pfCallback )
+{
+    UDP_keOpResult unOpResult;
+
+    /* check required socket number and if the socket is open */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE))
+    {
+        stUDPSocketInfo[unSocketNum].pfRXCallback = pfCallback;
+
+        /* success */
+        unOpResult = UDP_OP_OK;
+    }
+    else
+    {
+        /* fail - invalid socket number or socket is not open */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* set the DSCP of datagrams sent by an open socket. It selects their IPv4 TX class too */
+EXPORTED UDP_keOpResult UDP_setSocketDscp(UDP_keSocketNum unSocketNum, uint8 ui8Dscp )
+{
+    UDP_keOpResult unOpResult;
+
+    /* check required socket number, if the socket is open and DSCP value (6 bits) */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE)
+    && (ui8Dscp <= IPV4_UC_MAX_DSCP_VALUE))
+    {
+        stUDPSocketInfo[unSocketNum].ui8Dscp = ui8Dscp;
+
+        /* IPv4 header template carries the DSCP */
+        prepareHeaderTemplates(&stUDPSocketInfo[unSocketNum]);
+
+        /* success */
+        unOpResult = UDP_OP_OK;
+    }
+    else
+    {
+        /* fail - invalid socket number, socket is not open or invalid DSCP */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* get the num of received datagrams discarded because of a wrong checksum */
+EXPORTED uint32 UDP_getRXChecksumErrors( void )
+{
+    return ui32RXChecksumErrCnt;
+}
+
+
+/* open an UDP socket connected to a remote IP address and port */
 EXPORTED UDP_keOpResult UDP_OpenUDPSocket(UDP_keSocketNum unSocketNum, uint32 ui32IPSrcAddress, uint32 ui32IPDstAddress, uint16 ui16SrcPort, uint16 ui16DstPort )
 {
     UDP_keOpResult unOpResult;
 
+    /* port 0 is reserved for listening sockets */
+    if(US_ANY_REMOTE_PORT != ui16DstPort)
+    {
+        unOpResult = openSocket(unSocketNum, ui32IPSrcAddress, ui32IPDstAddress, ui16SrcPort, ui16DstPort);
+    }
+    else
+    {
+        /* fail - invalid remote port */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* open an UDP socket bound to a local port only. It receives datagrams from any sender not served by
+   a connected socket: use UDP_ReceiveFrom to get the sender and UDP_SendTo to reply */
+EXPORTED UDP_keOpResult UDP_OpenListenSocket(UDP_keSocketNum unSocketNum, uint32 ui32IPSrcAddress, uint16 ui16SrcPort )
+{
+    return openSocket(unSocketNum, ui32IPSrcAddress, UL_ANY_REMOTE_IP_ADD, ui16SrcPort, US_ANY_REMOTE_PORT);
+}
+
+
+/* request to send a data buffer through an already open UDP socket */
+EXPORTED UDP_keOpResult UDP_SendDataBuffer(UDP_keSocketNum unSocketNum, uint8 *pui8BuffPtr, uint16 ui16BuffLength )
+{
+    UDP_st_DataSegment stSegment;
+
+    /* a single data segment */
+    stSegment.pui8DataPtr = pui8BuffPtr;
+    stSegment.ui16DataLength = ui16BuffLength;
+
+    return UDP_SendDataVector(unSocketNum, &stSegment, UC_1);
+}
+
+
+/* request to send a list of data segments as a single datagram through an already open UDP socket.
+   Segments are gathered straight into the IPv4 TX buffer. If it is busy then data are queued and
+   sent later by UDP_sendNextQueuedData */
+EXPORTED UDP_keOpResult UDP_SendDataVector(UDP_keSocketNum unSocketNum, const UDP_st_DataSegment *pstSegments, uint8 ui8NumOfSegments )
+{
+    UDP_keOpResult unOpResult;
+
+    /* check required socket number and if the socket is connected to a remote port */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].ui16UDPDstPort != US_ANY_REMOTE_PORT))
+    {
+        unOpResult = sendVector(unSocketNum,
+                                stUDPSocketInfo[unSocketNum].ui32IPDstAddress,
+                                stUDPSocketInfo[unSocketNum].ui16UDPDstPort,
+                                pstSegments,
+                                ui8NumOfSegments);
+    }
+    else
+    {
+        /* fail - invalid socket number or listening socket */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* request to send a data buffer to a remote IP address and port through an already open UDP socket.
+   Any socket can be used, listening ones included: the local port is the socket one */
+EXPORTED UDP_keOpResult UDP_SendTo(UDP_keSocketNum unSocketNum, uint32 ui32DstIPAdd, uint16 ui16DstPort, uint8 *pui8BuffPtr, uint16 ui16BuffLength )
+{
+    UDP_keOpResult unOpResult;
+    UDP_st_DataSegment stSegment;
+
+    /* a single data segment */
+    stSegment.pui8DataPtr = pui8BuffPtr;
+    stSegment.ui16DataLength = ui16BuffLength;
+
+    /* check destination port */
+    if(US_ANY_REMOTE_PORT != ui16DstPort)
+    {
+        unOpResult = sendVector(unSocketNum, ui32DstIPAdd, ui16DstPort, &stSegment, UC_1);
+    }
+    else
+    {
+        /* fail - invalid destination port */
+        unOpResult = UDP_OP_FAIL;
+    }
+
+    return unOpResult;
+}
+
+
+/* pass the oldest queued datagram of next socket with pending data to IPv4 layer (round-robin). Sockets whose
+   IPv4 TX class queue is full are skipped so that they do not hold back the other classes.
+   Return B_TRUE if a datagram has been passed, B_FALSE if queues are empty or no datagram can be passed */
+EXPORTED boolean UDP_sendNextQueuedData( void )
+{
+    boolean bSent = B_FALSE;
+    uint16 ui16SocketCount;
+    st_UDPSocketInfo *pstSocket;
+    UDP_st_DataSegment stSegment;
+
+    /* search next socket with queued data */
+    for(ui16SocketCount = US_NULL; ui16SocketCount < UDP_SOCKET_MAX_NUM; ui16SocketCount++)
+    {
+        pstSocket = &stUDPSocketInfo[ui16TXNextSocketIdx];
+
+        /* next socket for next search */
+        ui16TXNextSocketIdx = ((ui16TXNextSocketIdx + US_1) % UDP_SOCKET_MAX_NUM);
+
+        /* if socket is open and has queued data */
+        if((pstSocket->bSocketOpen == B_TRUE)
+        && (pstSocket->ui8TXQueueLevel > UC_NULL))
+        {
+            /* queued data are already gathered in a single segment */
+            stSegment.pui8DataPtr = pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].pui8DataPtr;
+            stSegment.ui16DataLength = pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].ui16DataLength;
+
+            /* try to send the oldest one */
+            if(UDP_OP_OK == sendDatagram(pstSocket,
+                                         pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].ui32DstIPAdd,
+                                         pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].ui16DstPort,
+                                         &stSegment,
+                                         UC_1,
+                                         stSegment.ui16DataLength))
+            {
+                /* free slot */
+                releaseTXQueueHead(pstSocket);
+
+                bSent = B_TRUE;
+
+                /* stop here */
+                break;
+            }
+            else
+            {
+                /* IPv4 TX queue of the socket class is full: try next socket */
+            }
+        }
+        else
+        {
+            /* check next socket */
+        }
+    }
+
+    return bSent;
+}
+
+
+/* close a previously open socket */
+EXPORTED UDP_keOpResult UDP_CloseUDPSocket(UDP_keSocketNum unSocketNum)
+{
+    UDP_keOpResult opResult;
+
+    /* if the socket is open */
+    /* ATTENTION: it is possible to leave the socket open in case of pending RX or TX data */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE))
+    {
+        /* remove socket from the demultiplexing hash table */
+        removeSocketFromHash((uint16)unSocketNum);
+
+        /* discard queued datagrams: give their RX buffers back to lower layers */
+        while(stUDPSocketInfo[unSocketNum].ui8RXQueueLevel > UC_NULL)
+        {
+            releaseRXQueueHead(&stUDPSocketInfo[unSocketNum]);
+        }
+
+        /* discard datagrams waiting to be transmitted */
+        while(stUDPSocketInfo[unSocketNum].ui8TXQueueLevel > UC_NULL)
+        {
+            releaseTXQueueHead(&stUDPSocketInfo[unSocketNum]);
+        }
+
+        /* socket is now closed */
+        stUDPSocketInfo[unSocketNum].bSocketOpen = B_FALSE;
+
+        /* success */
+        opResult = UDP_OP_OK;
+    }
+    else
+    {
+        /* fail - invalid socket number or socket is already closed */
+        opResult = UDP_OP_FAIL;
+    }
+
+    return opResult;
+}
+
+
+
+
+/* ----------------- Local functions declaration ----------------- */
+
+/* open a socket and insert it in the demultiplexing hash table */
+LOCAL UDP_keOpResult openSocket(UDP_keSocketNum unSocketNum, uint32 ui32IPSrcAddress, uint32 ui32IPDstAddress, uint16 ui16SrcPort, uint16 ui16DstPort )
+{
+    UDP_keOpResult unOpResult;
+    uint8 ui8SlotIdx;
+
     /* ATTENTION: some parameters checks are needed */
 
-    /* if socket is not open */
-    if(stUDPSocketInfo[unSocketNum].bSocketOpen != B_TRUE)
+    /* if socket number is valid and socket is not open */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen != B_TRUE))
     {
-        /* allocate RX data buffer */
-        stUDPSocketInfo[unSocketNum].pui8RXDataBufPtr = (uint8 *)MEM_MALLOC(UDP_MAX_DATA_LENGTH_ALLOWED);
-        if(stUDPSocketInfo[unSocketNum].pui8RXDataBufPtr != NULL)
+        /* clear RX queue slots */
+        for(ui8SlotIdx = UC_NULL; ui8SlotIdx < UDP_UC_RX_QUEUE_DEPTH; ui8SlotIdx++)
         {
-            /* set src and dst addresses and ports */
-            stUDPSocketInfo[unSocketNum].ui32IPSrcAddress = ui32IPSrcAddress;
-            stUDPSocketInfo[unSocketNum].ui32IPDstAddress = ui32IPDstAddress;
-            stUDPSocketInfo[unSocketNum].ui16UDPSrcPort = ui16SrcPort;
-            stUDPSocketInfo[unSocketNum].ui16UDPDstPort = ui16DstPort;
+            stUDPSocketInfo[unSocketNum].astRXQueue[ui8SlotIdx].pui8DataPtr = NULL_PTR;
+            stUDPSocketInfo[unSocketNum].astRXQueue[ui8SlotIdx].ui16DataLength = US_NULL;
+        }
+        /* RX queue is empty */
+        stUDPSocketInfo[unSocketNum].ui8RXQueueHead = UC_NULL;
+        stUDPSocketInfo[unSocketNum].ui8RXQueueLevel = UC_NULL;
+        stUDPSocketInfo[unSocketNum].bRXSlotPending = B_FALSE;
 
-            /* socket open */
-            stUDPSocketInfo[unSocketNum].bSocketOpen = B_TRUE;
+        /* no receive callback */
+        stUDPSocketInfo[unSocketNum].pfRXCallback = NULL_PTR;
 
-            /* TODO: do not set a 0.0.0.0 src address */
+        /* TX queue is empty */
+        stUDPSocketInfo[unSocketNum].ui8TXQueueHead = UC_NULL;
+        stUDPSocketInfo[unSocketNum].ui8TXQueueLevel = UC_NULL;
 
-            /* send the new local IP address to lower layers */
-            IPV4_setLocalIPAddress(ui32IPSrcAddress);
+        /* reset statistics */
+        stUDPSocketInfo[unSocketNum].stStats.ui32RXDatagramsCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32RXOverflowCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32RXTooLongCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32RXNoBufferCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32RXCopiedCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui8RXQueueLevel = UC_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32TXDatagramsCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui32TXDropCnt = UL_NULL;
+        stUDPSocketInfo[unSocketNum].stStats.ui8TXQueueLevel = UC_NULL;
 
-            /* success */
-            unOpResult = UDP_OP_OK;
+        /* set src and dst addresses and ports */
+        stUDPSocketInfo[unSocketNum].ui32IPSrcAddress = ui32IPSrcAddress;
+        stUDPSocketInfo[unSocketNum].ui32IPDstAddress = ui32IPDstAddress;
+        stUDPSocketInfo[unSocketNum].ui16UDPSrcPort = ui16SrcPort;
+        stUDPSocketInfo[unSocketNum].ui16UDPDstPort = ui16DstPort;
+
+        /* best effort until set by the application */
+        stUDPSocketInfo[unSocketNum].ui8Dscp = IPV4_UC_DSCP_DEFAULT;
+
+        /* prepare headers for the connected destination once */
+        prepareHeaderTemplates(&stUDPSocketInfo[unSocketNum]);
+
+        /* socket open */
+        stUDPSocketInfo[unSocketNum].bSocketOpen = B_TRUE;
+
+        /* insert socket in the demultiplexing hash table */
+        addSocketToHash((uint16)unSocketNum);
+
+        /* TODO: do not set a 0.0.0.0 src address */
+
+        /* send the new local IP address to lower layers */
+        IPV4_setLocalIPAddress(ui32IPSrcAddress);
+
+        /* success */
+        unOpResult = UDP_OP_OK;
+    }
+    else
+    {
+        /* fail - invalid socket number or socket already open */
+        unOpResult = UDP_OP_FAIL;
+    }
+    
+    return unOpResult;
+}
+
+
+/* send or queue a list of data segments as a single datagram to a remote IP address and port */
+LOCAL UDP_keOpResult sendVector(UDP_keSocketNum unSocketNum, uint32 ui32DstIPAdd, uint16 ui16DstPort, const UDP_st_DataSegment *pstSegments, uint8 ui8NumOfSegments)
+{
+    UDP_keOpResult unOpResult;
+    st_UDPSocketInfo *pstSocket;
+    st_TXQueueSlot *pstSlot;
+    uint32 ui32DataLength;
+
+    /* get total data length */
+    ui32DataLength = getSegmentsLength(pstSegments, ui8NumOfSegments);
+
+    /* check required socket number, if the socket is open and data length */
+    if((unSocketNum < UDP_SOCKET_MAX_NUM)
+    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE)
+    && (ui32DataLength <= UDP_MAX_DATA_LENGTH_ALLOWED))
+    {
+        pstSocket = &stUDPSocketInfo[unSocketNum];
+
+        /* if no other datagrams are waiting then try to send it now */
+        if(UC_NULL == pstSocket->ui8TXQueueLevel)
+        {
+            unOpResult = sendDatagram(pstSocket, ui32DstIPAdd, ui16DstPort, pstSegments, ui8NumOfSegments, (uint16)ui32DataLength);
         }
         else
         {
-            /* fail to alloc RX data buffer */
+            /* keep datagrams order */
             unOpResult = UDP_OP_FAIL;
         }
+
+        /* if not sent then queue it */
+        if(UDP_OP_OK != unOpResult)
+        {
+            /* check TX queue space */
+            if(pstSocket->ui8TXQueueLevel < UDP_UC_TX_QUEUE_DEPTH)
+            {
+                /* get the first free slot */
+                pstSlot = &pstSocket->astTXQueue[((pstSocket->ui8TXQueueHead + pstSocket->ui8TXQueueLevel) % UDP_UC_TX_QUEUE_DEPTH)];
+
+                /* get a pool buffer and gather data */
+                pstSlot->pui8DataPtr = BUFPOOL_alloc((uint16)ui32DataLength);
+                if(pstSlot->pui8DataPtr != NULL)
+                {
+                    gatherSegments(pstSlot->pui8DataPtr, pstSegments, ui8NumOfSegments);
+                    pstSlot->ui16DataLength = (uint16)ui32DataLength;
+                    pstSlot->ui32DstIPAdd = ui32DstIPAdd;
+                    pstSlot->ui16DstPort = ui16DstPort;
+
+                    /* datagram queued */
+                    pstSocket->ui8TXQueueLevel++;
+
+                    /* success */
+                    unOpResult = UDP_OP_OK;
+                }
+                else
+                {
+                    /* fail to alloc data buffer: discard data */
+                    pstSocket->stStats.ui32TXDropCnt++;
+                }
+            }
+            else
+            {
+                /* TX queue is full: discard data */
+                pstSocket->stStats.ui32TXDropCnt++;
+            }
+        }
+        else
+        {
+            /* sent */
+        }
     }
     else
     {
-        /* fail - socket already open */
+        /* fail - invalid socket number, socket is not open or data are too long */
         unOpResult = UDP_OP_FAIL;
     }
-    
+
     return unOpResult;
 }
 
 
-/* request to send a data buffer through an already open UDP socket */
-EXPORTED UDP_keOpResult UDP_SendDataBuffer(UDP_keSocketNum unSocketNum, uint8 *pui8BuffPtr, uint16 ui16BuffLength )
+
+/* get socket index from src and dst addresses and ports */
+LOCAL uint16 getSocketIndex(uint32 ui32SourceAdd, uint32 ui32DestAdd, uint16 ui16SourcePort, uint16 ui16DestPort)
+{
+    uint16 ui16SktIdx;
+
+    /* search a socket connected to the sender first */
+    ui16SktIdx = searchSocketBucket(ui32SourceAdd, ui32DestAdd, ui16SourcePort, ui16DestPort);
+    if(ui16SktIdx >= UDP_SOCKET_MAX_NUM)
+    {
+        /* then search a socket accepting data from any sender (IP broadcast remote address) */
+        ui16SktIdx = searchSocketBucket(UL_ANY_REMOTE_IP_ADD, ui32DestAdd, ui16SourcePort, ui16DestPort);
+    }
+    else
+    {
+        /* socket found */
+    }
+
+    if(ui16SktIdx >= UDP_SOCKET_MAX_NUM)
+    {
+        /* then search a socket listening on the destination port only */
+        ui16SktIdx = searchSocketBucket(UL_ANY_REMOTE_IP_ADD, ui32DestAdd, US_ANY_REMOTE_PORT, ui16DestPort);
+    }
+    else
+    {
+        /* socket found */
+    }
+
+    return ui16SktIdx;
+}
+
+
+/* search a socket in the hash table bucket related to remote IP address and ports */
+LOCAL uint16 searchSocketBucket(uint32 ui32RemoteAdd, uint32 ui32DestAdd, uint16 ui16SourcePort, uint16 ui16DestPort)
+{
+    uint16 ui16ListItem;
+    st_UDPSocketInfo *pstSocket;
+
+    /* get the first socket of the bucket */
+    ui16ListItem = aui16SocketHashTable[GET_SOCKET_HASH(ui32RemoteAdd, ui16DestPort, ui16SourcePort)];
+
+    /* walk the bucket list */
+    while(ui16ListItem != US_HASH_END_OF_LIST)
+    {
+        pstSocket = &stUDPSocketInfo[(ui16ListItem - US_1)];
+
+        if((pstSocket->ui16UDPSrcPort == ui16DestPort)                                          /* destination port is this one */
+        && (pstSocket->ui16UDPDstPort == ui16SourcePort)                                        /* source port is the expected one */
+        && (pstSocket->ui32IPDstAddress == ui32RemoteAdd)                                       /* the sender is the expected one */
+        && ((pstSocket->ui32IPSrcAddress == ui32DestAdd) || (pstSocket->ui32IPSrcAddress == 0x00000000)))   /* this device is the destination or source address is 0.0.0.0 */
+        {
+            /* socket found: stop here */
+            break;
+        }
+        else
+        {
+            /* next socket in the bucket */
+            ui16ListItem = pstSocket->ui16NextHashIdx;
+        }
+    }
+
+    /* return the socket index or UDP_SOCKET_MAX_NUM if not found */
+    return ((ui16ListItem != US_HASH_END_OF_LIST) ? (ui16ListItem - US_1) : (uint16)UDP_SOCKET_MAX_NUM);
+}
+
+
+/* prepare UDP header, gather data segments and pass the datagram to IPv4 layer */
+LOCAL UDP_keOpResult sendDatagram(st_UDPSocketInfo *pstSocket, uint32 ui32DstIPAdd, uint16 ui16DstPort, const UDP_st_DataSegment *pstSegments, uint8 ui8NumOfSegments, uint16 ui16BuffLength)
 {
     UDP_keOpResult unOpResult;
     IPV4_keOpResult unIPOpResult;
     IPv4_st_PacketDescriptor stIPv4PacketDscpt;
     uint16 ui16Checksum;
+    uint32 ui32Sum;
+    uint32 ui32HdrSum;
     uint8 *pui8BufferPtr;
     uint32 *pui32HdrWords;
     uint32 ui32HdrWord = UL_NULL;
+    const IPV4_st_HeaderTemplate *pstIPv4HdrTemplate;
 
-    /* check required socket number and if the socket is open */
-    if((unSocketNum < UDP_SOCKET_MAX_NUM)
-    && (stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE))
+    /* ATTENTION: a pointer availability check is needed */
+    pui8BufferPtr = (uint8 *)IPV4_getDataBuffPtr((ui16BuffLength + UDP_HEADER_BYTE_LENGTH), pstSocket->ui8Dscp);
+    if(pui8BufferPtr != NULL)
     {
-        /* ATTENTION: a pointer availability check is needed */
-        pui8BufferPtr = (uint8 *)IPV4_getDataBuffPtr();
-        if(pui8BufferPtr != NULL)
+        /* perform a 32-bit word alignment */
+        ALIGN_32BIT_OF_8BIT_PTR(pui8BufferPtr);
+        /* set 32-bit header pointer */
+        pui32HdrWords = (uint32 *)pui8BufferPtr;
+
+        /* if destination is the connected one then use the socket headers templates */
+        if((ui32DstIPAdd == pstSocket->ui32IPDstAddress)
+        && (ui16DstPort == pstSocket->ui16UDPDstPort))
+        {
+            /* ports word is already in network bytes order */
+            *pui32HdrWords++ = pstSocket->ui32HdrPortsWord;
+            ui32HdrSum = pstSocket->ui32HdrTemplateSum;
+            pstIPv4HdrTemplate = &pstSocket->stIPv4HdrTemplate;
+        }
+        else
         {
-            /* perform a 32-bit word alignment */
-            ALIGN_32BIT_OF_8BIT_PTR(pui8BufferPtr);
-            /* set 32-bit header pointer */
-            pui32HdrWords = (uint32 *)pui8BufferPtr;
-
             /* set source port */
-            SET_HDR_SRC_PORT(ui32HdrWord, stUDPSocketInfo[unSocketNum].ui16UDPSrcPort);
+            SET_HDR_SRC_PORT(ui32HdrWord, pstSocket->ui16UDPSrcPort);
             /* set destination port */
-            SET_HDR_DST_PORT(ui32HdrWord, stUDPSocketInfo[unSocketNum].ui16UDPDstPort);
-            WRITE_32BIT_AND_NEXT(pui32HdrWords, ui32HdrWord);
-            /* set UDP length as data length plus header length */
-            SET_HDR_LENGTH(ui32HdrWord, (ui16BuffLength + UDP_HEADER_BYTE_LENGTH));
-            /* ATTENTION: checksum is fixed at 0 (not mandatory) */
-            SET_HDR_CHECKSUM(ui32HdrWord, 0x0000);
+            SET_HDR_DST_PORT(ui32HdrWord, ui16DstPort);
             WRITE_32BIT_AND_NEXT(pui32HdrWords, ui32HdrWord);
+            ui32HdrSum = getHeaderTemplateSum(pstSocket->ui32IPSrcAddress, ui32DstIPAdd, pstSocket->ui16UDPSrcPort, ui16DstPort);
+            pstIPv4HdrTemplate = NULL_PTR;
+        }
 
-            /* attach data */
-            MEM_COPY((uint8 *)pui32HdrWords, pui8BuffPtr, ui16BuffLength);
-
-            /* set IPv4 descriptor */
-            stIPv4PacketDscpt.enProtocol = IPV4_PROT_UDP;
-            stIPv4PacketDscpt.bDoNotFragment = B_FALSE; /* ATTENTION: this value can change according to application request */
-            stIPv4PacketDscpt.ui16DataLength = (ui16BuffLength + UDP_HEADER_BYTE_LENGTH);
-            stIPv4PacketDscpt.ui32IPDstAddress = stUDPSocketInfo[unSocketNum].ui32IPDstAddress;
-            stIPv4PacketDscpt.ui32IPSrcAddress = stUDPSocketInfo[unSocketNum].ui32IPSrcAddress;
-
-            /* calculate and update checksum field */
-            pui32HdrWords = (uint32 *)pui8BufferPtr;
-            ui16Checksum = calculateChecksum(&stIPv4PacketDscpt, (uint16 *)pui32HdrWords);
-            pui32HdrWords += 1;
-            UPDATE_HDR_CHECKSUM(pui32HdrWords, ui16Checksum);
+        /* attach data segments after the UDP header and sum them in the same pass */
+        ui32Sum = gatherSegments((uint8 *)(pui32HdrWords + 1), pstSegments, ui8NumOfSegments);
+
+        /* set UDP length as data length plus header length and the checksum: only length is added to the template sum */
+        ui16Checksum = calculateChecksum((ui32Sum + ui32HdrSum), (ui16BuffLength + UDP_HEADER_BYTE_LENGTH));
+        SET_HDR_LENGTH(ui32HdrWord, (ui16BuffLength + UDP_HEADER_BYTE_LENGTH));
+        SET_HDR_CHECKSUM(ui32HdrWord, ui16Checksum);
+        WRITE_32BIT_AND_NEXT(pui32HdrWords, ui32HdrWord);
+
+        /* set IPv4 descriptor */
+        stIPv4PacketDscpt.enProtocol = IPV4_PROT_UDP;
+        stIPv4PacketDscpt.bDoNotFragment = B_FALSE; /* ATTENTION: this value can change according to application request */
+        stIPv4PacketDscpt.ui8Dscp = pstSocket->ui8Dscp;
+        stIPv4PacketDscpt.ui16DataLength = (ui16BuffLength + UDP_HEADER_BYTE_LENGTH);
+        stIPv4PacketDscpt.ui32IPDstAddress = ui32DstIPAdd;
+        stIPv4PacketDscpt.ui32IPSrcAddress = pstSocket->ui32IPSrcAddress;
+        stIPv4PacketDscpt.pstHdrTemplate = pstIPv4HdrTemplate;
 /*
-            // example of options
-            uint8 pippo[] = "fakeoptions";
-            stIPv4PacketDscpt.stOptions.bSendOptions = B_TRUE;
-            stIPv4PacketDscpt.stOptions.pui8OptionDataPtr = pippo;
-            stIPv4PacketDscpt.stOptions.ui8OptionLength = 11;
-            stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.copiedFlag = 1;
-            stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.optionClass = 2;
-            stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.optionNumber = 4;
+        // example of options
+        uint8 pippo[] = "fakeoptions";
+        stIPv4PacketDscpt.stOptions.bSendOptions = B_TRUE;
+        stIPv4PacketDscpt.stOptions.pui8OptionDataPtr = pippo;
+        stIPv4PacketDscpt.stOptions.ui8OptionLength = 11;
+        stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.copiedFlag = 1;
+        stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.optionClass = 2;
+        stIPv4PacketDscpt.stOptions.unOptionType.stOptionType.optionNumber = 4;
 */
-            /* send UDP packet through IP */
-            unIPOpResult = IPV4_SendPacket(stIPv4PacketDscpt);
-        
-            /* check IP operation result */
-            if(IPV4_OP_OK == unIPOpResult)
-            {
-                /* success */
-                unOpResult = UDP_OP_OK;
-            }
-            else
-            {
-                /* fail to send the packet through IPv4 module */
-                unOpResult = UDP_OP_FAIL;
-            }
+        /* send UDP packet through IP */
+        unIPOpResult = IPV4_SendPacket(stIPv4PacketDscpt);
+    
+        /* check IP operation result */
+        if(IPV4_OP_OK == unIPOpResult)
+        {
+            /* success */
+            unOpResult = UDP_OP_OK;
         }
         else
         {
-            /* ATTENTION */
-            /* TX buffer pointer is still busy with a previous TX request or it is corrupted */
-            /* if this operation is performed in a periodic task then the request would not be discarded
-             * but tried again at the next run */
+            /* fail to send the packet through IPv4 module */
             unOpResult = UDP_OP_FAIL;
         }
     }
     else
     {
-        /* fail - invalid socket number or socket is not open */
+        /* TX buffer pointer is still busy with a previous TX request:
+         * the caller keeps the datagram queued and it is tried again later */
         unOpResult = UDP_OP_FAIL;
     }
 
+    /* update statistics */
+    if(UDP_OP_OK == unOpResult)
+    {
+        pstSocket->stStats.ui32TXDatagramsCnt++;
+    }
+    else
+    {
+        /* do nothing */
+    }
+
     return unOpResult;
 }
 
 
-/* close a previously open socket */
-EXPORTED UDP_keOpResult UDP_CloseUDPSocket(UDP_keSocketNum unSocketNum)
+/* get the total length of a list of data segments */
+LOCAL uint32 getSegmentsLength(const UDP_st_DataSegment *pstSegments, uint8 ui8NumOfSegments)
 {
-    UDP_keOpResult opResult;
+    uint32 ui32Length = UL_NULL;
 
-    /* if the socket is open */
-    /* ATTENTION: it is possible to leave the socket open in case of pending RX or TX data */
-    if(stUDPSocketInfo[unSocketNum].bSocketOpen == B_TRUE)
+    while(ui8NumOfSegments > UC_NULL)
     {
-        /* free RX data buffer */
-        MEM_FREE(stUDPSocketInfo[unSocketNum].pui8RXDataBufPtr);
+        ui32Length += pstSegments->ui16DataLength;
 
-        /* socket is now closed */
-        stUDPSocketInfo[unSocketNum].bSocketOpen = B_FALSE;
+        /* next segment */
+        pstSegments++;
+        ui8NumOfSegments--;
+    }
 
-        /* success */
-        opResult = UDP_OP_OK;
+    return ui32Length;
+}
+
+
+/* copy a list of data segments one after the other in a buffer and return their checksum partial sum */
+LOCAL uint32 gatherSegments(uint8 *pui8DestPtr, const UDP_st_DataSegment *pstSegments, uint8 ui8NumOfSegments)
+{
+    uint32 ui32Sum = UL_NULL;
+    uint32 ui32SegmentSum;
+    boolean bOddOffset = B_FALSE;
+
+    while(ui8NumOfSegments > UC_NULL)
+    {
+        /* copy and sum segment in a single pass */
+        ui32SegmentSum = CHKSUM_copyAndAccumulate(pui8DestPtr, pstSegments->pui8DataPtr, pstSegments->ui16DataLength, UL_NULL);
+        /* a segment starting at an odd offset has its bytes swapped in the sum */
+        if(B_TRUE == bOddOffset)
+        {
+            ui32SegmentSum = CHKSUM_SWAP_PARTIAL_SUM(ui32SegmentSum);
+        }
+        else
+        {
+            /* do nothing */
+        }
+        ui32Sum += ui32SegmentSum;
+
+        /* update offset */
+        pui8DestPtr += pstSegments->ui16DataLength;
+        if((pstSegments->ui16DataLength & US_1) != US_NULL)
+        {
+            bOddOffset = (B_TRUE == bOddOffset) ? B_FALSE : B_TRUE;
+        }
+        else
+        {
+            /* do nothing */
+        }
+
+        /* next segment */
+        pstSegments++;
+        ui8NumOfSegments--;
+    }
+
+    return ui32Sum;
+}
+
+
+/* free the oldest queued datagram to transmit of a socket */
+LOCAL void releaseTXQueueHead(st_UDPSocketInfo *pstSocket)
+{
+    /* give data buffer back to the pool */
+    BUFPOOL_free(pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].pui8DataPtr);
+    pstSocket->astTXQueue[pstSocket->ui8TXQueueHead].pui8DataPtr = NULL_PTR;
+
+    /* free the slot */
+    pstSocket->ui8TXQueueHead = ((pstSocket->ui8TXQueueHead + UC_1) % UDP_UC_TX_QUEUE_DEPTH);
+    pstSocket->ui8TXQueueLevel--;
+}
+
+
+/* release the oldest queued datagram of a socket and give its RX buffer back to lower layers */
+LOCAL void releaseRXQueueHead(st_UDPSocketInfo *pstSocket)
+{
+    /* release RX buffer */
+    IPV4_releaseRXDataBuffer(pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].pui8DataPtr);
+    pstSocket->astRXQueue[pstSocket->ui8RXQueueHead].pui8DataPtr = NULL_PTR;
+
+    /* free the slot */
+    pstSocket->ui8RXQueueHead = ((pstSocket->ui8RXQueueHead + UC_1) % UDP_UC_RX_QUEUE_DEPTH);
+    pstSocket->ui8RXQueueLevel--;
+    pstSocket->bRXSlotPending = B_FALSE;
+}
+
+
+/* calculate the hash table bucket from remote IP address, local port and remote port */
+LOCAL uint16 getSocketHash(uint32 ui32RemoteAdd, uint16 ui16LocalPort, uint16 ui16RemotePort)
+{
+    uint32 ui32Key;
+
+    /* mix all the key fields in a 32-bit word */
+    ui32Key = ui32RemoteAdd ^ (((uint32)ui16LocalPort << UL_SHIFT_16) | ui16RemotePort);
+    /* fold the key on the table index bits */
+    ui32Key ^= (ui32Key >> UL_SHIFT_16);
+    ui32Key ^= (ui32Key >> UL_SHIFT_8);
+
+    return (uint16)(ui32Key & (UDP_US_SOCKET_HASH_TABLE_SIZE - 1));
+}
+
+
+/* insert an open socket at the head of its hash table bucket */
+LOCAL void addSocketToHash(uint16 ui16SktIdx)
+{
+    uint16 ui16Bucket;
+
+    ui16Bucket = GET_SOCKET_HASH(stUDPSocketInfo[ui16SktIdx].ui32IPDstAddress,
+                                 stUDPSocketInfo[ui16SktIdx].ui16UDPSrcPort,
+                                 stUDPSocketInfo[ui16SktIdx].ui16UDPDstPort);
+
+    /* link the previous head after this socket */
+    stUDPSocketInfo[ui16SktIdx].ui16NextHashIdx = aui16SocketHashTable[ui16Bucket];
+    /* this socket is the new head */
+    aui16SocketHashTable[ui16Bucket] = (ui16SktIdx + US_1);
+}
+
+
+/* remove a socket from its hash table bucket */
+LOCAL void removeSocketFromHash(uint16 ui16SktIdx)
+{
+    uint16 *pui16Link;
+
+    /* start from the bucket head */
+    pui16Link = &aui16SocketHashTable[GET_SOCKET_HASH(stUDPSocketInfo[ui16SktIdx].ui32IPDstAddress,
+                                                      stUDPSocketInfo[ui16SktIdx].ui16UDPSrcPort,
+                                                      stUDPSocketInfo[ui16SktIdx].ui16UDPDstPort)];
+
+    /* search the link pointing to this socket */
+    while((*pui16Link != US_HASH_END_OF_LIST)
+    &&    (*pui16Link != (ui16SktIdx + US_1)))
+    {
+        pui16Link = &stUDPSocketInfo[(*pui16Link - US_1)].ui16NextHashIdx;
+    }
+
+    /* if found then unlink it */
+    if(*pui16Link != US_HASH_END_OF_LIST)
+    {
+        *pui16Link = stUDPSocketInfo[ui16SktIdx].ui16NextHashIdx;
     }
     else
     {
-        /* fail - socket is already closed */
-        opResult = UDP_OP_FAIL;
+        /* not found: nothing to remove */
     }
 
-    return opResult;
+    /* clear link */
+    stUDPSocketInfo[ui16SktIdx].ui16NextHashIdx = US_HASH_END_OF_LIST;
 }
 
 
+/* prepare the UDP and IPv4 headers templates of a socket for its connected destination */
+LOCAL void prepareHeaderTemplates(st_UDPSocketInfo *pstSocket)
+{
+    uint32 ui32HdrWord = UL_NULL;
 
+    /* UDP header ports word */
+    SET_HDR_SRC_PORT(ui32HdrWord, pstSocket->ui16UDPSrcPort);
+    SET_HDR_DST_PORT(ui32HdrWord, pstSocket->ui16UDPDstPort);
+    WRITE_32BIT(&pstSocket->ui32HdrPortsWord, ui32HdrWord);
 
-/* ----------------- Local functions declaration ----------------- */
+    /* constant part of the checksum sum */
+    pstSocket->ui32HdrTemplateSum = getHeaderTemplateSum(pstSocket->ui32IPSrcAddress, pstSocket->ui32IPDstAddress,
+                                                         pstSocket->ui16UDPSrcPort, pstSocket->ui16UDPDstPort);
 
-/* get socket index from src and dst addresses and ports */
-LOCAL uint8 getSocketIndex(uint32 ui32SourceAdd, uint32 ui32DestAdd, uint16 ui16SourcePort, uint16 ui16DestPort)
+    /* IPv4 header */
+    IPV4_prepareHeaderTemplate(&pstSocket->stIPv4HdrTemplate, pstSocket->ui32IPSrcAddress, pstSocket->ui32IPDstAddress, IPV4_PROT_UDP, pstSocket->ui8Dscp);
+}
+
+
+/* get the checksum partial sum of the fields that do not change with the datagram length:
+   pseudo header addresses and protocol and UDP header ports */
+LOCAL uint32 getHeaderTemplateSum(uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint16 ui16SrcPort, uint16 ui16DstPort)
+{
+    uint32 ui32Sum;
+
+    ui32Sum = addPseudoHeaderSum(UL_NULL, ui32SrcIPAdd, ui32DstIPAdd, US_NULL);
+
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(ui16SrcPort);
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(ui16DstPort);
+
+    return ui32Sum;
+}
+
+
+/* Function to calculate checksum: add the UDP length to the header template and data partial sum.
+   Length is counted twice: in the pseudo header and in the UDP header */
+LOCAL uint16 calculateChecksum(uint32 ui32Sum, uint16 ui16UDPLength)
 {
-    uint8 ui8SktIdx = UC_NULL;
+    uint16 ui16Checksum;
 
-    /* search socket */
-    while(  (   (stUDPSocketInfo[ui8SktIdx].bSocketOpen != B_TRUE)              /* socket is still open */
-            ||  ((stUDPSocketInfo[ui8SktIdx].ui32IPSrcAddress != ui32DestAdd) && (stUDPSocketInfo[ui8SktIdx].ui32IPSrcAddress != 0x00000000))   /* this device is the destination or source address is not 0.0.0.0 */
-            ||  ((stUDPSocketInfo[ui8SktIdx].ui32IPDstAddress != ui32SourceAdd) && (stUDPSocketInfo[ui8SktIdx].ui32IPDstAddress != 0xFFFFFFFF)) /* the sender is the expected one or destination address is not a IP broadcast address */
-            ||  (stUDPSocketInfo[ui8SktIdx].ui16UDPSrcPort != ui16DestPort)     /* destination port is this one */
-            ||  (stUDPSocketInfo[ui8SktIdx].ui16UDPDstPort != ui16SourcePort))  /* source port is the expected one */
-    &&      (ui8SktIdx < UDP_SOCKET_MAX_NUM))
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(ui16UDPLength);
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(ui16UDPLength);
 
+    /* fold, invert and swap bytes order */
+    ui16Checksum = CHKSUM_getChecksum(ui32Sum);
+
+    /* a calculated checksum of 0 is transmitted as all ones: 0 means no checksum */
+    if(US_NULL == ui16Checksum)
     {
-        /* next socket */
-        ui8SktIdx++;
+        ui16Checksum = US_MAX_USHORT;
     }
-    
-    return ui8SktIdx;
+    else
+    {
+        /* do nothing */
+    }
+
+    return ui16Checksum;
 }
 
 
-/* Function to calculate checksum */
-LOCAL uint16 calculateChecksum(IPv4_st_PacketDescriptor *stIPv4Header, uint16 *pui16UDPSegment)
+/* add the UDP pseudo header to a checksum partial sum */
+LOCAL uint32 addPseudoHeaderSum(uint32 ui32Sum, uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint16 ui16UDPLength)
 {
-    uint32 ui32Sum = 0;
-    uint16 ui16Length = stIPv4Header->ui16DataLength;
+    ui32Sum += ((SWAP_BYTES_ORDER_32BIT_(ui32SrcIPAdd) >> UL_SHIFT_16) & 0xFFFF);
+    ui32Sum += (SWAP_BYTES_ORDER_32BIT_(ui32SrcIPAdd) & 0xFFFF);
 
-    ui32Sum += ((SWAP_BYTES_ORDER_32BIT_(stIPv4Header->ui32IPSrcAddress) >> UL_SHIFT_16) & 0xFFFF);
-    ui32Sum += (SWAP_BYTES_ORDER_32BIT_(stIPv4Header->ui32IPSrcAddress) & 0xFFFF);
+    ui32Sum += ((SWAP_BYTES_ORDER_32BIT_(ui32DstIPAdd) >> UL_SHIFT_16) & 0xFFFF);
+    ui32Sum += (SWAP_BYTES_ORDER_32BIT_(ui32DstIPAdd) & 0xFFFF);
 
-    ui32Sum += ((SWAP_BYTES_ORDER_32BIT_(stIPv4Header->ui32IPDstAddress) >> UL_SHIFT_16) & 0xFFFF);
-    ui32Sum += (SWAP_BYTES_ORDER_32BIT_(stIPv4Header->ui32IPDstAddress) & 0xFFFF);
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(IPV4_PROT_UDP);
 
-    ui32Sum += SWAP_BYTES_ORDER_16BIT_(stIPv4Header->enProtocol);
+    ui32Sum += SWAP_BYTES_ORDER_16BIT_(ui16UDPLength);
 
-    ui32Sum += SWAP_BYTES_ORDER_16BIT_(stIPv4Header->ui16DataLength);
+    return ui32Sum;
+}
+
+
+/* check the checksum of a received datagram. If the message partial sum is not given then it is calculated here */
+LOCAL boolean isChecksumValid(uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint8 *pui8MessagePtr, uint16 ui16UDPLength, const uint32 *pui32MsgSum)
+{
+    uint32 ui32Sum;
+    boolean bValid;
 
-    while( ui16Length > 1 )
+    /* if partial sum has been already calculated by lower layers (hardware) */
+    if(pui32MsgSum != NULL_PTR)
     {
-        ui32Sum += *pui16UDPSegment;
-        pui16UDPSegment++;
-        ui16Length -= 2;
+        ui32Sum = *pui32MsgSum;
     }
-
-    if( ui16Length > 0 )
+    else
     {
-        ui32Sum += ((*pui16UDPSegment) & SWAP_BYTES_ORDER_16BIT_(0xFF00));
+        /* software fallback: sum header and data */
+        ui32Sum = CHKSUM_accumulate(UL_NULL, pui8MessagePtr, ui16UDPLength);
     }
 
-    /* Fold 32-bit sum to 16 bits: add carrier to result */
-    while( ui32Sum >> 16 )
+    ui32Sum = addPseudoHeaderSum(ui32Sum, ui32SrcIPAdd, ui32DstIPAdd, ui16UDPLength);
+
+    /* the checksum over the whole datagram, checksum field included, is 0 if valid */
+    if(US_NULL == CHKSUM_getChecksum(ui32Sum))
     {
-        ui32Sum = (ui32Sum & 0xFFFF) + (ui32Sum >> 16);
+        bValid = B_TRUE;
+    }
+    else
+    {
+        bValid = B_FALSE;
     }
-    ui32Sum = ~ui32Sum;
-
-    /* swap bytes order */
-    ui32Sum = SWAP_BYTES_ORDER_16BIT_(ui32Sum);
 
-    return (uint16)ui32Sum;
+    return bValid;
 }
 
 
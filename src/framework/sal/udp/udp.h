@@ -40,9 +40,27 @@
 
 /* --------------- Exported defines ----------------- */
 
-/* Max received data length allowed */
-#define UDP_MAX_DATA_LENGTH_ALLOWED         (400)   /* ATTENTION: do not change it... be careful,
-                                                    it is used by DHCP that needs big BOOT packets */
+/* Max data length allowed to receive and to send. Datagrams are fragmented and re-assembled by IPv4 layer.
+   ATTENTION: it shall not be greater than IPV4_US_MAX_PAYLOAD_LENGTH minus the UDP header length */
+#define UDP_MAX_DATA_LENGTH_ALLOWED         (2040)
+
+/* Max num of UDP sockets. ATTENTION: it shall not be lower than the number of named sockets of UDP_keSocketNum enum.
+   It can be given at build time (i.e. by the test harness) */
+#ifndef UDP_US_MAX_NUM_OF_SOCKETS
+#define UDP_US_MAX_NUM_OF_SOCKETS           (8)
+#endif
+
+/* Num of buckets of the sockets demultiplexing hash table. ATTENTION: it must be a power of 2.
+   It can be given at build time (i.e. by the test harness) */
+#ifndef UDP_US_SOCKET_HASH_TABLE_SIZE
+#define UDP_US_SOCKET_HASH_TABLE_SIZE       (16)
+#endif
+
+/* Num of received datagrams that can be queued for each socket */
+#define UDP_UC_RX_QUEUE_DEPTH               (4)
+
+/* Num of datagrams to transmit that can be queued for each socket */
+#define UDP_UC_TX_QUEUE_DEPTH               (4)
 
 
 
@@ -68,19 +86,66 @@ typedef enum
    ,UDP_SOCKET_6
    ,UDP_SOCKET_7
    ,UDP_SOCKET_8
-   ,UDP_SOCKET_MAX_NUM
+   ,UDP_SOCKET_MAX_NUM = UDP_US_MAX_NUM_OF_SOCKETS  /* sockets beyond UDP_SOCKET_8 are addressed by their number */
 } UDP_keSocketNum;
 
 
 
 
+/* --------------- Exported types definitions ---------------- */
+
+/* data segment structure for vectored send */
+typedef struct
+{
+    const uint8 *pui8DataPtr;
+    uint16 ui16DataLength;
+} UDP_st_DataSegment;
+
+
+/* socket statistics structure */
+typedef struct
+{
+    uint32 ui32RXDatagramsCnt;      /* num of datagrams queued */
+    uint32 ui32RXOverflowCnt;       /* num of datagrams discarded because of RX queue full */
+    uint32 ui32RXTooLongCnt;        /* num of datagrams discarded because longer than UDP_MAX_DATA_LENGTH_ALLOWED */
+    uint32 ui32RXNoBufferCnt;       /* num of datagrams discarded because their RX buffer could neither be lent nor copied */
+    uint32 ui32RXCopiedCnt;         /* num of datagrams copied into a pool buffer because their RX buffer could not be lent */
+    uint8 ui8RXQueueLevel;          /* num of datagrams currently in RX queue */
+    uint32 ui32TXDatagramsCnt;      /* num of datagrams passed to IPv4 layer */
+    uint32 ui32TXDropCnt;           /* num of datagrams discarded because of TX queue full or no memory */
+    uint8 ui8TXQueueLevel;          /* num of datagrams currently in TX queue */
+} UDP_st_SocketStats;
+
+
+/* socket receive callback type: socket, sender IP address and port, data pointer and length.
+   Data pointer is valid only during the callback call */
+typedef void (* UDP_pfRXCallback)(UDP_keSocketNum, uint32, uint16, uint8 *, uint16);
+
+
+
+
 /* -------------- Exported functions prototypes -------------- */
 
 EXTERN UDP_keOpResult   UDP_OpenUDPSocket       (UDP_keSocketNum, uint32, uint32, uint16, uint16);
+EXTERN UDP_keOpResult   UDP_OpenListenSocket    (UDP_keSocketNum, uint32, uint16);
 EXTERN UDP_keOpResult   UDP_SendDataBuffer      (UDP_keSocketNum, uint8 *, uint16);
-EXTERN void             UDP_checkReceivedData   (UDP_keSocketNum, uint8 **, uint16 *);
-EXTERN void             UDP_unpackMessage       (uint32, uint32, uint8 *);
+EXTERN UDP_keOpResult   UDP_SendDataVector      (UDP_keSocketNum, const UDP_st_DataSegment *, uint8);
+EXTERN UDP_keOpResult   UDP_SendTo              (UDP_keSocketNum, uint32, uint16, uint8 *, uint16);
+/* ATTENTION: a datagram returned by UDP_getNextRXData or UDP_ReceiveFrom holds its buffer until UDP_releaseRXData or
+   the next call for the same socket, and each queued datagram holds one too. Up to ETHMAC_UC_RX_MAX_LENT_BUFFERS of them
+   are ETHMAC RX buffers lent without copy, the others are copied into the buffers pool. So a socket that is never drained
+   does not stop the reception of other sockets, but it keeps up to UDP_UC_RX_QUEUE_DEPTH buffers and it can leave
+   other sockets without lent or pool buffers: their datagrams are then discarded and counted in ui32RXNoBufferCnt */
+EXTERN UDP_keOpResult   UDP_getNextRXData       (UDP_keSocketNum, uint8 **, uint16 *);
+EXTERN UDP_keOpResult   UDP_ReceiveFrom         (UDP_keSocketNum, uint8 **, uint16 *, uint32 *, uint16 *);
+EXTERN void             UDP_releaseRXData       (UDP_keSocketNum);
+EXTERN UDP_keOpResult   UDP_getSocketStats      (UDP_keSocketNum, UDP_st_SocketStats *);
+EXTERN UDP_keOpResult   UDP_setRXCallback       (UDP_keSocketNum, UDP_pfRXCallback);
+EXTERN UDP_keOpResult   UDP_setSocketDscp       (UDP_keSocketNum, uint8);
+EXTERN void             UDP_unpackMessage       (uint32, uint32, uint8 *, uint16, const uint32 *);
 EXTERN UDP_keOpResult   UDP_CloseUDPSocket      (UDP_keSocketNum);
+EXTERN boolean          UDP_sendNextQueuedData  (void);
+EXTERN uint32           UDP_getRXChecksumErrors (void);
 
 
 
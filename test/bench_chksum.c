@@ -0,0 +1,348 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+/*
+ * This file bench_chksum.c represents the host benchmark of the checksum module.
+ * CHKSUM_accumulate and CHKSUM_copyAndAccumulate are measured in MB/s against the 16-bit loops
+ * that UDP, IPv4 and ICMP modules used before, alone and after a MEM_COPY of the same data.
+ * Results of all of them are checked to be the same.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "framework/fw_common.h"
+#include "framework/sal/udp/chksum.h"
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* max measured data length */
+#define US_MAX_DATA_LENGTH              ((uint16)1472)
+
+/* num of bytes processed by each measure */
+#define ULL_BYTES_PER_MEASURE           ((uint64)256 * 1024 * 1024)
+
+/* num of measured kernels */
+#define UC_KERNELS_NUM                  ((uint8)6)
+
+
+
+
+/* ------------- Local types ----------------- */
+
+/* measured kernel: destination and source pointers and length. Return the checksum field value */
+typedef uint16 (* pf_Kernel)(uint8 *, const uint8 *, uint16);
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+/* source and destination data: 32-bit aligned, offsets are added by the measures */
+LOCAL uint32 aui32SrcData[(US_MAX_DATA_LENGTH + 8) / 4];
+LOCAL uint32 aui32DstData[(US_MAX_DATA_LENGTH + 8) / 4];
+
+/* results sink: it keeps kernels from being optimized out */
+LOCAL volatile uint16 ui16Sink;
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL uint16    oldUDPChecksum          (const uint8 *, uint16);
+LOCAL uint16    oldIPv4Checksum         (const uint8 *, uint16);
+LOCAL uint16    kernelOldUDP            (uint8 *, const uint8 *, uint16);
+LOCAL uint16    kernelOldIPv4           (uint8 *, const uint8 *, uint16);
+LOCAL uint16    kernelAccumulate        (uint8 *, const uint8 *, uint16);
+LOCAL uint16    kernelCopyOldUDP        (uint8 *, const uint8 *, uint16);
+LOCAL uint16    kernelCopyAccumulate    (uint8 *, const uint8 *, uint16);
+LOCAL uint16    kernelCopyAndAccumulate (uint8 *, const uint8 *, uint16);
+LOCAL double    measureKernel           (pf_Kernel, uint8, uint16);
+
+
+
+
+/* ------------- Local constants ----------------- */
+
+/* measured kernels and their names */
+LOCAL pf_Kernel const apfKernels[UC_KERNELS_NUM] =
+{
+    &kernelOldUDP,
+    &kernelOldIPv4,
+    &kernelAccumulate,
+    &kernelCopyOldUDP,
+    &kernelCopyAccumulate,
+    &kernelCopyAndAccumulate
+};
+
+LOCAL const char * const apcKernelNames[UC_KERNELS_NUM] =
+{
+    "old UDP 16-bit loop",
+    "old IPv4/ICMP 16-bit loop",
+    "CHKSUM_accumulate",
+    "MEM_COPY + old UDP loop",
+    "MEM_COPY + CHKSUM_accumulate",
+    "CHKSUM_copyAndAccumulate"
+};
+
+/* measured data lengths and source offsets. Offset 2 is the one of IPv4 header in RX buffers */
+LOCAL const uint16 aui16Lengths[] = { 20, 64, 576, 1472 };
+LOCAL const uint8 aui8Offsets[] = { 0, 2 };
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+int main( void )
+{
+    boolean bSuccess = B_TRUE;
+    uint8 *pui8Src = (uint8 *)aui32SrcData;
+    uint8 *pui8Dst = (uint8 *)aui32DstData;
+    uint16 ui16Idx;
+    uint16 ui16Length;
+    uint8 ui8Offset;
+    uint8 ui8Kernel;
+    uint8 ui8LengthIdx;
+    uint8 ui8OffsetIdx;
+    uint16 ui16Expected;
+
+    for(ui16Idx = US_NULL; ui16Idx < sizeof(aui32SrcData); ui16Idx++)
+    {
+        pui8Src[ui16Idx] = (uint8)SIM_getRandom();
+    }
+
+    /* all the kernels shall give the same result for any length and offset, and copies shall be exact */
+    for(ui8Offset = UC_NULL; ui8Offset < UC_4; ui8Offset++)
+    {
+        for(ui16Length = US_NULL; ui16Length <= US_MAX_DATA_LENGTH; ui16Length++)
+        {
+            ui16Expected = oldUDPChecksum(&pui8Src[ui8Offset], ui16Length);
+
+            for(ui8Kernel = UC_NULL; ui8Kernel < UC_KERNELS_NUM; ui8Kernel++)
+            {
+                memset(pui8Dst, 0, sizeof(aui32DstData));
+
+                if((apfKernels[ui8Kernel](&pui8Dst[ui8Offset], &pui8Src[ui8Offset], ui16Length) != ui16Expected)
+                || ((ui8Kernel >= UC_3) && (memcmp(&pui8Dst[ui8Offset], &pui8Src[ui8Offset], ui16Length) != 0)))
+                {
+                    printf("mismatch: %s, length %u, offset %u\n", apcKernelNames[ui8Kernel], ui16Length, ui8Offset);
+                    bSuccess = B_FALSE;
+                }
+                else
+                {
+                    /* same result */
+                }
+            }
+        }
+    }
+
+    printf("checksum kernels: MB/s by data length and source offset\n");
+    printf("%-30s", "");
+    for(ui8LengthIdx = UC_NULL; ui8LengthIdx < (sizeof(aui16Lengths) / sizeof(aui16Lengths[0])); ui8LengthIdx++)
+    {
+        for(ui8OffsetIdx = UC_NULL; ui8OffsetIdx < sizeof(aui8Offsets); ui8OffsetIdx++)
+        {
+            printf(" %6u+%u", aui16Lengths[ui8LengthIdx], aui8Offsets[ui8OffsetIdx]);
+        }
+    }
+    printf("\n");
+
+    for(ui8Kernel = UC_NULL; ui8Kernel < UC_KERNELS_NUM; ui8Kernel++)
+    {
+        printf("%-30s", apcKernelNames[ui8Kernel]);
+        for(ui8LengthIdx = UC_NULL; ui8LengthIdx < (sizeof(aui16Lengths) / sizeof(aui16Lengths[0])); ui8LengthIdx++)
+        {
+            for(ui8OffsetIdx = UC_NULL; ui8OffsetIdx < sizeof(aui8Offsets); ui8OffsetIdx++)
+            {
+                printf(" %8.0f", measureKernel(apfKernels[ui8Kernel], aui8Offsets[ui8OffsetIdx], aui16Lengths[ui8LengthIdx]));
+            }
+        }
+        printf("\n");
+    }
+
+    return ((B_TRUE == bSuccess) ? 0 : 1);
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* 16-bit loop of the UDP module before the checksum module, without the pseudo header */
+LOCAL uint16 oldUDPChecksum( const uint8 *pui8Data, uint16 ui16Length )
+{
+    uint32 ui32Sum = 0;
+    const uint16 *pui16UDPSegment = (const uint16 *)pui8Data;
+
+    while( ui16Length > 1 )
+    {
+        ui32Sum += *pui16UDPSegment;
+        pui16UDPSegment++;
+        ui16Length -= 2;
+    }
+
+    if( ui16Length > 0 )
+    {
+        ui32Sum += ((*pui16UDPSegment) & SWAP_BYTES_ORDER_16BIT_(0xFF00));
+    }
+
+    /* Fold 32-bit sum to 16 bits: add carrier to result */
+    while( ui32Sum >> 16 )
+    {
+        ui32Sum = (ui32Sum & 0xFFFF) + (ui32Sum >> 16);
+    }
+    ui32Sum = ~ui32Sum;
+
+    /* swap bytes order */
+    ui32Sum = SWAP_BYTES_ORDER_16BIT_(ui32Sum);
+
+    return (uint16)ui32Sum;
+}
+
+
+/* 16-bit loop of the IPv4 and ICMP modules before the checksum module. The left over byte is taken
+   from the data end: the old IPv4 loop took the first one, but it was used for even lengths only */
+LOCAL uint16 oldIPv4Checksum( const uint8 *pui8Data, uint16 ui16Length )
+{
+    const uint16 *ui16HdrPointer = (const uint16 *)pui8Data;
+    uint32 ui32Checksum = 0;
+
+    while(ui16Length > UC_1)
+    {
+        ui32Checksum += (*ui16HdrPointer);
+
+        ui16HdrPointer++;
+
+        /* if high order bit set, fold */
+        if(ui32Checksum & 0x80000000)
+        {
+            ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
+        }
+
+        ui16Length -= 2;
+    }
+
+    /* take care of left over byte */
+    if(ui16Length)
+    {
+        ui32Checksum += (uint16)(*((const uint8 *)ui16HdrPointer));
+    }
+
+    while(ui32Checksum >> UL_SHIFT_16)
+    {
+        ui32Checksum = (ui32Checksum & 0xFFFF) + (ui32Checksum >> UL_SHIFT_16);
+    }
+
+    /* invert it */
+    ui32Checksum = (~ui32Checksum);
+
+    /* swap bytes order */
+    ui32Checksum = SWAP_BYTES_ORDER_16BIT_((uint16)ui32Checksum);
+
+    return (uint16)ui32Checksum;
+}
+
+
+LOCAL uint16 kernelOldUDP( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    return oldUDPChecksum(pui8Src, ui16Length);
+}
+
+
+LOCAL uint16 kernelOldIPv4( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    return oldIPv4Checksum(pui8Src, ui16Length);
+}
+
+
+LOCAL uint16 kernelAccumulate( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    return CHKSUM_getChecksum(CHKSUM_accumulate(UL_NULL, pui8Src, ui16Length));
+}
+
+
+/* copy then sum the copied data, as the old UDP send path did */
+LOCAL uint16 kernelCopyOldUDP( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    MEM_COPY(pui8Dst, pui8Src, ui16Length);
+
+    return oldUDPChecksum(pui8Dst, ui16Length);
+}
+
+
+LOCAL uint16 kernelCopyAccumulate( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    MEM_COPY(pui8Dst, pui8Src, ui16Length);
+
+    return CHKSUM_getChecksum(CHKSUM_accumulate(UL_NULL, pui8Dst, ui16Length));
+}
+
+
+LOCAL uint16 kernelCopyAndAccumulate( uint8 *pui8Dst, const uint8 *pui8Src, uint16 ui16Length )
+{
+    return CHKSUM_getChecksum(CHKSUM_copyAndAccumulate(pui8Dst, pui8Src, ui16Length, UL_NULL));
+}
+
+
+/* measure a kernel in MB/s for the given source and destination offset and data length */
+LOCAL double measureKernel( pf_Kernel pfKernel, uint8 ui8Offset, uint16 ui16Length )
+{
+    uint64 ui64StartTime;
+    uint64 ui64ElapsedTime;
+    uint32 ui32RunsNum = (uint32)(ULL_BYTES_PER_MEASURE / ui16Length);
+    uint32 ui32Run;
+    uint16 ui16Result = US_NULL;
+    uint8 *pui8Src = (uint8 *)aui32SrcData + ui8Offset;
+    uint8 *pui8Dst = (uint8 *)aui32DstData + ui8Offset;
+
+    ui64StartTime = SIM_getTimeNs();
+
+    for(ui32Run = UL_NULL; ui32Run < ui32RunsNum; ui32Run++)
+    {
+        ui16Result ^= pfKernel(pui8Dst, pui8Src, ui16Length);
+    }
+
+    ui64ElapsedTime = SIM_getTimeNs() - ui64StartTime;
+    ui16Sink = ui16Result;
+
+    return (((double)ui32RunsNum * ui16Length * 1e3) / (double)ui64ElapsedTime);
+}
+
+
+
+
+/* End of file */
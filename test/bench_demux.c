@@ -0,0 +1,266 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file bench_demux.c represents the host benchmark of the UDP sockets demultiplexer.
+ * Lookups per second of the hash table are measured while the num of open sockets goes
+ * from 8 to UDP_US_MAX_NUM_OF_SOCKETS, against the linear scan of all the sockets it replaced.
+ * The UDP module is built in this file to reach its local functions.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+
+/* UDP module under test */
+#include "framework/sal/udp/udp.c"
+
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* first num of open sockets: it is doubled at each step */
+#define US_FIRST_SOCKETS_NUM            ((uint16)8)
+
+/* num of looked up keys, taken at random among the open sockets */
+#define US_KEYS_NUM                     ((uint16)4096)
+
+/* num of lookups of each measure */
+#define UL_HASH_LOOKUPS_NUM             ((uint32)4000000)
+#define UL_LINEAR_LOOKUPS_NUM           ((uint32)400000)
+
+/* sockets addresses and ports */
+#define UL_REMOTE_IP_ADD_BASE           (SIM_UL_REMOTE_IP_ADD)
+#define UC_REMOTE_IP_ADD_NUM            ((uint8)16)
+#define US_LOCAL_PORT_BASE              ((uint16)10000)
+#define US_REMOTE_PORT_BASE             ((uint16)20000)
+
+
+
+
+/* ------------- Local types ----------------- */
+
+/* lookup key of a received datagram */
+typedef struct
+{
+    uint32 ui32SrcIPAdd;
+    uint16 ui16SrcPort;
+    uint16 ui16DstPort;
+    uint16 ui16SktIdx;              /* expected socket */
+} st_LookupKey;
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+LOCAL st_LookupKey astKeys[US_KEYS_NUM];
+
+/* lookups result sink: it keeps lookups from being optimized out */
+LOCAL volatile uint32 ui32Sink;
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL void      openSockets         (uint16);
+LOCAL void      closeSockets        (uint16);
+LOCAL uint16    linearSocketIndex   (uint32, uint32, uint16, uint16);
+LOCAL boolean   checkLookups        (void);
+LOCAL double    measureLookups      (boolean, uint32);
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+int main( void )
+{
+    uint16 ui16SocketsNum;
+    double dHashRate;
+    double dLinearRate;
+    boolean bSuccess = B_TRUE;
+
+    SIM_Init();
+
+    printf("UDP demux: %u sockets max, %u hash buckets\n", UDP_US_MAX_NUM_OF_SOCKETS, UDP_US_SOCKET_HASH_TABLE_SIZE);
+    printf("%8s %16s %16s %8s\n", "sockets", "hash lookups/s", "linear lookups/s", "speedup");
+
+    for(ui16SocketsNum = US_FIRST_SOCKETS_NUM; ui16SocketsNum <= UDP_US_MAX_NUM_OF_SOCKETS; ui16SocketsNum *= US_2)
+    {
+        openSockets(ui16SocketsNum);
+
+        if(B_TRUE == checkLookups())
+        {
+            dHashRate = measureLookups(B_TRUE, UL_HASH_LOOKUPS_NUM);
+            dLinearRate = measureLookups(B_FALSE, UL_LINEAR_LOOKUPS_NUM);
+
+            printf("%8u %16.0f %16.0f %7.1fx\n", ui16SocketsNum, dHashRate, dLinearRate, (dHashRate / dLinearRate));
+        }
+        else
+        {
+            printf("%8u lookup mismatch\n", ui16SocketsNum);
+            bSuccess = B_FALSE;
+        }
+
+        closeSockets(ui16SocketsNum);
+    }
+
+    return ((B_TRUE == bSuccess) ? 0 : 1);
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* open the given num of connected sockets and prepare the lookup keys */
+LOCAL void openSockets( uint16 ui16SocketsNum )
+{
+    uint16 ui16SktIdx;
+    uint16 ui16KeyIdx;
+
+    for(ui16SktIdx = US_NULL; ui16SktIdx < ui16SocketsNum; ui16SktIdx++)
+    {
+        (void)UDP_OpenUDPSocket((UDP_keSocketNum)ui16SktIdx,
+                                SIM_UL_LOCAL_IP_ADD,
+                                (UL_REMOTE_IP_ADD_BASE + (ui16SktIdx % UC_REMOTE_IP_ADD_NUM)),
+                                (US_LOCAL_PORT_BASE + ui16SktIdx),
+                                (US_REMOTE_PORT_BASE + ui16SktIdx));
+    }
+
+    for(ui16KeyIdx = US_NULL; ui16KeyIdx < US_KEYS_NUM; ui16KeyIdx++)
+    {
+        ui16SktIdx = (uint16)(SIM_getRandom() % ui16SocketsNum);
+
+        astKeys[ui16KeyIdx].ui32SrcIPAdd = (UL_REMOTE_IP_ADD_BASE + (ui16SktIdx % UC_REMOTE_IP_ADD_NUM));
+        astKeys[ui16KeyIdx].ui16SrcPort = (US_REMOTE_PORT_BASE + ui16SktIdx);
+        astKeys[ui16KeyIdx].ui16DstPort = (US_LOCAL_PORT_BASE + ui16SktIdx);
+        astKeys[ui16KeyIdx].ui16SktIdx = ui16SktIdx;
+    }
+}
+
+
+/* close the given num of sockets */
+LOCAL void closeSockets( uint16 ui16SocketsNum )
+{
+    uint16 ui16SktIdx;
+
+    for(ui16SktIdx = US_NULL; ui16SktIdx < ui16SocketsNum; ui16SktIdx++)
+    {
+        (void)UDP_CloseUDPSocket((UDP_keSocketNum)ui16SktIdx);
+    }
+}
+
+
+/* linear scan of all the sockets, as getSocketIndex() did before the hash table */
+LOCAL uint16 linearSocketIndex( uint32 ui32SourceAdd, uint32 ui32DestAdd, uint16 ui16SourcePort, uint16 ui16DestPort )
+{
+    uint16 ui16SktIdx = US_NULL;
+
+    while((ui16SktIdx < UDP_SOCKET_MAX_NUM)
+    &&    (   (stUDPSocketInfo[ui16SktIdx].bSocketOpen != B_TRUE)
+           || ((stUDPSocketInfo[ui16SktIdx].ui32IPSrcAddress != ui32DestAdd) && (stUDPSocketInfo[ui16SktIdx].ui32IPSrcAddress != 0x00000000))
+           || ((stUDPSocketInfo[ui16SktIdx].ui32IPDstAddress != ui32SourceAdd) && (stUDPSocketInfo[ui16SktIdx].ui32IPDstAddress != 0xFFFFFFFF))
+           || (stUDPSocketInfo[ui16SktIdx].ui16UDPSrcPort != ui16DestPort)
+           || (stUDPSocketInfo[ui16SktIdx].ui16UDPDstPort != ui16SourcePort)))
+    {
+        ui16SktIdx++;
+    }
+
+    return ui16SktIdx;
+}
+
+
+/* check that both lookups find the expected socket of each key */
+LOCAL boolean checkLookups( void )
+{
+    boolean bSuccess = B_TRUE;
+    uint16 ui16KeyIdx;
+    st_LookupKey *pstKey;
+
+    for(ui16KeyIdx = US_NULL; ui16KeyIdx < US_KEYS_NUM; ui16KeyIdx++)
+    {
+        pstKey = &astKeys[ui16KeyIdx];
+
+        if((getSocketIndex(pstKey->ui32SrcIPAdd, SIM_UL_LOCAL_IP_ADD, pstKey->ui16SrcPort, pstKey->ui16DstPort) != pstKey->ui16SktIdx)
+        || (linearSocketIndex(pstKey->ui32SrcIPAdd, SIM_UL_LOCAL_IP_ADD, pstKey->ui16SrcPort, pstKey->ui16DstPort) != pstKey->ui16SktIdx))
+        {
+            bSuccess = B_FALSE;
+        }
+        else
+        {
+            /* expected socket */
+        }
+    }
+
+    return bSuccess;
+}
+
+
+/* measure lookups per second of the hash table or of the linear scan */
+LOCAL double measureLookups( boolean bHashLookup, uint32 ui32LookupsNum )
+{
+    uint64 ui64StartTime;
+    uint64 ui64ElapsedTime;
+    uint32 ui32LookupIdx;
+    uint32 ui32Sum = UL_NULL;
+    st_LookupKey *pstKey;
+
+    ui64StartTime = SIM_getTimeNs();
+
+    for(ui32LookupIdx = UL_NULL; ui32LookupIdx < ui32LookupsNum; ui32LookupIdx++)
+    {
+        pstKey = &astKeys[ui32LookupIdx % US_KEYS_NUM];
+
+        if(B_TRUE == bHashLookup)
+        {
+            ui32Sum += getSocketIndex(pstKey->ui32SrcIPAdd, SIM_UL_LOCAL_IP_ADD, pstKey->ui16SrcPort, pstKey->ui16DstPort);
+        }
+        else
+        {
+            ui32Sum += linearSocketIndex(pstKey->ui32SrcIPAdd, SIM_UL_LOCAL_IP_ADD, pstKey->ui16SrcPort, pstKey->ui16DstPort);
+        }
+    }
+
+    ui64ElapsedTime = SIM_getTimeNs() - ui64StartTime;
+    ui32Sink = ui32Sum;
+
+    return (((double)ui32LookupsNum * 1e9) / (double)ui64ElapsedTime);
+}
+
+
+
+
+/* End of file */
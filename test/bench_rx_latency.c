@@ -0,0 +1,257 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+/*
+ * This file bench_rx_latency.c represents the host benchmark of the latency from a received frame to
+ * the application handler. Frames are injected at a random phase of the RTOS tasks period and delivered
+ * either to a socket receive callback, called from the RX notify event, or to an application task that
+ * polls the socket every RTOS_UL_TASKS_PERIOD_MS. Latency is given in simulated time, with the resolution
+ * of the RTOS tick, and in host time from the injection to the callback.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include <stdlib.h>
+#include "framework/fw_common.h"
+#include "framework/sal/udp/udp.h"
+#include "framework/sal/rtos/rtos.h"
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* local port of the socket under test */
+#define US_LOCAL_PORT                   ((uint16)7000)
+
+/* num of measured frames of each path */
+#define US_SAMPLES_NUM                  ((uint16)2000)
+
+/* datagram data length */
+#define US_DATA_LENGTH                  ((uint16)32)
+
+/* RTOS tick and tasks period in ticks */
+#define UL_TICK_PERIOD_MS               (RTOS_UL_TICK_PERIOD_US / UL_1000)
+#define UL_TASKS_PERIOD_TICKS           (RTOS_UL_TASKS_PERIOD_MS / UL_TICK_PERIOD_MS)
+
+/* max simulated time waited for a frame */
+#define UL_MAX_WAIT_MS                  ((uint32)1000)
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+/* simulated time in ms */
+LOCAL uint32 ui32SimTimeMs = UL_NULL;
+
+/* delivery of the current frame: flag, simulated and host time */
+LOCAL boolean bDelivered;
+LOCAL uint32 ui32DeliveryTimeMs;
+LOCAL uint64 ui64DeliveryTimeNs;
+
+/* measured latencies */
+LOCAL uint64 aui64LatencyMs[US_SAMPLES_NUM];
+LOCAL uint64 aui64LatencyNs[US_SAMPLES_NUM];
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL void      rxCallback          (UDP_keSocketNum, uint32, uint16, uint8 *, uint16);
+LOCAL void      appPollTask         (void);
+LOCAL void      elapseTicks         (uint32);
+LOCAL boolean   measurePath         (void);
+LOCAL int       compareSamples      (const void *, const void *);
+LOCAL uint64    getPercentile       (uint64 *, uint8);
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+int main( void )
+{
+    boolean bSuccess;
+
+    SIM_Init();
+    (void)UDP_OpenUDPSocket(UDP_SOCKET_1, SIM_UL_LOCAL_IP_ADD, SIM_UL_REMOTE_IP_ADD, US_LOCAL_PORT, 5000);
+
+    printf("RX latency, frame injection to application handler: %u frames, %u ms tick, %u ms tasks period\n",
+           US_SAMPLES_NUM, (uint32)UL_TICK_PERIOD_MS, RTOS_UL_TASKS_PERIOD_MS);
+    printf("%-22s %8s %8s %8s %10s %10s\n", "", "p50 ms", "p99 ms", "max ms", "p50 us", "p99 us");
+
+    /* socket receive callback called from the RX notify event */
+    (void)UDP_setRXCallback(UDP_SOCKET_1, &rxCallback);
+    SIM_setAppTask(NULL_PTR);
+    bSuccess = measurePath();
+    printf("%-22s %8llu %8llu %8llu %10.2f %10.2f\n", "RX callback (event)",
+           getPercentile(aui64LatencyMs, 50), getPercentile(aui64LatencyMs, 99), getPercentile(aui64LatencyMs, 100),
+           (getPercentile(aui64LatencyNs, 50) / 1e3), (getPercentile(aui64LatencyNs, 99) / 1e3));
+
+    /* application task polling the socket */
+    (void)UDP_setRXCallback(UDP_SOCKET_1, NULL_PTR);
+    SIM_setAppTask(&appPollTask);
+    if(B_TRUE != measurePath())
+    {
+        bSuccess = B_FALSE;
+    }
+    else
+    {
+        /* all frames delivered */
+    }
+    printf("%-22s %8llu %8llu %8llu %10s %10s\n", "app task polling",
+           getPercentile(aui64LatencyMs, 50), getPercentile(aui64LatencyMs, 99), getPercentile(aui64LatencyMs, 100), "-", "-");
+
+    return ((B_TRUE == bSuccess) ? 0 : 1);
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* socket receive callback: record the delivery */
+LOCAL void rxCallback( UDP_keSocketNum unSocketNum, uint32 ui32SrcIPAdd, uint16 ui16SrcPort, uint8 *pui8Data, uint16 ui16DataLength )
+{
+    ui64DeliveryTimeNs = SIM_getTimeNs();
+    ui32DeliveryTimeMs = ui32SimTimeMs;
+    bDelivered = B_TRUE;
+}
+
+
+/* application task: poll the socket and record the delivery */
+LOCAL void appPollTask( void )
+{
+    uint8 *pui8Data;
+    uint16 ui16DataLength;
+
+    if(UDP_OP_OK == UDP_getNextRXData(UDP_SOCKET_1, &pui8Data, &ui16DataLength))
+    {
+        ui64DeliveryTimeNs = SIM_getTimeNs();
+        ui32DeliveryTimeMs = ui32SimTimeMs;
+        bDelivered = B_TRUE;
+
+        UDP_releaseRXData(UDP_SOCKET_1);
+    }
+    else
+    {
+        /* no data */
+    }
+}
+
+
+/* let the given num of RTOS ticks elapse */
+LOCAL void elapseTicks( uint32 ui32TicksNum )
+{
+    SIM_tick(ui32TicksNum * UL_TICK_PERIOD_MS);
+    ui32SimTimeMs += (ui32TicksNum * UL_TICK_PERIOD_MS);
+}
+
+
+/* inject frames at a random phase of the tasks period and measure their latency */
+LOCAL boolean measurePath( void )
+{
+    boolean bSuccess = B_TRUE;
+    uint8 aui8Data[US_DATA_LENGTH];
+    uint8 aui8Frame[SIM_US_MAX_FRAME_LENGTH];
+    uint16 ui16FrameLength;
+    uint16 ui16Sample;
+    uint32 ui32InjectionTimeMs;
+    uint64 ui64InjectionTimeNs;
+
+    memset(aui8Data, 0x5A, US_DATA_LENGTH);
+
+    for(ui16Sample = US_NULL; ui16Sample < US_SAMPLES_NUM; ui16Sample++)
+    {
+        /* random phase */
+        elapseTicks(SIM_getRandom() % UL_TASKS_PERIOD_TICKS);
+
+        ui16FrameLength = SIM_buildUDPFrame(aui8Frame, US_LOCAL_PORT, ui16Sample, aui8Data, US_DATA_LENGTH);
+        bDelivered = B_FALSE;
+        ui32InjectionTimeMs = ui32SimTimeMs;
+        ui64InjectionTimeNs = SIM_getTimeNs();
+
+        (void)SIM_injectFrame(aui8Frame, ui16FrameLength);
+
+        /* the main loop runs right after the interrupt, then at each tick */
+        SIM_runMainLoop();
+        while((B_TRUE != bDelivered)
+        &&    ((ui32SimTimeMs - ui32InjectionTimeMs) < UL_MAX_WAIT_MS))
+        {
+            elapseTicks(UL_1);
+        }
+
+        if(B_TRUE == bDelivered)
+        {
+            aui64LatencyMs[ui16Sample] = (uint64)(ui32DeliveryTimeMs - ui32InjectionTimeMs);
+            aui64LatencyNs[ui16Sample] = ui64DeliveryTimeNs - ui64InjectionTimeNs;
+        }
+        else
+        {
+            /* frame lost */
+            aui64LatencyMs[ui16Sample] = UL_MAX_WAIT_MS;
+            aui64LatencyNs[ui16Sample] = ULL_NULL;
+            bSuccess = B_FALSE;
+        }
+    }
+
+    return bSuccess;
+}
+
+
+/* samples compare function for qsort */
+LOCAL int compareSamples( const void *pvFirst, const void *pvSecond )
+{
+    uint64 ui64First = *(const uint64 *)pvFirst;
+    uint64 ui64Second = *(const uint64 *)pvSecond;
+
+    return ((ui64First > ui64Second) - (ui64First < ui64Second));
+}
+
+
+/* get the given percentile of the samples. Samples are sorted */
+LOCAL uint64 getPercentile( uint64 *pui64Samples, uint8 ui8Percentile )
+{
+    uint16 ui16Idx = (uint16)(((uint32)(US_SAMPLES_NUM - US_1) * ui8Percentile) / 100);
+
+    qsort(pui64Samples, US_SAMPLES_NUM, sizeof(uint64), &compareSamples);
+
+    return pui64Samples[ui16Idx];
+}
+
+
+
+
+/* End of file */
@@ -0,0 +1,496 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file sim.c represents the host model of the ETHMAC hardware used by the test harness.
+ * The ETHMAC module is built in this file so that its interrupt service routine can be called
+ * by the model: frames are written into RX descriptors as the DMA does, TX descriptors are
+ * consumed and TX done is raised. RTOS tick timer and PHY are replaced as well.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include <time.h>
+
+/* ETHMAC module under test. PHY prototype is given first since the module does not include it */
+#include "framework/hal/ethphy.h"
+#include "framework/hal/ethmac.c"
+
+#include "framework/hal/tmr.h"
+#include "framework/sal/rtos/rtos.h"
+#include "framework/sal/udp/arp.h"
+#include "framework/sal/udp/ipv4.h"
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* RTOS ticks in ms */
+#define UL_TICK_PERIOD_MS               (RTOS_UL_TICK_PERIOD_US / UL_1000)
+
+/* IPv4 header fields values */
+#define UC_IPV4_VERSION_IHL             ((uint8)0x45)
+#define UC_IPV4_TIME_TO_LIVE            ((uint8)64)
+#define US_IPV4_MORE_FRAGMENTS_FLAG     ((uint16)0x2000)
+
+/* Ethernet type of IPv4 */
+#define US_ETH_TYPE_IPV4_VALUE          ((uint16)0x0800)
+
+/* UDP ports of the frames built by SIM_buildUDPFrame */
+#define US_REMOTE_PORT                  ((uint16)5000)
+
+
+
+
+/* ---------- Registers of the ETHMAC module ---------- */
+
+volatile unsigned int EMAC1CFG1CLR;
+volatile unsigned int EMAC1CFG1SET;
+volatile unsigned int EMAC1CFG2CLR;
+volatile unsigned int EMAC1CFG2SET;
+volatile unsigned int EMAC1CLRTCLR;
+volatile unsigned int EMAC1CLRTSET;
+volatile unsigned int EMAC1IPGRCLR;
+volatile unsigned int EMAC1IPGRSET;
+volatile unsigned int EMAC1IPGT;
+volatile unsigned int EMAC1MAXF;
+volatile unsigned int EMAC1SA0;
+volatile unsigned int EMAC1SA1;
+volatile unsigned int EMAC1SA2;
+volatile unsigned int ETHCON1;
+volatile unsigned int ETHCON1CLR;
+volatile unsigned int ETHCON1SET;
+volatile unsigned int ETHCON2;
+volatile unsigned int ETHIEN;
+volatile unsigned int ETHIENSET;
+volatile unsigned int ETHIRQ;
+volatile unsigned int ETHIRQCLR;
+volatile unsigned int ETHPMCS;
+volatile unsigned int ETHPMM0;
+volatile unsigned int ETHPMM1;
+volatile unsigned int ETHPMO;
+volatile unsigned int ETHRXFCCLR;
+volatile unsigned int ETHRXFCSET;
+volatile unsigned int ETHRXST;
+volatile unsigned int ETHRXWMCLR;
+volatile unsigned int ETHRXWMSET;
+volatile unsigned int ETHSTAT;
+volatile unsigned int ETHTXST;
+volatile unsigned int IEC1CLR;
+volatile unsigned int IEC1SET;
+volatile unsigned int IFS1CLR;
+volatile unsigned int IPC12SET;
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL void      runAppTask          (void);
+LOCAL uint16    getChecksum         (uint32, const uint8 *, uint16);
+LOCAL void      writeBigEndian16    (uint8 *, uint16);
+LOCAL void      writeBigEndian32    (uint8 *, uint32);
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+/* next RX descriptor written by the model */
+LOCAL uint8 ui8HWRXIdx = UC_NULL;
+
+/* num of frames sent by the model */
+LOCAL uint32 ui32TXFramesCnt = UL_NULL;
+
+/* pseudo random generator state */
+LOCAL uint32 ui32RandomState = 0x12345678;
+
+/* application task set by the test, if any */
+LOCAL SIM_pfAppTask pfAppTask = NULL_PTR;
+
+/* tasks of the RTOS normal state: modules not under test are left out */
+LOCAL task_ptr_t const astNormalStateTasks[] =
+{
+    &ARP_PeriodicTask,
+    &IPV4_PeriodicTask,
+    &runAppTask,
+    NULL_PTR
+};
+
+/* no tasks in other states */
+LOCAL task_ptr_t const astNoTasks[] =
+{
+    NULL_PTR
+};
+
+
+
+
+/* ------------ Exported Variables ----------------- */
+
+/* RTOS states array: the RTOS runs in normal state only */
+rtos_state_t * const RTOS_CFG_statesArray_at[RTOS_CFG_KE_STATE_MAX_NUM] =
+{
+    astNoTasks
+   ,astNormalStateTasks
+   ,astNoTasks
+};
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+/* Init ETHMAC hardware model, ETHMAC and IPv4 modules and the RTOS. The local IP address is SIM_UL_LOCAL_IP_ADD */
+EXPORTED void SIM_Init( void )
+{
+    (void)ETHMAC_Init();
+    (void)IPV4_Init();
+    IPV4_setLocalIPAddress(SIM_UL_LOCAL_IP_ADD);
+    RTOS_startOperation(RTOS_CFG_KE_NORMAL_STATE);
+
+    /* ATTENTION: descriptors store 32-bit addresses */
+    if(((unsigned long)stRXArrayDcpt > UL_MAX_ULONG)
+    || ((unsigned long)apui8RXDcptDataBuffers[UC_0] > UL_MAX_ULONG))
+    {
+        printf("SIM: ETHMAC memory is not below 4 GB, link the harness with -no-pie\n");
+        exit(1);
+    }
+    else
+    {
+        /* addresses fit in descriptors */
+    }
+}
+
+
+/* write a frame into the next RX descriptor as the DMA does and raise RX done interrupt.
+   Return B_FALSE if no descriptor is owned by hardware: the frame is lost */
+EXPORTED boolean SIM_injectFrame( const uint8 *pui8Frame, uint16 ui16Length )
+{
+    boolean bInjected = B_FALSE;
+    st_RXEthDcpt *pstDcpt = &stRXArrayDcpt[ui8HWRXIdx];
+    uint8 *pui8Buffer;
+
+    if((pstDcpt->hdr.flags.EOWN == 1)
+    && ((ui16Length + UC_ETH_FCS_LENGTH) <= US_DATA_BUFFER_LENGTH))
+    {
+        pui8Buffer = (uint8 *)PA_TO_KVA1((uint32)pstDcpt->pEDBuff);
+        MEM_COPY(pui8Buffer, pui8Frame, ui16Length);
+
+        /* frame received OK in a single descriptor. Received bytes count includes the FCS. Payload checksum is the
+           one's complement sum, not inverted, of the bytes after the Ethernet header, as 16-bit big-endian words */
+        pstDcpt->stat.s = 0;
+        pstDcpt->stat.rxstat.RX_Bytes = ui16Length + UC_ETH_FCS_LENGTH;
+        pstDcpt->stat.rxstat.PKT_Checksum = (uint16)~getChecksum(UL_NULL, &pui8Frame[SIM_UC_ETH_HDR_LENGTH], (uint16)(ui16Length - SIM_UC_ETH_HDR_LENGTH));
+        pstDcpt->stat.rxstat.RSV = (1 << RXSTAT_RX_OK_BIT_POS);
+        pstDcpt->hdr.flags.SOP = 1;
+        pstDcpt->hdr.flags.EOP = 1;
+        pstDcpt->hdr.flags.EOWN = 0;
+
+        ui8HWRXIdx = GET_RX_RING_IDX(ui8HWRXIdx + UC_1);
+
+        /* raise RX done interrupt */
+        ETHIRQ = (1 << ETHIRQ_RXDONE_BIT_POS);
+        Eth_IntHandler();
+        ETHIRQ = 0;
+
+        bInjected = B_TRUE;
+    }
+    else
+    {
+        /* no RX descriptor available */
+    }
+
+    return bInjected;
+}
+
+
+/* send all the frames started by the ETHMAC module raising TX done interrupt at the end of each one */
+EXPORTED void SIM_serveTX( void )
+{
+    st_TXEthDcpt *pstDcpt;
+
+    /* the ETHMAC module starts the next frame from the TX done interrupt */
+    while((B_TRUE == bTXActive)
+    &&    (((st_TXEthDcpt *)PA_TO_KVA1(ETHTXST))->hdr.EOWN == 1))
+    {
+        /* give all the frame descriptors back */
+        pstDcpt = (st_TXEthDcpt *)PA_TO_KVA1(ETHTXST);
+        while(pstDcpt->hdr.EOP != 1)
+        {
+            pstDcpt->hdr.EOWN = 0;
+            pstDcpt = (st_TXEthDcpt *)PA_TO_KVA1(pstDcpt->next_ed);
+        }
+        pstDcpt->hdr.EOWN = 0;
+        ui32TXFramesCnt++;
+
+        /* raise TX done interrupt */
+        ETHIRQ = (1 << ETHIRQ_TXDONE_BIT_POS);
+        Eth_IntHandler();
+        ETHIRQ = 0;
+    }
+}
+
+
+/* get the num of frames sent by the model */
+EXPORTED uint32 SIM_getTXFramesCount( void )
+{
+    return ui32TXFramesCnt;
+}
+
+
+/* run the main loop once: tasks are executed if the RTOS time base is elapsed, signalled events are managed */
+EXPORTED void SIM_runMainLoop( void )
+{
+    RTOS_executeTask();
+}
+
+
+/* set the application task run by the RTOS after the stack tasks. NULL_PTR to remove it */
+EXPORTED void SIM_setAppTask( SIM_pfAppTask pfTask )
+{
+    pfAppTask = pfTask;
+}
+
+
+/* let the given time in ms elapse running the main loop at each RTOS tick */
+EXPORTED void SIM_tick( uint32 ui32TimeMs )
+{
+    uint32 ui32Ticks;
+
+    for(ui32Ticks = (ui32TimeMs / UL_TICK_PERIOD_MS); ui32Ticks > UL_NULL; ui32Ticks--)
+    {
+        RTOS_TickTimerCallback();
+        RTOS_executeTask();
+        SIM_serveTX();
+    }
+}
+
+
+/* build a UDP datagram with its checksum. Return the datagram length */
+EXPORTED uint16 SIM_buildUDPDatagram( uint8 *pui8Datagram, uint32 ui32SrcIPAdd, uint32 ui32DstIPAdd, uint16 ui16SrcPort, uint16 ui16DstPort, const uint8 *pui8Data, uint16 ui16DataLength )
+{
+    uint16 ui16UDPLength = (uint16)(SIM_UC_UDP_HDR_LENGTH + ui16DataLength);
+    uint8 aui8PseudoHeader[12];
+    uint16 ui16Checksum;
+
+    writeBigEndian16(&pui8Datagram[0], ui16SrcPort);
+    writeBigEndian16(&pui8Datagram[2], ui16DstPort);
+    writeBigEndian16(&pui8Datagram[4], ui16UDPLength);
+    writeBigEndian16(&pui8Datagram[6], US_NULL);
+    MEM_COPY(&pui8Datagram[SIM_UC_UDP_HDR_LENGTH], pui8Data, ui16DataLength);
+
+    /* pseudo header: addresses, protocol and UDP length */
+    writeBigEndian32(&aui8PseudoHeader[0], ui32SrcIPAdd);
+    writeBigEndian32(&aui8PseudoHeader[4], ui32DstIPAdd);
+    aui8PseudoHeader[8] = UC_NULL;
+    aui8PseudoHeader[9] = SIM_UC_PROTOCOL_UDP;
+    writeBigEndian16(&aui8PseudoHeader[10], ui16UDPLength);
+
+    ui16Checksum = getChecksum((uint32)(uint16)~getChecksum(UL_NULL, aui8PseudoHeader, sizeof(aui8PseudoHeader)), pui8Datagram, ui16UDPLength);
+    /* 0 means no checksum */
+    writeBigEndian16(&pui8Datagram[6], ((US_NULL == ui16Checksum) ? 0xFFFF : ui16Checksum));
+
+    return ui16UDPLength;
+}
+
+
+/* build an Ethernet frame carrying an IPv4 packet or fragment with the given payload. Return the frame length */
+EXPORTED uint16 SIM_buildIPv4Frame( uint8 *pui8Frame, const SIM_st_IPv4Params *pstParams, const uint8 *pui8Payload, uint16 ui16PayloadLength )
+{
+    uint8 *pui8Header = &pui8Frame[SIM_UC_ETH_HDR_LENGTH];
+
+    /* Ethernet header: broadcast destination, any source */
+    memset(&pui8Frame[0], 0xFF, ETHMAC_UC_ETH_ADD_LENGTH);
+    memset(&pui8Frame[ETHMAC_UC_ETH_ADD_LENGTH], 0x02, ETHMAC_UC_ETH_ADD_LENGTH);
+    writeBigEndian16(&pui8Frame[12], US_ETH_TYPE_IPV4_VALUE);
+
+    /* IPv4 header without options */
+    pui8Header[0] = UC_IPV4_VERSION_IHL;
+    pui8Header[1] = UC_NULL;
+    writeBigEndian16(&pui8Header[2], (uint16)(SIM_UC_IPV4_HDR_LENGTH + ui16PayloadLength));
+    writeBigEndian16(&pui8Header[4], pstParams->ui16Identifier);
+    writeBigEndian16(&pui8Header[6], (uint16)((pstParams->ui16FragOffset / UC_8) | ((B_TRUE == pstParams->bMoreFragments) ? US_IPV4_MORE_FRAGMENTS_FLAG : US_NULL)));
+    pui8Header[8] = UC_IPV4_TIME_TO_LIVE;
+    pui8Header[9] = pstParams->ui8Protocol;
+    writeBigEndian16(&pui8Header[10], US_NULL);
+    writeBigEndian32(&pui8Header[12], pstParams->ui32SrcIPAdd);
+    writeBigEndian32(&pui8Header[16], pstParams->ui32DstIPAdd);
+    writeBigEndian16(&pui8Header[10], getChecksum(UL_NULL, pui8Header, SIM_UC_IPV4_HDR_LENGTH));
+
+    MEM_COPY(&pui8Header[SIM_UC_IPV4_HDR_LENGTH], pui8Payload, ui16PayloadLength);
+
+    return (uint16)(SIM_UC_ETH_HDR_LENGTH + SIM_UC_IPV4_HDR_LENGTH + ui16PayloadLength);
+}
+
+
+/* build an Ethernet frame carrying an unfragmented UDP datagram from the remote host to the local one.
+   Return the frame length */
+EXPORTED uint16 SIM_buildUDPFrame( uint8 *pui8Frame, uint16 ui16LocalPort, uint16 ui16Identifier, const uint8 *pui8Data, uint16 ui16DataLength )
+{
+    uint8 aui8Datagram[SIM_US_MAX_FRAME_LENGTH];
+    SIM_st_IPv4Params stParams;
+    uint16 ui16DatagramLength;
+
+    ui16DatagramLength = SIM_buildUDPDatagram(aui8Datagram, SIM_UL_REMOTE_IP_ADD, SIM_UL_LOCAL_IP_ADD, US_REMOTE_PORT, ui16LocalPort, pui8Data, ui16DataLength);
+
+    stParams.ui32SrcIPAdd = SIM_UL_REMOTE_IP_ADD;
+    stParams.ui32DstIPAdd = SIM_UL_LOCAL_IP_ADD;
+    stParams.ui8Protocol = SIM_UC_PROTOCOL_UDP;
+    stParams.ui16Identifier = ui16Identifier;
+    stParams.ui16FragOffset = US_NULL;
+    stParams.bMoreFragments = B_FALSE;
+
+    return SIM_buildIPv4Frame(pui8Frame, &stParams, aui8Datagram, ui16DatagramLength);
+}
+
+
+/* get the host monotonic time in ns */
+EXPORTED uint64 SIM_getTimeNs( void )
+{
+    struct timespec stTime;
+
+    clock_gettime(CLOCK_MONOTONIC, &stTime);
+
+    return (((uint64)stTime.tv_sec * 1000000000ULL) + (uint64)stTime.tv_nsec);
+}
+
+
+/* get a pseudo random number (xorshift). The sequence is the same at each run */
+EXPORTED uint32 SIM_getRandom( void )
+{
+    ui32RandomState ^= (ui32RandomState << 13);
+    ui32RandomState ^= (ui32RandomState >> 17);
+    ui32RandomState ^= (ui32RandomState << 5);
+
+    return ui32RandomState;
+}
+
+
+
+
+/* ------------- Replaced hardware modules ----------------- */
+
+/* external PHY is always ready */
+EXPORTED boolean ETHPHY_Init( void )
+{
+    return B_TRUE;
+}
+
+
+/* RTOS tick timer is driven by SIM_tick */
+EXPORTED void TMR_TickTimerStart( void )
+{
+}
+
+
+EXPORTED void TMR_TickTimerStop( void )
+{
+}
+
+
+EXPORTED uint16 TMR_getTimerCounter( void )
+{
+    return US_NULL;
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* run the application task if any */
+LOCAL void runAppTask( void )
+{
+    if(pfAppTask != NULL_PTR)
+    {
+        (*pfAppTask)();
+    }
+    else
+    {
+        /* no application task */
+    }
+}
+
+
+/* Internet checksum of a buffer starting from a not inverted partial sum. Reference implementation
+   independent from the stack one */
+LOCAL uint16 getChecksum( uint32 ui32Sum, const uint8 *pui8Data, uint16 ui16Length )
+{
+    uint16 ui16Index;
+
+    for(ui16Index = US_NULL; (ui16Index + US_1) < ui16Length; ui16Index += US_2)
+    {
+        ui32Sum += (((uint32)pui8Data[ui16Index] << UL_SHIFT_8) | pui8Data[ui16Index + US_1]);
+    }
+
+    /* odd length: last byte is padded with 0 */
+    if(ui16Index < ui16Length)
+    {
+        ui32Sum += ((uint32)pui8Data[ui16Index] << UL_SHIFT_8);
+    }
+    else
+    {
+        /* even length */
+    }
+
+    while((ui32Sum >> UL_SHIFT_16) != UL_NULL)
+    {
+        ui32Sum = (ui32Sum & 0xFFFF) + (ui32Sum >> UL_SHIFT_16);
+    }
+
+    return (uint16)~ui32Sum;
+}
+
+
+/* write a 16-bit value in network bytes order */
+LOCAL void writeBigEndian16( uint8 *pui8Dest, uint16 ui16Value )
+{
+    pui8Dest[0] = (uint8)(ui16Value >> UL_SHIFT_8);
+    pui8Dest[1] = (uint8)ui16Value;
+}
+
+
+/* write a 32-bit value in network bytes order */
+LOCAL void writeBigEndian32( uint8 *pui8Dest, uint32 ui32Value )
+{
+    pui8Dest[0] = (uint8)(ui32Value >> UL_SHIFT_24);
+    pui8Dest[1] = (uint8)(ui32Value >> UL_SHIFT_16);
+    pui8Dest[2] = (uint8)(ui32Value >> UL_SHIFT_8);
+    pui8Dest[3] = (uint8)ui32Value;
+}
+
+
+
+
+/* End of file */
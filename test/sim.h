@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+ * This file sim.h represents the inclusion file of the host model of the ETHMAC hardware
+ * used by the test harness.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+/* ------------ Inclusion files --------------- */
+#include "framework/fw_common.h"
+
+
+
+
+/* --------------- Exported defines ----------------- */
+
+/* Max length in bytes of a frame built or captured by the model, FCS excluded */
+#define SIM_US_MAX_FRAME_LENGTH             (1514)
+
+/* Ethernet, IPv4 and UDP headers length in bytes */
+#define SIM_UC_ETH_HDR_LENGTH               (14)
+#define SIM_UC_IPV4_HDR_LENGTH              (20)
+#define SIM_UC_UDP_HDR_LENGTH               (8)
+
+/* IPv4 protocol number of UDP */
+#define SIM_UC_PROTOCOL_UDP                 (17)
+
+/* Host IP addresses used by the tests */
+#define SIM_UL_LOCAL_IP_ADD                 ((uint32)0xC0A80102)    /* 192.168.1.2 */
+#define SIM_UL_REMOTE_IP_ADD                ((uint32)0xC0A80164)    /* 192.168.1.100 */
+
+
+
+
+/* --------------- Exported types ----------------- */
+
+/* application task type */
+typedef void (* SIM_pfAppTask)(void);
+
+/* IPv4 header fields of a built frame */
+typedef struct
+{
+    uint32 ui32SrcIPAdd;
+    uint32 ui32DstIPAdd;
+    uint8 ui8Protocol;
+    uint16 ui16Identifier;
+    uint16 ui16FragOffset;          /* in bytes: it shall be a multiple of 8 */
+    boolean bMoreFragments;
+} SIM_st_IPv4Params;
+
+
+
+
+/* -------------- Exported functions prototypes -------------- */
+
+EXTERN void     SIM_Init                (void);
+EXTERN boolean  SIM_injectFrame         (const uint8 *, uint16);
+EXTERN void     SIM_serveTX             (void);
+EXTERN uint32   SIM_getTXFramesCount    (void);
+EXTERN void     SIM_runMainLoop         (void);
+EXTERN void     SIM_setAppTask          (SIM_pfAppTask);
+EXTERN void     SIM_tick                (uint32);
+EXTERN uint16   SIM_buildUDPDatagram    (uint8 *, uint32, uint32, uint16, uint16, const uint8 *, uint16);
+EXTERN uint16   SIM_buildIPv4Frame      (uint8 *, const SIM_st_IPv4Params *, const uint8 *, uint16);
+EXTERN uint16   SIM_buildUDPFrame       (uint8 *, uint16, uint16, const uint8 *, uint16);
+EXTERN uint64   SIM_getTimeNs           (void);
+EXTERN uint32   SIM_getRandom           (void);
+
+
+
+
+/* End of file */
@@ -0,0 +1,9 @@
+/*
+ * Host stub of the XC32 attributes header for the test harness.
+ * Interrupt service routines are plain functions called by the ETHMAC hardware model.
+*/
+
+
+#define __ISR(v, ipl)               __attribute__((used))
+
+#define _ETH_VECTOR                 48
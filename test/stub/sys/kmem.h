@@ -0,0 +1,9 @@
+/*
+ * Host stub of the XC32 memory header for the test harness.
+ * Physical and virtual addresses are the same. ATTENTION: descriptors store 32-bit addresses, so the harness is
+ * linked as a non position independent executable to keep static data and heap below 4 GB.
+*/
+
+
+#define KVA_TO_PA(v)                ((unsigned long)(v))
+#define PA_TO_KVA1(pa)              ((void *)(unsigned long)(pa))
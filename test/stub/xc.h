@@ -0,0 +1,9 @@
+/*
+ * Host stub of the XC32 device header for the test harness.
+ * Registers are declared by the device header and defined as plain variables by the ETHMAC hardware model.
+*/
+
+
+#define __LANGUAGE_C__ 1
+
+#include "../../src/framework/hal/p32mx795f512l.h"
@@ -0,0 +1,538 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+/*
+ * This file test_reasm.c represents the host test of the IPv4 reassembly engine.
+ * UDP datagrams are fragmented, fragments of concurrent datagrams are shuffled together and replayed,
+ * with duplicates, and each datagram shall be delivered once and intact. A datagram whose fragments
+ * stop arriving shall expire. Late duplicates of re-assembled datagrams shall not hold the buffers
+ * needed by a large send. Reassembly throughput is then measured with in order and shuffled
+ * fragment streams.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "framework/fw_common.h"
+#include "framework/hal/ethmac.h"
+#include "framework/sal/udp/ipv4.h"
+#include "framework/sal/udp/udp.h"
+#include "framework/sal/udp/chksum.h"
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* local port of the socket under test */
+#define US_LOCAL_PORT                   ((uint16)7000)
+#define US_REMOTE_PORT                  ((uint16)5000)
+
+/* num of datagrams of the replay test and num of them reassembled at the same time: one for each context */
+#define US_REPLAY_DATAGRAMS_NUM         ((uint16)2000)
+#define UC_CONCURRENT_DATAGRAMS_NUM     ((uint8)IPV4_UC_REASM_MAX_CONTEXTS)
+
+/* max num of fragments of a datagram: the smallest fragment payload is 8 bytes */
+#define US_MAX_FRAGMENTS_NUM            ((uint16)((IPV4_US_MAX_PAYLOAD_LENGTH / 8) + 1))
+
+/* max num of frames of a stream: fragments of concurrent datagrams plus one duplicate each */
+#define US_MAX_STREAM_FRAMES_NUM        ((uint16)(UC_CONCURRENT_DATAGRAMS_NUM * (US_MAX_FRAGMENTS_NUM + 1)))
+
+/* frames injected between two main loop runs: the RX frames budget */
+#define UC_FRAMES_PER_RUN               (IPV4_UC_RX_FRAMES_BUDGET)
+
+/* num of datagrams of each throughput measure */
+#define UL_THROUGHPUT_DATAGRAMS_NUM     ((uint32)100000)
+
+/* datagram data length of the throughput measure */
+#define US_THROUGHPUT_DATA_LENGTH       ((uint16)UDP_MAX_DATA_LENGTH_ALLOWED)
+
+
+
+
+/* ------------- Local types ----------------- */
+
+/* built frame */
+typedef struct
+{
+    uint8 ui8Datagram;              /* index of the datagram in the stream */
+    uint16 ui16Length;
+    uint8 aui8Data[SIM_US_MAX_FRAME_LENGTH];
+} st_Frame;
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+/* frames of a stream */
+LOCAL st_Frame astStream[US_MAX_STREAM_FRAMES_NUM];
+LOCAL uint16 ui16StreamFramesNum;
+
+/* sent data of the concurrent datagrams */
+LOCAL uint8 aaui8SentData[UC_CONCURRENT_DATAGRAMS_NUM][UDP_MAX_DATA_LENGTH_ALLOWED];
+LOCAL uint16 aui16SentLength[UC_CONCURRENT_DATAGRAMS_NUM];
+
+/* received datagrams: num, bytes and num of them equal to a sent one */
+LOCAL uint32 ui32ReceivedNum;
+LOCAL uint32 ui32ReceivedBytes;
+LOCAL uint32 ui32MatchingNum;
+
+/* received data are checked against the sent ones */
+LOCAL boolean bCheckData;
+
+/* IPv4 identifier of the next datagram */
+LOCAL uint16 ui16NextIdentifier = US_NULL;
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL void      rxCallback          (UDP_keSocketNum, uint32, uint16, uint8 *, uint16);
+LOCAL void      addFragments        (uint8, const uint8 *, uint16, uint16);
+LOCAL void      shuffleStream       (void);
+LOCAL void      addDuplicate        (uint8);
+LOCAL void      replayStream        (uint16);
+LOCAL void      setStreamIdentifier (uint16);
+LOCAL boolean   testShuffledReplay  (void);
+LOCAL boolean   testExpiry          (void);
+LOCAL boolean   testLateDuplicates  (void);
+LOCAL double    measureThroughput   (uint16, boolean);
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+int main( void )
+{
+    boolean bSuccess;
+    static const uint16 aui16FragLengths[] = { 256, 512, 1480 };
+    uint8 ui8FragIdx;
+
+    SIM_Init();
+    (void)UDP_OpenUDPSocket(UDP_SOCKET_1, SIM_UL_LOCAL_IP_ADD, SIM_UL_REMOTE_IP_ADD, US_LOCAL_PORT, US_REMOTE_PORT);
+    (void)UDP_setRXCallback(UDP_SOCKET_1, &rxCallback);
+
+    bSuccess = testShuffledReplay();
+    if(B_TRUE != testExpiry())
+    {
+        bSuccess = B_FALSE;
+    }
+    else
+    {
+        /* stale datagram expired */
+    }
+    if(B_TRUE != testLateDuplicates())
+    {
+        bSuccess = B_FALSE;
+    }
+    else
+    {
+        /* late duplicates discarded */
+    }
+
+    printf("reassembly throughput: datagrams of %u bytes\n", US_THROUGHPUT_DATA_LENGTH);
+    printf("%10s %10s %14s %10s\n", "fragment", "order", "datagrams/s", "MB/s");
+    for(ui8FragIdx = UC_NULL; ui8FragIdx < (sizeof(aui16FragLengths) / sizeof(aui16FragLengths[0])); ui8FragIdx++)
+    {
+        (void)measureThroughput(aui16FragLengths[ui8FragIdx], B_FALSE);
+        (void)measureThroughput(aui16FragLengths[ui8FragIdx], B_TRUE);
+    }
+
+    return ((B_TRUE == bSuccess) ? 0 : 1);
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* socket receive callback: count the datagram and check it against the sent ones */
+LOCAL void rxCallback( UDP_keSocketNum unSocketNum, uint32 ui32SrcIPAdd, uint16 ui16SrcPort, uint8 *pui8Data, uint16 ui16DataLength )
+{
+    uint8 ui8DatagramIdx;
+
+    ui32ReceivedNum++;
+    ui32ReceivedBytes += ui16DataLength;
+
+    if(B_TRUE == bCheckData)
+    {
+        for(ui8DatagramIdx = UC_NULL; ui8DatagramIdx < UC_CONCURRENT_DATAGRAMS_NUM; ui8DatagramIdx++)
+        {
+            if((ui16DataLength == aui16SentLength[ui8DatagramIdx])
+            && (0 == memcmp(pui8Data, aaui8SentData[ui8DatagramIdx], ui16DataLength)))
+            {
+                ui32MatchingNum++;
+                /* a datagram matches once only */
+                aui16SentLength[ui8DatagramIdx] = US_NULL;
+                ui8DatagramIdx = UC_CONCURRENT_DATAGRAMS_NUM;
+            }
+            else
+            {
+                /* try next one */
+            }
+        }
+    }
+    else
+    {
+        /* data not checked */
+    }
+}
+
+
+/* fragment a UDP datagram into frames of the given max IPv4 payload length and add them to the stream */
+LOCAL void addFragments( uint8 ui8Datagram, const uint8 *pui8Data, uint16 ui16DataLength, uint16 ui16FragLength )
+{
+    uint8 aui8Datagram[SIM_UC_UDP_HDR_LENGTH + UDP_MAX_DATA_LENGTH_ALLOWED];
+    uint16 ui16DatagramLength;
+    uint16 ui16Offset;
+    uint16 ui16Length;
+    SIM_st_IPv4Params stParams;
+
+    ui16DatagramLength = SIM_buildUDPDatagram(aui8Datagram, SIM_UL_REMOTE_IP_ADD, SIM_UL_LOCAL_IP_ADD, US_REMOTE_PORT, US_LOCAL_PORT, pui8Data, ui16DataLength);
+
+    stParams.ui32SrcIPAdd = SIM_UL_REMOTE_IP_ADD;
+    stParams.ui32DstIPAdd = SIM_UL_LOCAL_IP_ADD;
+    stParams.ui8Protocol = SIM_UC_PROTOCOL_UDP;
+    stParams.ui16Identifier = ui16NextIdentifier++;
+
+    /* fragments payload length shall be a multiple of 8 but the last one */
+    ui16FragLength &= ~((uint16)7);
+    for(ui16Offset = US_NULL; ui16Offset < ui16DatagramLength; ui16Offset += ui16Length)
+    {
+        ui16Length = ((ui16DatagramLength - ui16Offset) > ui16FragLength) ? ui16FragLength : (uint16)(ui16DatagramLength - ui16Offset);
+
+        stParams.ui16FragOffset = ui16Offset;
+        stParams.bMoreFragments = ((ui16Offset + ui16Length) < ui16DatagramLength) ? B_TRUE : B_FALSE;
+
+        astStream[ui16StreamFramesNum].ui8Datagram = ui8Datagram;
+        astStream[ui16StreamFramesNum].ui16Length = SIM_buildIPv4Frame(astStream[ui16StreamFramesNum].aui8Data, &stParams, &aui8Datagram[ui16Offset], ui16Length);
+        ui16StreamFramesNum++;
+    }
+}
+
+
+/* shuffle the stream frames (Fisher-Yates) */
+LOCAL void shuffleStream( void )
+{
+    uint16 ui16Idx;
+    uint16 ui16SwapIdx;
+    st_Frame stTemp;
+
+    for(ui16Idx = (ui16StreamFramesNum - US_1); ui16Idx > US_NULL; ui16Idx--)
+    {
+        ui16SwapIdx = (uint16)(SIM_getRandom() % (ui16Idx + US_1));
+
+        stTemp = astStream[ui16Idx];
+        astStream[ui16Idx] = astStream[ui16SwapIdx];
+        astStream[ui16SwapIdx] = stTemp;
+    }
+}
+
+
+/* insert a copy of a random fragment of a datagram at a random position of the stream. A copy after the fragment
+   that completes the datagram is a late one and it shall be discarded.
+   A datagram made of a single fragment is not duplicated since it would be delivered twice */
+LOCAL void addDuplicate( uint8 ui8Datagram )
+{
+    uint16 ui16Idx;
+    uint16 ui16FragmentsNum = US_NULL;
+    uint16 ui16CopiedIdx;
+    uint16 ui16InsertIdx;
+    st_Frame stCopy;
+
+    for(ui16Idx = US_NULL; ui16Idx < ui16StreamFramesNum; ui16Idx++)
+    {
+        if(astStream[ui16Idx].ui8Datagram == ui8Datagram)
+        {
+            ui16FragmentsNum++;
+        }
+        else
+        {
+            /* fragment of another datagram */
+        }
+    }
+
+    if(ui16FragmentsNum > US_1)
+    {
+        /* copy a random fragment */
+        do
+        {
+            ui16CopiedIdx = (uint16)(SIM_getRandom() % ui16StreamFramesNum);
+        } while(astStream[ui16CopiedIdx].ui8Datagram != ui8Datagram);
+        stCopy = astStream[ui16CopiedIdx];
+
+        /* insert it anywhere */
+        ui16InsertIdx = (uint16)(SIM_getRandom() % (ui16StreamFramesNum + US_1));
+        for(ui16Idx = ui16StreamFramesNum; ui16Idx > ui16InsertIdx; ui16Idx--)
+        {
+            astStream[ui16Idx] = astStream[ui16Idx - US_1];
+        }
+        astStream[ui16InsertIdx] = stCopy;
+        ui16StreamFramesNum++;
+    }
+    else
+    {
+        /* not fragmented */
+    }
+}
+
+
+/* inject the stream frames from the given one running the main loop after each RX frames budget */
+LOCAL void replayStream( uint16 ui16FirstFrame )
+{
+    uint16 ui16Idx;
+
+    for(ui16Idx = ui16FirstFrame; ui16Idx < ui16StreamFramesNum; ui16Idx++)
+    {
+        (void)SIM_injectFrame(astStream[ui16Idx].aui8Data, astStream[ui16Idx].ui16Length);
+
+        if((((ui16Idx + US_1 - ui16FirstFrame) % UC_FRAMES_PER_RUN) == US_NULL)
+        || ((ui16Idx + US_1) == ui16StreamFramesNum))
+        {
+            SIM_runMainLoop();
+        }
+        else
+        {
+            /* inject next one */
+        }
+    }
+}
+
+
+/* set the IPv4 identifier of all the stream frames updating their header checksum */
+LOCAL void setStreamIdentifier( uint16 ui16Identifier )
+{
+    uint16 ui16Idx;
+    uint8 *pui8Header;
+    uint16 ui16OldIdentifier;
+    uint16 ui16Checksum;
+
+    for(ui16Idx = US_NULL; ui16Idx < ui16StreamFramesNum; ui16Idx++)
+    {
+        pui8Header = &astStream[ui16Idx].aui8Data[SIM_UC_ETH_HDR_LENGTH];
+
+        /* identifier and checksum fields are big-endian */
+        ui16OldIdentifier = (uint16)((pui8Header[4] << 8) | pui8Header[5]);
+        ui16Checksum = (uint16)((pui8Header[10] << 8) | pui8Header[11]);
+        ui16Checksum = CHKSUM_updateChecksum(ui16Checksum, ui16OldIdentifier, ui16Identifier);
+
+        pui8Header[4] = (uint8)(ui16Identifier >> 8);
+        pui8Header[5] = (uint8)ui16Identifier;
+        pui8Header[10] = (uint8)(ui16Checksum >> 8);
+        pui8Header[11] = (uint8)ui16Checksum;
+    }
+}
+
+
+/* replay shuffled fragments of concurrent datagrams of random length, with random fragment length
+   and duplicates: each datagram shall be delivered once and intact */
+LOCAL boolean testShuffledReplay( void )
+{
+    uint16 ui16Round;
+    uint8 ui8DatagramIdx;
+    uint16 ui16Idx;
+    uint32 ui32ExpectedNum = UL_NULL;
+
+    bCheckData = B_TRUE;
+    ui32ReceivedNum = UL_NULL;
+    ui32MatchingNum = UL_NULL;
+
+    for(ui16Round = US_NULL; ui16Round < (US_REPLAY_DATAGRAMS_NUM / UC_CONCURRENT_DATAGRAMS_NUM); ui16Round++)
+    {
+        ui16StreamFramesNum = US_NULL;
+
+        for(ui8DatagramIdx = UC_NULL; ui8DatagramIdx < UC_CONCURRENT_DATAGRAMS_NUM; ui8DatagramIdx++)
+        {
+            aui16SentLength[ui8DatagramIdx] = (uint16)(US_1 + (SIM_getRandom() % UDP_MAX_DATA_LENGTH_ALLOWED));
+            for(ui16Idx = US_NULL; ui16Idx < aui16SentLength[ui8DatagramIdx]; ui16Idx++)
+            {
+                aaui8SentData[ui8DatagramIdx][ui16Idx] = (uint8)SIM_getRandom();
+            }
+
+            addFragments(ui8DatagramIdx, aaui8SentData[ui8DatagramIdx], aui16SentLength[ui8DatagramIdx],
+                         (uint16)(8 + (SIM_getRandom() % (IPV4_US_DEFAULT_MTU - SIM_UC_IPV4_HDR_LENGTH - 8 + 1))));
+        }
+
+        shuffleStream();
+        for(ui8DatagramIdx = UC_NULL; ui8DatagramIdx < UC_CONCURRENT_DATAGRAMS_NUM; ui8DatagramIdx++)
+        {
+            addDuplicate(ui8DatagramIdx);
+        }
+        replayStream(US_NULL);
+
+        ui32ExpectedNum += UC_CONCURRENT_DATAGRAMS_NUM;
+    }
+
+    printf("shuffled replay: %u datagrams sent, %u received, %u intact, %u checksum errors\n",
+           ui32ExpectedNum, ui32ReceivedNum, ui32MatchingNum, UDP_getRXChecksumErrors());
+
+    return (((ui32ReceivedNum == ui32ExpectedNum)
+          && (ui32MatchingNum == ui32ExpectedNum)
+          && (UDP_getRXChecksumErrors() == UL_NULL)) ? B_TRUE : B_FALSE);
+}
+
+
+/* inject all the fragments of a datagram but the first one and let the max age elapse: the first one
+   alone shall not complete the datagram any longer */
+LOCAL boolean testExpiry( void )
+{
+    uint8 aui8Data[US_THROUGHPUT_DATA_LENGTH];
+    uint32 ui32DeliveredInTime;
+
+    memset(aui8Data, 0x3C, US_THROUGHPUT_DATA_LENGTH);
+
+    bCheckData = B_FALSE;
+    ui32ReceivedNum = UL_NULL;
+
+    /* first fragment in time completes the datagram */
+    ui16StreamFramesNum = US_NULL;
+    addFragments(UC_NULL, aui8Data, US_THROUGHPUT_DATA_LENGTH, 512);
+    replayStream(US_1);
+    ui16StreamFramesNum = US_1;
+    replayStream(US_NULL);
+    ui32DeliveredInTime = ui32ReceivedNum;
+
+    /* same again, with the max age elapsed before the first fragment */
+    ui16StreamFramesNum = US_NULL;
+    addFragments(UC_NULL, aui8Data, US_THROUGHPUT_DATA_LENGTH, 512);
+    replayStream(US_1);
+    SIM_tick(IPV4_UL_REASM_AGING_PERIOD_MS * (IPV4_UC_REASM_MAX_AGE + 2));
+    ui16StreamFramesNum = US_1;
+    replayStream(US_NULL);
+
+    printf("stale datagram: %u delivered in time, %u delivered after %u ms\n", ui32DeliveredInTime,
+           (ui32ReceivedNum - ui32DeliveredInTime), (IPV4_UL_REASM_AGING_PERIOD_MS * (IPV4_UC_REASM_MAX_AGE + 2)));
+
+    /* the stale first fragment opened a new context: let it expire too */
+    SIM_tick(IPV4_UL_REASM_AGING_PERIOD_MS * (IPV4_UC_REASM_MAX_AGE + 2));
+
+    return (((ui32DeliveredInTime == UL_1) && (ui32ReceivedNum == UL_1)) ? B_TRUE : B_FALSE);
+}
+
+
+/* re-assemble more datagrams than the contexts and inject a late duplicate of each one: duplicates shall be
+   discarded and a large datagram shall still be sent */
+LOCAL boolean testLateDuplicates( void )
+{
+    uint8 aui8Data[UDP_MAX_DATA_LENGTH_ALLOWED];
+    IPV4_st_RXFilterStats stStatsBefore;
+    IPV4_st_RXFilterStats stStatsAfter;
+    UDP_keOpResult eSendResult;
+    uint8 ui8DatagramIdx;
+    uint32 ui32LateNum;
+
+    memset(aui8Data, 0x69, UDP_MAX_DATA_LENGTH_ALLOWED);
+
+    bCheckData = B_FALSE;
+    ui32ReceivedNum = UL_NULL;
+    IPV4_getRXFilterStats(&stStatsBefore);
+
+    for(ui8DatagramIdx = UC_NULL; ui8DatagramIdx < (IPV4_UC_REASM_MAX_CONTEXTS + UC_1); ui8DatagramIdx++)
+    {
+        /* max length datagram, then its first fragment again */
+        ui16StreamFramesNum = US_NULL;
+        addFragments(UC_NULL, aui8Data, UDP_MAX_DATA_LENGTH_ALLOWED, 1024);
+        astStream[ui16StreamFramesNum] = astStream[US_NULL];
+        ui16StreamFramesNum++;
+        replayStream(US_NULL);
+    }
+
+    IPV4_getRXFilterStats(&stStatsAfter);
+    ui32LateNum = stStatsAfter.ui32LateFragmentCnt - stStatsBefore.ui32LateFragmentCnt;
+
+    /* a max length datagram needs a large buffer */
+    eSendResult = UDP_SendDataBuffer(UDP_SOCKET_1, aui8Data, UDP_MAX_DATA_LENGTH_ALLOWED);
+
+    printf("late duplicates: %u datagrams delivered, %u duplicates discarded, large send %s\n", ui32ReceivedNum,
+           ui32LateNum, ((UDP_OP_OK == eSendResult) ? "ok" : "FAIL"));
+
+    /* the remote host does not answer ARP: let the sent datagram be dropped so its buffer is given back */
+    SIM_tick(IPV4_UL_REASM_AGING_PERIOD_MS * (IPV4_UC_REASM_MAX_AGE + 2));
+
+    return (((ui32ReceivedNum == (IPV4_UC_REASM_MAX_CONTEXTS + UC_1))
+          && (ui32LateNum == (IPV4_UC_REASM_MAX_CONTEXTS + UC_1))
+          && (UDP_OP_OK == eSendResult)) ? B_TRUE : B_FALSE);
+}
+
+
+/* measure reassembly throughput of datagrams fragmented with the given fragment length, in order or shuffled */
+LOCAL double measureThroughput( uint16 ui16FragLength, boolean bShuffle )
+{
+    uint8 aui8Data[US_THROUGHPUT_DATA_LENGTH];
+    uint64 ui64StartTime;
+    uint64 ui64ElapsedTime;
+    uint32 ui32Datagram;
+    double dRate;
+
+    memset(aui8Data, 0xA5, US_THROUGHPUT_DATA_LENGTH);
+
+    /* frames are built once: each replay takes the next identifier, so it is not a late duplicate of the previous one */
+    ui16StreamFramesNum = US_NULL;
+    addFragments(UC_NULL, aui8Data, US_THROUGHPUT_DATA_LENGTH, ui16FragLength);
+    if(B_TRUE == bShuffle)
+    {
+        shuffleStream();
+    }
+    else
+    {
+        /* in order */
+    }
+
+    bCheckData = B_FALSE;
+    ui32ReceivedNum = UL_NULL;
+    ui32ReceivedBytes = UL_NULL;
+
+    ui64StartTime = SIM_getTimeNs();
+
+    for(ui32Datagram = UL_NULL; ui32Datagram < UL_THROUGHPUT_DATAGRAMS_NUM; ui32Datagram++)
+    {
+        setStreamIdentifier(ui16NextIdentifier++);
+        replayStream(US_NULL);
+    }
+
+    ui64ElapsedTime = SIM_getTimeNs() - ui64StartTime;
+    dRate = ((double)ui32ReceivedNum * 1e9) / (double)ui64ElapsedTime;
+
+    printf("%10u %10s %14.0f %10.1f%s\n", ui16FragLength, ((B_TRUE == bShuffle) ? "shuffled" : "in order"),
+           dRate, (((double)ui32ReceivedBytes * 1e3) / (double)ui64ElapsedTime),
+           ((ui32ReceivedNum == UL_THROUGHPUT_DATAGRAMS_NUM) ? "" : " (datagrams lost)"));
+
+    return dRate;
+}
+
+
+
+
+/* End of file */
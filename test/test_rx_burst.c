@@ -0,0 +1,232 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) [2015] [Marco Russi]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+/*
+ * This file test_rx_burst.c represents the host test of the sockets RX queue.
+ * N datagrams are injected between two polls of the application, one task period apart: the first
+ * UDP_UC_RX_QUEUE_DEPTH of them shall be delivered in order and the others counted as overflow. The rate of datagrams
+ * delivered through bursts that fill the queue is measured as well.
+ *
+ * Author : Marco Russi
+ *
+ * Evolution of the file:
+ * 10/08/2015 - File created - Marco Russi
+ *
+*/
+
+
+
+
+/* ------------- Inclusion files ----------------- */
+#include "framework/fw_common.h"
+#include "framework/hal/ethmac.h"
+#include "framework/sal/udp/udp.h"
+#include "framework/sal/rtos/rtos.h"
+#include "sim.h"
+
+
+
+
+/* --------------- Local defines ------------------ */
+
+/* local port of the socket under test */
+#define US_LOCAL_PORT                   ((uint16)7000)
+
+/* max num of datagrams of a burst: one for each RX descriptor */
+#define UC_MAX_BURST_LENGTH             (ETHMAC_UC_RX_NUM_OF_BUFFERS)
+
+/* datagram data length */
+#define US_DATA_LENGTH                  ((uint16)64)
+
+/* num of bursts of the rate measure */
+#define UL_RATE_BURSTS_NUM              ((uint32)200000)
+
+
+
+
+/* ------------- Local variables ----------------- */
+
+/* IPv4 identifier of the next injected frame */
+LOCAL uint16 ui16NextIdentifier = US_NULL;
+
+
+
+
+/* ------------- Local functions prototypes ----------------- */
+
+LOCAL void      injectDatagram      (uint16);
+LOCAL boolean   testBurst           (uint8);
+LOCAL double    measureRate         (void);
+
+
+
+
+/* ------------- Exported functions implementation ----------------- */
+
+int main( void )
+{
+    uint8 ui8BurstLength;
+    boolean bSuccess = B_TRUE;
+
+    SIM_Init();
+    (void)UDP_OpenUDPSocket(UDP_SOCKET_1, SIM_UL_LOCAL_IP_ADD, SIM_UL_REMOTE_IP_ADD, US_LOCAL_PORT, 5000);
+
+    printf("UDP RX burst: queue depth %u, %u RX descriptors\n", UDP_UC_RX_QUEUE_DEPTH, ETHMAC_UC_RX_NUM_OF_BUFFERS);
+    printf("%6s %10s %10s %7s\n", "burst", "delivered", "overflow", "result");
+
+    for(ui8BurstLength = UC_1; ui8BurstLength <= UC_MAX_BURST_LENGTH; ui8BurstLength++)
+    {
+        if(B_TRUE != testBurst(ui8BurstLength))
+        {
+            bSuccess = B_FALSE;
+        }
+        else
+        {
+            /* burst delivered as expected */
+        }
+    }
+
+    printf("bursts of %u datagrams of %u bytes: %.0f datagrams/s delivered\n", UDP_UC_RX_QUEUE_DEPTH, US_DATA_LENGTH, measureRate());
+
+    return ((B_TRUE == bSuccess) ? 0 : 1);
+}
+
+
+
+
+/* ------------- Local functions implementation ----------------- */
+
+/* inject a datagram whose data are all set at the given sequence num */
+LOCAL void injectDatagram( uint16 ui16SeqNum )
+{
+    uint8 aui8Data[US_DATA_LENGTH];
+    uint8 aui8Frame[SIM_US_MAX_FRAME_LENGTH];
+    uint16 ui16FrameLength;
+
+    memset(aui8Data, (uint8)ui16SeqNum, US_DATA_LENGTH);
+    ui16FrameLength = SIM_buildUDPFrame(aui8Frame, US_LOCAL_PORT, ui16NextIdentifier++, aui8Data, US_DATA_LENGTH);
+    (void)SIM_injectFrame(aui8Frame, ui16FrameLength);
+}
+
+
+/* inject a burst of datagrams, poll once and check what the socket delivers */
+LOCAL boolean testBurst( uint8 ui8BurstLength )
+{
+    boolean bSuccess = B_TRUE;
+    UDP_st_SocketStats stStatsBefore;
+    UDP_st_SocketStats stStatsAfter;
+    uint8 ui8ExpectedNum;
+    uint8 ui8DeliveredNum = UC_NULL;
+    uint8 *pui8Data;
+    uint16 ui16DataLength;
+    uint8 ui8SeqNum;
+    uint32 ui32OverflowNum;
+
+    (void)UDP_getSocketStats(UDP_SOCKET_1, &stStatsBefore);
+
+    for(ui8SeqNum = UC_NULL; ui8SeqNum < ui8BurstLength; ui8SeqNum++)
+    {
+        injectDatagram(ui8SeqNum);
+    }
+
+    /* the stack runs for one period of the application task: frames beyond the RX budget are polled again */
+    SIM_tick(RTOS_UL_TASKS_PERIOD_MS);
+
+    /* datagrams shall be delivered in order */
+    while(UDP_OP_OK == UDP_getNextRXData(UDP_SOCKET_1, &pui8Data, &ui16DataLength))
+    {
+        if((ui16DataLength != US_DATA_LENGTH)
+        || (pui8Data[UC_NULL] != ui8DeliveredNum)
+        || (pui8Data[US_DATA_LENGTH - US_1] != ui8DeliveredNum))
+        {
+            bSuccess = B_FALSE;
+        }
+        else
+        {
+            /* expected datagram */
+        }
+
+        ui8DeliveredNum++;
+    }
+    UDP_releaseRXData(UDP_SOCKET_1);
+
+    (void)UDP_getSocketStats(UDP_SOCKET_1, &stStatsAfter);
+    ui32OverflowNum = stStatsAfter.ui32RXOverflowCnt - stStatsBefore.ui32RXOverflowCnt;
+
+    ui8ExpectedNum = (ui8BurstLength < UDP_UC_RX_QUEUE_DEPTH) ? ui8BurstLength : UDP_UC_RX_QUEUE_DEPTH;
+    if((ui8DeliveredNum != ui8ExpectedNum)
+    || (ui32OverflowNum != (uint32)(ui8BurstLength - ui8ExpectedNum))
+    || (stStatsAfter.ui8RXQueueLevel != UC_NULL))
+    {
+        bSuccess = B_FALSE;
+    }
+    else
+    {
+        /* burst delivered as expected */
+    }
+
+    printf("%6u %10u %10u %7s\n", ui8BurstLength, ui8DeliveredNum, ui32OverflowNum, ((B_TRUE == bSuccess) ? "ok" : "FAIL"));
+
+    return bSuccess;
+}
+
+
+/* measure the rate of datagrams delivered through bursts that fill the RX queue */
+LOCAL double measureRate( void )
+{
+    uint64 ui64StartTime;
+    uint64 ui64ElapsedTime;
+    uint32 ui32BurstIdx;
+    uint32 ui32DeliveredNum = UL_NULL;
+    uint8 ui8SeqNum;
+    uint8 *pui8Data;
+    uint16 ui16DataLength;
+
+    ui64StartTime = SIM_getTimeNs();
+
+    for(ui32BurstIdx = UL_NULL; ui32BurstIdx < UL_RATE_BURSTS_NUM; ui32BurstIdx++)
+    {
+        for(ui8SeqNum = UC_NULL; ui8SeqNum < UDP_UC_RX_QUEUE_DEPTH; ui8SeqNum++)
+        {
+            injectDatagram(ui8SeqNum);
+        }
+
+        SIM_runMainLoop();
+
+        while(UDP_OP_OK == UDP_getNextRXData(UDP_SOCKET_1, &pui8Data, &ui16DataLength))
+        {
+            ui32DeliveredNum++;
+        }
+        UDP_releaseRXData(UDP_SOCKET_1);
+    }
+
+    ui64ElapsedTime = SIM_getTimeNs() - ui64StartTime;
+
+    return (((double)ui32DeliveredNum * 1e9) / (double)ui64ElapsedTime);
+}
+
+
+
+
+/* End of file */